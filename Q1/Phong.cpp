@@ -8,16 +8,86 @@
 #include <sstream>
 #include <vector>
 #include <string>
+#include <algorithm>
+#include <cstddef>
+#include <cmath>
+#include <atomic>
+#include <chrono>
+#include <thread>
 
 #include "sphere_scene.h" //    
+#include "viewer_options.h"
+#include "benchmarks.h"
+#include "mesh_encode.h"
+#include "mesh_optimize.h"
+#include "meshlet.h"
+#include "mesh_simplify.h"
+#include "uniforms.h"
+#include "shader_variants.h"
+#include "gl_benchmarks.h"
+#include "gl_extensions.h"
+#include "multi_draw.h"
+#include "ring_buffer.h"
+#include "frame_timing.h"
+#include "gpu_profiler.h"
+#include "cpu_profiler.h"
+#include "gl_state.h"
+#include "render_queue.h"
+#include "frame_handoff.h"
+#include "headless_context.h"
+#include "frame_capture.h"
+#include "program_cache.h"
+#include "shader_compiler.h"
 
 // --- Լ  ---
-void framebuffer_size_callback(GLFWwindow* window, int width, int height);
-void processInput(GLFWwindow* window);
+void processInput(GLFWwindow* window, double seconds);
 std::string loadShaderSource(const std::string& filePath);
-unsigned int compileShader(unsigned int type, const std::string& source);
-unsigned int createShaderProgram(const std::string& vertexShaderSource, const std::string& fragmentShaderSource);
-void setUniforms(unsigned int shaderProgram);
+PendingProgram submitShaderProgram(const std::string& vertexShaderSource, const std::string& fragmentShaderSource);
+PendingProgram submitShaderProgram(const std::string& vertexShaderSource, const std::string& tessControlSource,
+    const std::string& tessEvaluationSource, const std::string& fragmentShaderSource);
+void updateModelMatrix(float distance);
+
+// std140 uniform buffers of the Phong shaders, one per update frequency
+struct PhongUniforms {
+    UniformBuffer camera;
+    UniformBuffer light;
+    UniformBuffer material;
+    UniformBuffer object;
+    UniformBuffer palette;
+};
+bool createPhongUniforms(PhongUniforms& uniforms);
+void setUniforms(PhongUniforms& uniforms);
+void deletePhongUniforms(PhongUniforms& uniforms);
+
+// GL objects of one uploaded mesh
+struct MeshBuffers {
+    unsigned int VAO = 0;
+    unsigned int VBO = 0;
+    unsigned int EBO = 0;
+    int indexCount = 0;
+    unsigned int indexType = GL_UNSIGNED_INT;
+    // Dequantization of PhongQuantized.vert (uploadEncodedMesh only)
+    glm::vec3 positionOffset = glm::vec3(0.0f);
+    glm::vec3 positionScale = glm::vec3(1.0f);
+    // Per-instance attributes of PhongInstanced.vert (addInstanceBuffer only)
+    unsigned int instanceVBO = 0;
+    int instanceCount = 0;
+};
+MeshBuffers uploadMesh(const Mesh& mesh);
+MeshBuffers uploadEncodedMesh(const EncodedMesh& mesh);
+MeshBuffers createProceduralSphere(int width, int height);
+void addInstanceBuffer(MeshBuffers& buffers, const std::vector<SphereInstance>& instances);
+void pointInstanceAttributes(const MeshBuffers& buffers, unsigned int buffer, size_t offset);
+void drawRanges(const MeshBuffers& buffers, const std::vector<DrawRange>& ranges);
+
+// Render queue packets that are not a single glDraw* call
+struct MeshletDraw {
+    const MeshBuffers* buffers;
+    const std::vector<DrawRange>* ranges;
+};
+size_t drawMeshletPacket(const DrawPacket& packet, void* user);
+size_t drawBatchPacket(const DrawPacket& packet, void* user);
+void deleteMeshBuffers(MeshBuffers& buffers);
 
 // ---   ---
 const unsigned int SCR_WIDTH = 512;
@@ -40,131 +110,875 @@ glm::mat4 viewMatrix;
 glm::mat4 projectionMatrix;
 glm::mat3 normalMatrix;
 
+// Sphere placement; Up/Down change the distance to watch the LOD switch.
+float sphereDistance = 7.0f;
+const float sphereScale = 2.0f;
+
+// What one simulation step on the main thread hands to the renderer. With
+// --render-thread the two sides exchange these through a FrameHandoff, so
+// the renderer never reads the main thread's variables.
+struct FramePacket {
+    double inputTime = 0.0; // steady_seconds() when the input was sampled
+    float sphereDistance = 7.0f;
+    int framebufferWidth = SCR_WIDTH;
+    int framebufferHeight = SCR_HEIGHT;
+};
+void simulate(GLFWwindow* window, double seconds, float workMs, FramePacket& packet);
+
 // ---  Լ ---
-int main() {
-    // 1. GLFW ʱȭ  â 
-    if (!glfwInit()) {
-        std::cerr << "Failed to initialize GLFW" << std::endl;
+int main(int argc, char** argv) {
+    ViewerOptions options;
+    if (!parse_options(argc, argv, options)) {
         return -1;
     }
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    if (options.benchSphere) {
+        return run_sphere_benchmark(options.sphereWidth, options.sphereHeight);
+    }
+    if (options.sphereErrorReport) {
+        return run_sphere_error_report(options.sphereMaxError);
+    }
+    if (options.quantizeReport) {
+        return run_quantize_report(options.sphereWidth, options.sphereHeight);
+    }
+    if (options.vertexCacheReport) {
+        return run_vertex_cache_report(options.sphereWidth, options.sphereHeight, options.cacheSize, options.lruCache);
+    }
+    if (options.overdrawReport) {
+        return run_overdraw_report(options.sphereWidth, options.sphereHeight);
+    }
+    if (options.meshletReport) {
+        return run_meshlet_report(options.sphereWidth, options.sphereHeight);
+    }
+    if (options.lodReport) {
+        return run_lod_report(options.sphereWidth, options.sphereHeight);
+    }
+    if (options.variantReport) {
+        return run_shader_variant_report();
+    }
+    if (options.instanceReport) {
+        return run_instancing_report();
+    }
+    if (options.profilerReport) {
+        return run_profiler_overhead_report();
+    }
+    if (options.queueReport) {
+        return run_render_queue_report((size_t)options.queuePackets);
+    }
+    if (options.multiDrawReport) {
+        return run_multi_draw_report();
+    }
+    if (options.ringReport) {
+        return run_ring_buffer_report();
+    }
+    if (options.captureReport) {
+        return run_capture_report();
+    }
+    if (options.programCacheReport) {
+        return run_program_cache_report();
+    }
+    if (options.compileReport) {
+        return run_parallel_compile_report();
+    }
+    if (options.tessellation && options.procedural) {
+        std::cout << "--tessellation and --procedural are exclusive; ignoring --procedural" << std::endl;
+        options.procedural = false;
+    }
+    if ((options.tessellation || options.procedural) && (options.lod || options.meshlets || options.quantized)) {
+        std::cout << (options.tessellation ? "--tessellation" : "--procedural")
+            << " generates its own geometry; ignoring --lod, --meshlets and --quantized" << std::endl;
+        options.lod = options.meshlets = options.quantized = false;
+    }
+    if (options.instances > 0 && (options.tessellation || options.procedural || options.lod || options.meshlets ||
+        options.quantized)) {
+        std::cout << "--instances draws the plain sphere mesh; ignoring --tessellation, --procedural, --lod, "
+            "--meshlets and --quantized" << std::endl;
+        options.tessellation = options.procedural = options.lod = options.meshlets = options.quantized = false;
+    }
+    if (options.multiDraw > 0 && (options.instances > 0 || options.tessellation || options.procedural || options.lod ||
+        options.meshlets || options.quantized)) {
+        std::cout << "--multi-draw draws its own batch; ignoring --instances, --tessellation, --procedural, --lod, "
+            "--meshlets and --quantized" << std::endl;
+        options.instances = 0;
+        options.tessellation = options.procedural = options.lod = options.meshlets = options.quantized = false;
+    }
+    if (options.headless && (options.renderThread || options.latencyReport)) {
+        std::cout << "--headless has no window events; ignoring --render-thread and --latency-report" << std::endl;
+        options.renderThread = options.latencyReport = false;
+    }
+
+    // --cpu-trace: record CPU zones from here on; startup covers everything
+    // up to the first frame.
+    if (!options.cpuTrace.empty()) {
+        cpu_profiler_enable(true);
+        cpu_profiler_set_thread_name("main");
+        cpu_profiler_reserve(1 << 16); // a few thousand frames without allocating
+    }
+    CpuZone startupZone("startup");
+
+    // Tessellation shaders need GL 4.0, glMultiDrawElementsIndirect 4.3.
+    const int glMajor = options.tessellation || options.multiDraw > 0 ? 4 : 3;
+    const int glMinor = options.multiDraw > 0 ? 3 : options.tessellation ? 0 : 3;
+
+    // --headless: no GLFW at all; the context draws into its own framebuffer.
+    GLFWwindow* window = NULL;
+    HeadlessContext headless;
+    if (options.headless) {
+        if (!headless.create(options.frameWidth, options.frameHeight, glMajor, glMinor)) {
+            return -1;
+        }
+        std::cout << "Headless: " << headless.backend() << ", " << (const char*)glGetString(GL_RENDERER) << ", "
+            << headless.width() << "x" << headless.height() << std::endl;
+    }
+    else {
+        // 1. GLFW ʱȭ  â 
+        if (!glfwInit()) {
+            std::cerr << "Failed to initialize GLFW" << std::endl;
+            return -1;
+        }
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, glMajor);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, glMinor);
+        glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 #ifdef __APPLE__
-    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+        glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
 #endif
 
-    GLFWwindow* window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "HW7 - OpenGL Phong Shader", NULL, NULL);
-    if (window == NULL) {
-        std::cerr << "Failed to create GLFW window" << std::endl;
-        glfwTerminate();
-        return -1;
+        window = glfwCreateWindow(options.frameWidth, options.frameHeight, "HW7 - OpenGL Phong Shader", NULL, NULL);
+        if (window == NULL) {
+            std::cerr << "Failed to create GLFW window" << std::endl;
+            glfwTerminate();
+            return -1;
+        }
+        glfwMakeContextCurrent(window);
+
+        // 2. GLEW ʱȭ
+        glewExperimental = GL_TRUE;
+        if (glewInit() != GLEW_OK) {
+            std::cerr << "Failed to initialize GLEW" << std::endl;
+            glfwDestroyWindow(window);
+            glfwTerminate();
+            return -1;
+        }
+        load_gl_extensions();
     }
-    glfwMakeContextCurrent(window);
-    glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
 
-    // 2. GLEW ʱȭ
-    glewExperimental = GL_TRUE;
-    if (glewInit() != GLEW_OK) {
-        std::cerr << "Failed to initialize GLEW" << std::endl;
-        glfwDestroyWindow(window);
-        glfwTerminate();
-        return -1;
+    // --program-cache: linked programs come from disk when the sources and
+    // the driver match the last run.
+    if (!options.programCache.empty()) {
+        program_cache().open(options.programCache);
     }
 
+    // Frame pacing: --bench-frames and --headless measure unthrottled
+    // frames; there is no swap interval without a window.
+    if (options.benchFrames > 0 || options.headless) {
+        options.vsync = VsyncMode::Off;
+        options.fpsLimit = 0.0f;
+    }
+    VsyncMode vsync = options.headless ? VsyncMode::Off : apply_vsync(options.vsync);
+    FrameLimiter frameLimiter(options.fpsLimit);
+    bool frameTiming = options.frameStats || !options.frameJson.empty() || options.benchFrames > 0;
+    FrameTimer frameTimer;
+    if (frameTiming) {
+        frameTimer.create();
+    }
+    // --gpu-profile / --gpu-overlay: per-pass GPU time of the clear, the
+    // sphere draw and the swap (null when off).
+    GpuProfiler gpuProfiler;
+    GpuProfiler* profiler = nullptr;
+    if ((options.gpuProfile || options.gpuOverlay) && gpuProfiler.create(options.gpuCsv)) {
+        profiler = &gpuProfiler;
+    }
+    double overlayTitleTime = 0.0;
+
     // 3.   
-    create_scene();
-    if (!gVertexBuffer || !gIndexBuffer) {
+    // With --tessellation the GPU refines an 80-triangle icosphere instead;
+    // with --procedural there is no mesh at all.
+    Mesh sphere;
+    if (options.tessellation) {
+        sphere = create_icosphere(0.0f, 2);
+    }
+    else if (!options.procedural) {
+        sphere = create_sphere(options.viewerWidth, options.viewerHeight);
+    }
+    bool validSphere = options.procedural ? sphere_triangle_count(options.viewerWidth, options.viewerHeight) > 0 :
+        !sphere.empty();
+    if (!validSphere) {
         std::cerr << "Failed to create scene geometry" << std::endl;
         glfwTerminate();
         return -1;
     }
 
+    // Level 0 is the sphere itself; --lod adds the simplified levels.
+    std::vector<LodLevel> lods;
+    if (options.lod) {
+        lods = build_lod_chain(sphere);
+        for (size_t i = 0; i < lods.size(); ++i) {
+            std::cout << "LOD " << i << ": " << lods[i].mesh.triangleCount() << " triangles, error "
+                << lods[i].error << ", " << lods[i].seconds * 1e3 << " ms" << std::endl;
+        }
+    }
+    else {
+        lods.emplace_back();
+        lods[0].mesh = std::move(sphere);
+    }
+    std::vector<std::vector<Meshlet>> lodMeshlets(lods.size());
+    for (size_t i = 0; i < lods.size(); ++i) {
+        Mesh& mesh = lods[i].mesh;
+        if (mesh.empty()) continue; // --procedural
+        optimize_vertex_cache(mesh);
+        optimize_overdraw(mesh);
+        optimize_vertex_fetch(mesh);
+        if (options.meshlets) {
+            lodMeshlets[i] = build_meshlets(mesh);
+        }
+    }
+
+    // --multi-draw: the viewer's sphere and three coarser meshes in one
+    // batch, N objects on the --instances grid cycling through them.
+    MultiDrawBatch batch;
+    if (options.multiDraw > 0) {
+        batch.addMesh(lods[0].mesh);
+        batch.addMesh(create_sphere(12, 8));
+        batch.addMesh(create_icosphere(0.0f, 2));
+        batch.addMesh(create_icosphere(0.0f, 1));
+        if (!batch.create((size_t)options.multiDraw)) {
+            glfwTerminate();
+            return -1;
+        }
+        std::vector<SphereInstance> objects = create_sphere_instances((size_t)options.multiDraw, kMaterialPaletteSize);
+        for (size_t i = 0; i < objects.size(); ++i) {
+            batch.add(i % batch.meshCount(), objects[i].position, objects[i].scale, objects[i].material);
+        }
+        std::cout << "Multi-draw: " << batch.drawCount() << " objects, "
+            << (batch.usesMultiDraw() ? "one glMultiDrawElementsIndirect" : "one glDrawElementsIndirect each")
+            << (batch.usesDrawIdBuiltin() ? " with gl_DrawIDARB" : " with a draw id attribute")
+            << std::endl;
+    }
+
     // 4. ̴ ε  
-    std::string vertexShaderSource = loadShaderSource("Phong.vert");
+    std::string vertexShaderSource = loadShaderSource(options.multiDraw > 0 ? "PhongMultiDraw.vert" :
+        options.instances > 0 ? "PhongInstanced.vert" :
+        options.tessellation ? "PhongTess.vert" : options.procedural ? "PhongProcedural.vert" :
+        options.quantized ? "PhongQuantized.vert" : "Phong.vert");
     std::string fragmentShaderSource = loadShaderSource("Phong.frag");
+    if (options.multiDraw > 0 && !vertexShaderSource.empty()) {
+        vertexShaderSource = inject_defines(vertexShaderSource, batch.shaderDefines());
+    }
     if (vertexShaderSource.empty() || fragmentShaderSource.empty()) {
-        delete_scene();
         glfwTerminate();
         return -1;
     }
-    unsigned int shaderProgram = createShaderProgram(vertexShaderSource, fragmentShaderSource);
+    std::string tessControlSource, tessEvaluationSource;
+    if (options.tessellation) {
+        tessControlSource = loadShaderSource("PhongTess.tesc");
+        tessEvaluationSource = loadShaderSource("PhongTess.tese");
+    }
+    // Phong.frag permutations are built on demand with the selected
+    // features and the material / light constants folded in.
+    ShaderVariantCache shaderVariants(fragmentShaderSource, [&](const std::string& fragmentSource) {
+        return options.tessellation ?
+            submitShaderProgram(vertexShaderSource, tessControlSource, tessEvaluationSource, fragmentSource) :
+            submitShaderProgram(vertexShaderSource, fragmentSource);
+    });
+    ShaderVariantKey variantKey;
+    variantKey.features = options.shaderFeatures;
+    if (options.instances > 0 || options.multiDraw > 0) {
+        variantKey.features |= kPhongMaterialPalette;
+    }
+    variantKey.constants.matKa = mat_ka;
+    variantKey.constants.matKd = mat_kd;
+    variantKey.constants.matKs = mat_ks;
+    variantKey.constants.matShininess = mat_p_shininess;
+    variantKey.constants.lightPosWorld = light_pos_world;
+    variantKey.constants.lightIa = light_Ia_intensity;
+    variantKey.constants.lightIl = light_Il_intensity;
+    variantKey.constants.gamma = gamma_val;
+    // Compiles and links run on driver threads where the driver supports
+    // KHR_parallel_shader_compile.
+    set_shader_compiler_threads(0xFFFFFFFFu);
+    double shaderStart = steady_seconds();
+    // --async-shaders: a specialized variant compiles in the background
+    // while the frame loop draws with the generic program of the same
+    // features, which reads material, light and gamma from the uniform
+    // buffers and so looks the same.
+    ShaderVariantKey fallbackKey = variantKey;
+    fallbackKey.features &= ~(unsigned int)kPhongConstAll;
+    bool variantPending = options.asyncShaders && !(fallbackKey == variantKey);
+    if (variantPending) {
+        shaderVariants.request(variantKey);
+    }
+    unsigned int shaderProgram = shaderVariants.program(variantPending ? fallbackKey : variantKey);
+    if (program_cache().enabled()) {
+        ProgramCacheStats cacheStats = program_cache().stats();
+        std::cout << "Program cache " << program_cache().directory() << ": " <<
+            (cacheStats.hits > 0 ? "warm" : "cold") << ", shaders ready in " <<
+            (steady_seconds() - shaderStart) * 1e3 << " ms" << std::endl;
+    }
     if (shaderProgram == 0) {
-        delete_scene();
         glfwTerminate();
         return -1;
     }
+    if (variantPending) {
+        std::cout << "Shader variant " << shader_features_name(variantKey.features) << " compiling, drawing with "
+            << shader_features_name(fallbackKey.features) << " meanwhile" << std::endl;
+    }
+    else if (variantKey.features != kPhongDefault) {
+        std::cout << "Shader variant " << shader_features_name(variantKey.features) << std::endl;
+    }
 
-    // 5. VBO, VAO, EBO 
-    unsigned int VBO, VAO, EBO;
-    glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &VBO);
-    glGenBuffers(1, &EBO);
-
-    glBindVertexArray(VAO);
-
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    //  ġ  ͸ ļ VBO ε (ġ  ϹǷ gVertexBuffer    )
-    // Ǵ, ͸  (ġ, , ġ, ...) VBO   , ⼭ ϰ ó.
-    //   ġ=̹Ƿ gVertexBuffer .
-    glBufferData(GL_ARRAY_BUFFER, gNumVertices * sizeof(glm::vec3), gVertexBuffer, GL_STATIC_DRAW);
+    // Reflect the program once; the remaining plain uniforms go through
+    // cached locations, everything else lives in uniform buffers. Runs
+    // again for the variant that replaces the --async-shaders fallback.
+    ProgramUniforms programUniforms;
+    int maxTessLevel = 64;
+    if (options.tessellation) {
+        glGetIntegerv(GL_MAX_TESS_GEN_LEVEL, &maxTessLevel);
+    }
+    int normalEncodingId = -1; // set once the quantized mesh is encoded
+    auto setupProgram = [&](unsigned int program) -> bool {
+        programUniforms = ProgramUniforms(program);
+        if (!bind_phong_blocks(programUniforms)) return false;
+        gl_state().useProgram(program);
+        if (options.tessellation) {
+            programUniforms.set("pixelsPerEdge", options.tessPixelsPerEdge);
+            programUniforms.set("maxTessLevel", (float)maxTessLevel);
+        }
+        if (options.procedural) {
+            programUniforms.set("sphereResolution", glm::ivec2(options.viewerWidth, options.viewerHeight));
+        }
+        if (options.multiDraw > 0) {
+            programUniforms.set("drawData", 0);
+        }
+        if (normalEncodingId >= 0) {
+            programUniforms.set("normalEncoding", normalEncodingId);
+        }
+        return true;
+    };
+    PhongUniforms phongUniforms;
+    if (!setupProgram(shaderProgram) || !createPhongUniforms(phongUniforms)) {
+        std::cerr << "Uniform block setup failed" << std::endl;
+        shaderVariants.clear();
+        glfwTerminate();
+        return -1;
+    }
+    size_t setupLookups = uniform_stats().locationLookups;
 
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, gNumTriangles * 3 * sizeof(int), gIndexBuffer, GL_STATIC_DRAW);
+    GLenum primitiveMode = GL_TRIANGLES;
+    if (options.tessellation) {
+        glPatchParameteri(GL_PATCH_VERTICES, 3);
+        primitiveMode = GL_PATCHES;
+    }
 
-    //  ġ Ӽ  (location = 0)
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)0);
-    glEnableVertexAttribArray(0);
-    //   Ӽ  (location = 1) - ġ Ϳ  VBO 
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)0);
-    glEnableVertexAttribArray(1);
+    // 5. VBO, VAO, EBO 
+    std::vector<MeshBuffers> lodBuffers;
+    for (const LodLevel& level : lods) {
+        if (options.quantized) {
+            EncodeOptions encodeOptions;
+            encodeOptions.normals = options.normalEncoding;
+            EncodedMesh encoded = encode_mesh(level.mesh, nullptr, encodeOptions);
+            std::cout << "Quantized mesh: " << encoded.vertexStride << " B/vertex, "
+                << (encoded.indexType == GL_UNSIGNED_SHORT ? 16 : 32) << "-bit indices, max position error "
+                << encoded.maxPositionError << ", max normal error " << encoded.maxNormalErrorDeg << " deg" << std::endl;
 
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);
+            glUseProgram(shaderProgram);
+            normalEncodingId = normal_encoding_id(encoded.normals);
+            programUniforms.set("normalEncoding", normalEncodingId);
+            lodBuffers.push_back(uploadEncodedMesh(encoded));
+        }
+        else if (options.procedural) {
+            lodBuffers.push_back(createProceduralSphere(options.viewerWidth, options.viewerHeight));
+        }
+        else {
+            lodBuffers.push_back(uploadMesh(level.mesh));
+        }
+    }
+    std::vector<SphereInstance> restInstances;
+    FrameRingBuffer instanceRing;
+    if (options.instances > 0) {
+        // The grid fills the volume of the single sphere, so Up/Down still
+        // move the whole group.
+        restInstances = create_sphere_instances((size_t)options.instances, kMaterialPaletteSize);
+        addInstanceBuffer(lodBuffers[0], restInstances);
+        // --animate rewrites the instances every frame into a fenced ring
+        // instead of the static buffer.
+        if (options.animate && !instanceRing.create(restInstances.size() * sizeof(SphereInstance))) {
+            std::cerr << "Failed to create the instance ring buffer; not animating" << std::endl;
+            options.animate = false;
+        }
+        std::cout << "Instanced: " << options.instances << " spheres, "
+            << (double)options.instances * lods[0].mesh.triangleCount() << " triangles per frame" << std::endl;
+    }
 
     // 6.   (HW6 )
-    modelMatrix = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, -7.0f)) *
-        glm::scale(glm::mat4(1.0f), glm::vec3(2.0f));
+    updateModelMatrix(sphereDistance);
     viewMatrix = glm::lookAt(eye_pos_world, glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
     float nearVal = 0.1f;
     float farVal = 1000.0f;
     projectionMatrix = glm::frustum(-0.1f, 0.1f, -0.1f, 0.1f, nearVal, farVal);
-    normalMatrix = glm::transpose(glm::inverse(glm::mat3(modelMatrix)));
 
     // 7. OpenGL 
     glEnable(GL_DEPTH_TEST); //  ׽Ʈ Ȱȭ
     glClearColor(0.0f, 0.0f, 0.0f, 1.0f); //  
 
+    std::vector<DrawRange> visibleRanges;
+    CullStats cullTotals;
+    size_t frameCount = 0;
+    std::vector<size_t> lodFrames(lods.size(), 0);
+
+    // --draw-stats: primitives generated (after tessellation) and GPU time of
+    // the draw, double buffered and read one frame late to avoid stalls.
+    unsigned int statQueries[2][2] = {}; // [frame parity][primitives, time]
+    if (options.drawStats) {
+        glGenQueries(4, &statQueries[0][0]);
+    }
+    double statTriangles = 0.0, statGpuMs = 0.0;
+    size_t statFrames = 0;
+    double loopStart = steady_seconds();
+    size_t boundLevel = lods.size(); // none yet
+    UniformStats uniformTotals;
+    size_t drawCalls = 0;
+    // Setup bound its state directly; from here on the frame goes through
+    // the cache, which skips the binds that are already current.
+    GLStateCache& glState = gl_state();
+    glState.setDebug(options.glStateCheck);
+    glState.invalidate();
+    GLStateStats glStateTotals;
+    RenderQueue renderQueue;
+    // --capture: sized to the framebuffer, recreated when that changes
+    FrameCapture capture;
+    if (!options.capturePath.empty()) {
+        int captureWidth = headless.width(), captureHeight = headless.height();
+        if (window != NULL) {
+            glfwGetFramebufferSize(window, &captureWidth, &captureHeight);
+        }
+        if (!capture.create(captureWidth, captureHeight, options.captureFormat, options.capturePath)) {
+            glfwTerminate();
+            return -1;
+        }
+    }
+    startupZone.end();
+
+    // Input-to-present latency (input sampled to swap returned) and the
+    // interval between presents, for --latency-report
+    const size_t frameLimit = options.benchFrames > 0 ? (size_t)options.benchFrames :
+        options.latencyReport ? (size_t)options.latencyFrames : options.headless ? (size_t)options.headlessFrames : 0;
+    FrameTimeSeries latencySeries(std::max(frameLimit, (size_t)1000));
+    FrameTimeSeries presentSeries(std::max(frameLimit, (size_t)1000));
+    double lastPresent = -1.0;
+    size_t runFrames = 0;
+    // glfwSetWindowTitle is main thread only; the render thread posts titles here.
+    bool threadedRender = false;
+    FrameHandoff<std::string> titleHandoff;
+
     // 8.  
-    while (!glfwWindowShouldClose(window)) {
-        // Է ó
-        processInput(window);
+    // One frame from the latest simulation packet, on the thread that owns
+    // the context. Returns false once frameLimit frames have been drawn.
+    auto renderFrame = [&](const FramePacket& frame) -> bool {
+        PROFILE_ZONE("frame");
+        if (frameTiming) {
+            frameTimer.beginFrame();
+        }
+        if (profiler) {
+            profiler->beginFrame();
+        }
+        updateModelMatrix(frame.sphereDistance);
+        uniform_stats() = UniformStats();
+        glState.resetStats();
+        // --async-shaders: switch to the variant once it has linked.
+        if (variantPending) {
+            unsigned int program = shaderVariants.ready(variantKey, shaderProgram);
+            variantPending = shaderVariants.pending() > 0;
+            if (program != shaderProgram) {
+                if (setupProgram(program)) {
+                    std::cout << "Shader variant " << shader_features_name(variantKey.features) << " ready after "
+                        << frameCount << " frames, " << (steady_seconds() - shaderStart) * 1e3 << " ms" << std::endl;
+                    shaderProgram = program;
+                    boundLevel = lods.size(); // resend the per-level uniforms
+                }
+                else {
+                    setupProgram(shaderProgram);
+                }
+            }
+        }
+        glState.viewport(0, 0, frame.framebufferWidth, frame.framebufferHeight);
+
+        // Pick the LOD from the projected size of its error at the sphere's
+        // nearest point.
+        size_t level = 0;
+        if (options.lod) {
+            float depth = -(viewMatrix * modelMatrix * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f)).z - sphereScale;
+            level = select_lod(lods, options.lodPixelError, projectionMatrix, frame.framebufferHeight, depth,
+                sphereScale);
+        }
+        const MeshBuffers& sphereBuffers = lodBuffers[level];
+        if (options.tessellation) {
+            glState.useProgram(shaderProgram);
+            programUniforms.set("viewportSize",
+                glm::vec2((float)frame.framebufferWidth, (float)frame.framebufferHeight));
+        }
 
         // 
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        {
+            GpuScope scope(profiler, "clear");
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        }
 
         // ̴ α׷ 
-        glUseProgram(shaderProgram);
+        glState.useProgram(shaderProgram);
 
         //   
-        setUniforms(shaderProgram);
+        setUniforms(phongUniforms);
+        if (level != boundLevel) {
+            if (options.quantized) {
+                programUniforms.set("positionOffset", sphereBuffers.positionOffset);
+                programUniforms.set("positionScale", sphereBuffers.positionScale);
+            }
+            if (options.lod) {
+                std::cout << "LOD " << level << " (" << lods[level].mesh.triangleCount() << " triangles) at distance "
+                    << frame.sphereDistance << std::endl;
+            }
+            boundLevel = level;
+        }
 
         // VAO ε  ׸
-        glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, gNumTriangles * 3, GL_UNSIGNED_INT, 0);
-        glBindVertexArray(0); // VAO ε 
+        unsigned int* queries = statQueries[frameCount & 1];
+        if (options.drawStats) {
+            glBeginQuery(GL_PRIMITIVES_GENERATED, queries[0]);
+            glBeginQuery(GL_TIME_ELAPSED, queries[1]);
+        }
+        if (profiler) {
+            profiler->begin("sphere");
+        }
+        CpuZone drawZone("draw");
+        // The frame's packets go through the render queue, which binds the
+        // state they need in sort-key order (program, material, mesh, then
+        // front to back).
+        DrawPacket packet;
+        float viewDepth = -(viewMatrix * modelMatrix * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f)).z;
+        packet.key = make_sort_key(0, shaderProgram, 0, (uint32_t)level, viewDepth / farVal);
+        packet.program = shaderProgram;
+        packet.vertexArray = sphereBuffers.VAO;
+        packet.mode = primitiveMode;
+        packet.count = sphereBuffers.indexCount;
+        // Attribute-less without an EBO: the vertex shader builds each vertex from gl_VertexID.
+        packet.indexType = sphereBuffers.EBO == 0 ? 0 : sphereBuffers.indexType;
+        MeshletDraw meshletDraw = { &sphereBuffers, &visibleRanges };
+        if (options.meshlets) {
+            // Cull in object space: frustum from P * V * M, camera through inverse(M).
+            Frustum frustum = extract_frustum(projectionMatrix * viewMatrix * modelMatrix);
+            glm::vec3 cameraObject = glm::vec3(glm::inverse(modelMatrix) * glm::vec4(eye_pos_world, 1.0f));
+            visibleRanges.clear();
+            CullStats cull = cull_meshlets(lodMeshlets[level], frustum, cameraObject, visibleRanges);
+            cullTotals.total += cull.total;
+            cullTotals.frustumCulled += cull.frustumCulled;
+            cullTotals.backfaceCulled += cull.backfaceCulled;
+            cullTotals.trianglesDrawn += cull.trianglesDrawn;
+            packet.draw = drawMeshletPacket;
+            packet.user = &meshletDraw;
+        }
+        else if (options.multiDraw > 0) {
+            // The batch does not change, so only the first submit uploads.
+            packet.vertexArray = batch.vertexArray();
+            packet.draw = drawBatchPacket;
+            packet.user = &batch;
+        }
+        else if (sphereBuffers.instanceCount > 0) {
+            if (options.animate) {
+                instanceRing.beginFrame();
+                RingAllocation slice = instanceRing.allocate(restInstances.size() * sizeof(SphereInstance));
+                animate_sphere_instances(restInstances, (float)steady_seconds(), (SphereInstance*)slice.data);
+                instanceRing.flush();
+                pointInstanceAttributes(sphereBuffers, instanceRing.buffer(), slice.offset);
+            }
+            packet.instances = sphereBuffers.instanceCount;
+        }
+        renderQueue.clear();
+        renderQueue.submit(packet);
+        renderQueue.sort();
+        drawCalls += renderQueue.execute().drawCalls;
+        if (options.animate && sphereBuffers.instanceCount > 0) {
+            instanceRing.endFrame();
+        }
+        drawZone.end();
+        if (profiler) {
+            profiler->end();
+        }
+        if (options.drawStats) {
+            glEndQuery(GL_TIME_ELAPSED);
+            glEndQuery(GL_PRIMITIVES_GENERATED);
+            if (frameCount > 0) {
+                unsigned int* previous = statQueries[(frameCount - 1) & 1];
+                GLuint64 primitives = 0, nanoseconds = 0;
+                glGetQueryObjectui64v(previous[0], GL_QUERY_RESULT, &primitives);
+                glGetQueryObjectui64v(previous[1], GL_QUERY_RESULT, &nanoseconds);
+                statTriangles += (double)primitives;
+                statGpuMs += nanoseconds * 1e-6;
+                statFrames++;
+            }
+        }
+        const UniformStats& frameUniforms = uniform_stats();
+        uniformTotals.uniformCalls += frameUniforms.uniformCalls;
+        uniformTotals.bufferUploads += frameUniforms.bufferUploads;
+        uniformTotals.bytes += frameUniforms.bytes;
+        frameCount++;
+        lodFrames[level]++;
 
         //    ̺Ʈ 
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+        if (options.gpuOverlay && profiler) {
+            GpuScope scope(profiler, "overlay");
+            profiler->drawOverlay(frame.framebufferWidth, frame.framebufferHeight);
+            // The numbers go to the title bar, twice a second.
+            if (steady_seconds() - overlayTitleTime > 0.5) {
+                overlayTitleTime = steady_seconds();
+                std::string title = "HW7 - OpenGL Phong Shader | GPU " + profiler->overlayText();
+                if (threadedRender) {
+                    titleHandoff.publish(title);
+                }
+                else if (window != NULL) {
+                    glfwSetWindowTitle(window, title.c_str());
+                }
+            }
+        }
+        if (capture.created() && frame.framebufferWidth > 0 && frame.framebufferHeight > 0) {
+            PROFILE_ZONE("capture");
+            if (frame.framebufferWidth != capture.width() || frame.framebufferHeight != capture.height()) {
+                capture.create(frame.framebufferWidth, frame.framebufferHeight, options.captureFormat,
+                    options.capturePath);
+            }
+            capture.capture(frameCount - 1); // frameCount already counts this frame
+        }
+        if (glState.debug()) {
+            glState.verify();
+        }
+        const GLStateStats& frameState = glState.stats();
+        glStateTotals.issued += frameState.issued;
+        glStateTotals.avoided += frameState.avoided;
+        glStateTotals.mismatches += frameState.mismatches;
+        if (frameTiming) {
+            frameTimer.endFrame();
+        }
+        {
+            GpuScope scope(profiler, "swap");
+            if (options.headless) {
+                PROFILE_ZONE("present");
+                headless.present();
+            }
+            else {
+                PROFILE_ZONE("glfwSwapBuffers");
+                glfwSwapBuffers(window);
+            }
+        }
+        double presentTime = steady_seconds();
+        latencySeries.add((presentTime - frame.inputTime) * 1e3);
+        if (lastPresent >= 0.0) {
+            presentSeries.add((presentTime - lastPresent) * 1e3);
+        }
+        lastPresent = presentTime;
+        if (profiler) {
+            profiler->endFrame();
+        }
+        frameLimiter.wait();
+        return frameLimit == 0 || ++runFrames < frameLimit;
+    };
+
+    // One thread: events, simulation and drawing take turns, so a slow
+    // simulation step or event handler adds straight to the frame time.
+    auto runSingleThreaded = [&]() {
+        threadedRender = false;
+        FramePacket frame;
+        double lastStep = steady_seconds();
+        do {
+            glfwPollEvents();
+            double now = steady_seconds();
+            simulate(window, now - lastStep, options.simulationMs, frame);
+            lastStep = now;
+        } while (!glfwWindowShouldClose(window) && renderFrame(frame));
+    };
+
+    // --render-thread: the render thread owns the context and draws the
+    // newest packet each frame (the previous one again if none arrived).
+    // The main thread keeps polling events and stepping the simulation about
+    // once a millisecond, independent of the frame rate; sleep granularity
+    // (see FrameLimiter) bounds how old a packet can get.
+    auto runRenderThread = [&]() {
+        threadedRender = true;
+        FrameHandoff<FramePacket> frames;
+        simulate(window, 0.0, 0.0f, frames.back());
+        frames.publish();
+        std::atomic<bool> running(true);
+        glfwMakeContextCurrent(NULL);
+        std::thread renderThread([&]() {
+            glfwMakeContextCurrent(window);
+            cpu_profiler_set_thread_name("render");
+            if (cpu_profiler_enabled()) {
+                cpu_profiler_reserve(1 << 16);
+            }
+            while (running.load(std::memory_order_relaxed)) {
+                frames.acquire();
+                if (!renderFrame(frames.front())) {
+                    running.store(false);
+                }
+            }
+            glfwMakeContextCurrent(NULL);
+        });
+        double lastStep = steady_seconds();
+        while (running.load(std::memory_order_relaxed) && !glfwWindowShouldClose(window)) {
+            glfwPollEvents();
+            double now = steady_seconds();
+            simulate(window, now - lastStep, options.simulationMs, frames.back());
+            lastStep = now;
+            frames.publish();
+            if (titleHandoff.acquire()) {
+                glfwSetWindowTitle(window, titleHandoff.front().c_str());
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        running.store(false);
+        renderThread.join();
+        glfwMakeContextCurrent(window);
+        std::cout << "Render thread: " << frames.published() << " simulation steps, " << frames.replaced()
+            << " replaced before being drawn" << std::endl;
+    };
+
+    // --headless: frameLimit frames back to back, then the throughput up to
+    // the moment the last one finished on the GPU.
+    auto runHeadless = [&]() {
+        FramePacket frame;
+        frame.framebufferWidth = headless.width();
+        frame.framebufferHeight = headless.height();
+        double start = steady_seconds();
+        double lastStep = start;
+        do {
+            double now = steady_seconds();
+            simulate(NULL, now - lastStep, options.simulationMs, frame);
+            lastStep = now;
+        } while (renderFrame(frame));
+        headless.finish();
+        double seconds = steady_seconds() - start;
+        double pixels = (double)headless.width() * headless.height() * runFrames;
+        std::cout << "Headless: " << runFrames << " frames of " << headless.width() << "x" << headless.height()
+            << " in " << seconds << " s, " << runFrames / seconds << " frames/s, " << seconds * 1e3 / runFrames
+            << " ms/frame, " << pixels / seconds * 1e-6 << " Mpixels/s" << std::endl;
+    };
+
+    if (options.headless) {
+        runHeadless();
+    }
+    else if (options.latencyReport) {
+        runSingleThreaded();
+        FrameTimeSummary singleLatency = latencySeries.summary();
+        FrameTimeSummary singleInterval = presentSeries.summary();
+        latencySeries.clear();
+        presentSeries.clear();
+        lastPresent = -1.0;
+        runFrames = 0;
+        if (!glfwWindowShouldClose(window)) {
+            runRenderThread();
+        }
+        std::cout << "Latency report, " << frameLimit << " frames per model, vsync " << vsync_mode_name(vsync)
+            << ", " << options.simulationMs << " ms simulation per step" << std::endl;
+        std::cout << "One thread (ms):" << std::endl;
+        print_frame_time_header();
+        print_frame_time_summary("latency", singleLatency);
+        print_frame_time_summary("interval", singleInterval);
+        std::cout << "Render thread (ms):" << std::endl;
+        print_frame_time_header();
+        print_frame_time_summary("latency", latencySeries.summary());
+        print_frame_time_summary("interval", presentSeries.summary());
+    }
+    else if (options.renderThread) {
+        runRenderThread();
+    }
+    else {
+        runSingleThreaded();
     }
 
     // 9. ڿ 
-    glDeleteVertexArrays(1, &VAO);
-    glDeleteBuffers(1, &VBO);
-    glDeleteBuffers(1, &EBO);
-    glDeleteProgram(shaderProgram);
-    //delete_scene();
+    if (options.meshlets && frameCount > 0) {
+        std::cout << "Meshlets per frame: " << (double)cullTotals.total / frameCount << ", frustum culled "
+            << (double)cullTotals.frustumCulled / frameCount << ", backface culled "
+            << (double)cullTotals.backfaceCulled / frameCount << ", triangles drawn "
+            << (double)cullTotals.trianglesDrawn / frameCount << " of " << lods[0].mesh.triangleCount() << std::endl;
+    }
+    if (options.drawStats && statFrames > 0) {
+        std::cout << "Draw stats over " << statFrames << " frames: " << statTriangles / statFrames
+            << " triangles, " << (double)drawCalls / frameCount << " draw calls, GPU draw "
+            << statGpuMs / statFrames << " ms, frame "
+            << (steady_seconds() - loopStart) * 1e3 / frameCount << " ms" << std::endl;
+        glDeleteQueries(4, &statQueries[0][0]);
+    }
+    if (options.drawStats && frameCount > 0) {
+        std::cout << "Uniforms per frame: " << (double)uniformTotals.uniformCalls / frameCount << " glUniform calls, "
+            << (double)uniformTotals.bufferUploads / frameCount << " buffer uploads, "
+            << (double)uniformTotals.bytes / frameCount << " bytes (" << setupLookups
+            << " location lookups at startup)" << std::endl;
+        std::cout << "GL state calls per frame: " << (double)glStateTotals.issued / frameCount << " issued, "
+            << (double)glStateTotals.avoided / frameCount << " skipped as redundant" << std::endl;
+    }
+    if (options.glStateCheck) {
+        std::cout << "GL state check: " << glStateTotals.mismatches << " mismatches over " << frameCount
+            << " frames" << std::endl;
+    }
+    if (options.drawStats && options.animate && frameCount > 0) {
+        const RingStats& ring = instanceRing.stats();
+        std::cout << "Instance ring (" << (instanceRing.persistent() ? "persistent" : "glBufferSubData") << "): "
+            << (double)ring.bytes / frameCount << " bytes per frame, " << ring.stalls << " fence stalls ("
+            << ring.stallMs << " ms waiting) over " << ring.frames << " frames" << std::endl;
+    }
+    if (options.lod && frameCount > 0) {
+        std::cout << "Frames per LOD:";
+        for (size_t i = 0; i < lods.size(); ++i) std::cout << " " << lodFrames[i];
+        std::cout << std::endl;
+    }
+
+    if (capture.created()) {
+        capture.finish();
+        CaptureStats stats = capture.stats();
+        std::cout << "Captured " << stats.encoded << " frames to " << options.capturePath << ", "
+            << stats.bytes / 1048576.0 << " MB; " << stats.readbackStalls << " readback stalls, " << stats.encoderWaits
+            << " waits for the " << capture.threads() << " encoder threads, "
+            << (stats.frames > 0 ? stats.copyMs / stats.frames : 0.0) << " ms copy per frame";
+        if (stats.failures > 0) {
+            std::cout << ", " << stats.failures << " failed";
+        }
+        std::cout << std::endl;
+        capture.destroy();
+    }
+
+    for (MeshBuffers& buffers : lodBuffers) {
+        deleteMeshBuffers(buffers);
+    }
+    if (frameTiming) {
+        std::cout << "Vsync " << vsync_mode_name(vsync) << ", frame limit "
+            << (frameLimiter.rate() > 0.0 ? std::to_string(frameLimiter.rate()) + " fps" : std::string("off"))
+            << std::endl;
+        frameTimer.print();
+        if (!options.frameJson.empty() && frameTimer.writeJson(options.frameJson, vsync, frameLimiter.rate())) {
+            std::cout << "Frame statistics written to " << options.frameJson << std::endl;
+        }
+    }
+
+    if (profiler) {
+        profiler->flush();
+        profiler->print();
+        if (!options.gpuCsv.empty()) {
+            std::cout << "GPU pass timings written to " << options.gpuCsv << std::endl;
+        }
+    }
+
+    if (!options.cpuTrace.empty()) {
+        cpu_profiler_enable(false);
+        if (write_chrome_trace(options.cpuTrace)) {
+            std::cout << cpu_profiler_event_count() << " CPU zones written to " << options.cpuTrace << std::endl;
+        }
+    }
+
+    gpuProfiler.destroy();
+    frameTimer.destroy();
+    batch.destroy();
+    instanceRing.destroy();
+    deletePhongUniforms(phongUniforms);
+    shaderVariants.clear();
+    headless.destroy();
     glfwTerminate();
 
     return 0;
@@ -172,6 +986,7 @@ int main() {
 
 // ̴  ε
 std::string loadShaderSource(const std::string& filePath) {
+    PROFILE_ZONE("loadShaderSource");
     std::ifstream shaderFile(filePath);
     if (!shaderFile.is_open()) {
         std::cerr << "Error: Could not open shader file: " << filePath << std::endl;
@@ -183,88 +998,269 @@ std::string loadShaderSource(const std::string& filePath) {
     return shaderStream.str();
 }
 
-// ̴ 
-unsigned int compileShader(unsigned int type, const std::string& source) {
-    unsigned int id = glCreateShader(type);
-    const char* src = source.c_str();
-    glShaderSource(id, 1, &src, nullptr);
-    glCompileShader(id);
-
-    int result;
-    glGetShaderiv(id, GL_COMPILE_STATUS, &result);
-    if (result == GL_FALSE) {
-        int length;
-        glGetShaderiv(id, GL_INFO_LOG_LENGTH, &length);
-        char* message = (char*)alloca(length * sizeof(char));
-        glGetShaderInfoLog(id, length, &length, message);
-        std::cerr << "Failed to compile " << (type == GL_VERTEX_SHADER ? "vertex" : "fragment") << " shader!" << std::endl;
-        std::cerr << message << std::endl;
-        glDeleteShader(id);
-        return 0;
-    }
-    return id;
+// ̴ α׷   ũ
+// Only issues the compiles and the link (submit_program()); the variant
+// cache checks the result once it is ready or needed, so programs submitted
+// together can compile in parallel.
+PendingProgram submitShaderProgram(const std::string& vertexShaderSource, const std::string& fragmentShaderSource) {
+    PROFILE_ZONE("submitShaderProgram");
+    std::vector<ProgramStage> stages(2);
+    stages[0].type = GL_VERTEX_SHADER;
+    stages[0].source = &vertexShaderSource;
+    stages[1].type = GL_FRAGMENT_SHADER;
+    stages[1].source = &fragmentShaderSource;
+    return submit_program(stages);
 }
 
-// ̴ α׷   ũ
-unsigned int createShaderProgram(const std::string& vertexShaderSource, const std::string& fragmentShaderSource) {
-    unsigned int program = glCreateProgram();
-    unsigned int vs = compileShader(GL_VERTEX_SHADER, vertexShaderSource);
-    unsigned int fs = compileShader(GL_FRAGMENT_SHADER, fragmentShaderSource);
+// Vertex -> tessellation control -> tessellation evaluation -> fragment
+PendingProgram submitShaderProgram(const std::string& vertexShaderSource, const std::string& tessControlSource,
+    const std::string& tessEvaluationSource, const std::string& fragmentShaderSource) {
+    PROFILE_ZONE("submitShaderProgram");
+    std::vector<ProgramStage> stages(4);
+    stages[0].type = GL_VERTEX_SHADER;
+    stages[0].source = &vertexShaderSource;
+    stages[1].type = GL_TESS_CONTROL_SHADER;
+    stages[1].source = &tessControlSource;
+    stages[2].type = GL_TESS_EVALUATION_SHADER;
+    stages[2].source = &tessEvaluationSource;
+    stages[3].type = GL_FRAGMENT_SHADER;
+    stages[3].source = &fragmentShaderSource;
+    return submit_program(stages);
+}
+
+// Uploads a mesh into a new VAO/VBO/EBO. The mesh storage is read in place.
+MeshBuffers uploadMesh(const Mesh& mesh) {
+    PROFILE_ZONE("uploadMesh");
+    MeshBuffers buffers;
+    buffers.indexCount = (int)mesh.indexCount();
+    glGenVertexArrays(1, &buffers.VAO);
+    glGenBuffers(1, &buffers.VBO);
+    glGenBuffers(1, &buffers.EBO);
+
+    glBindVertexArray(buffers.VAO);
+
+    glBindBuffer(GL_ARRAY_BUFFER, buffers.VBO);
+    //  ġ  ͸ ļ VBO ε (ġ  ϹǷ mesh.vertices()    )
+    // Ǵ, ͸  (ġ, , ġ, ...) VBO   , ⼭ ϰ ó.
+    //   ġ=̹Ƿ mesh.vertices() .
+    glBufferData(GL_ARRAY_BUFFER, mesh.vertices().size_bytes(), mesh.vertices().data(), GL_STATIC_DRAW);
 
-    if (vs == 0 || fs == 0) return 0;
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers.EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, mesh.indices().size_bytes(), mesh.indices().data(), GL_STATIC_DRAW);
 
-    glAttachShader(program, vs);
-    glAttachShader(program, fs);
-    glLinkProgram(program);
+    //  ġ Ӽ  (location = 0)
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)0);
+    glEnableVertexAttribArray(0);
+    //   Ӽ  (location = 1) - ġ Ϳ  VBO 
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)0);
+    glEnableVertexAttribArray(1);
 
-    int result;
-    glGetProgramiv(program, GL_LINK_STATUS, &result);
-    if (result == GL_FALSE) {
-        int length;
-        glGetProgramiv(program, GL_INFO_LOG_LENGTH, &length);
-        char* message = (char*)alloca(length * sizeof(char));
-        glGetProgramInfoLog(program, length, &length, message);
-        std::cerr << "Failed to link shader program!" << std::endl;
-        std::cerr << message << std::endl;
-        glDeleteProgram(program);
-        program = 0;
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindVertexArray(0);
+
+    return buffers;
+}
+
+// Uploads a quantized mesh and applies its vertex layout (PhongQuantized.vert).
+MeshBuffers uploadEncodedMesh(const EncodedMesh& mesh) {
+    PROFILE_ZONE("uploadEncodedMesh");
+    MeshBuffers buffers;
+    buffers.indexCount = (int)mesh.indexCount;
+    buffers.indexType = mesh.indexType;
+    buffers.positionOffset = mesh.positionOffset;
+    buffers.positionScale = mesh.positionScale;
+    glGenVertexArrays(1, &buffers.VAO);
+    glGenBuffers(1, &buffers.VBO);
+    glGenBuffers(1, &buffers.EBO);
+
+    glBindVertexArray(buffers.VAO);
+
+    glBindBuffer(GL_ARRAY_BUFFER, buffers.VBO);
+    glBufferData(GL_ARRAY_BUFFER, mesh.vertexData.size(), mesh.vertexData.data(), GL_STATIC_DRAW);
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers.EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, mesh.indexData.size(), mesh.indexData.data(), GL_STATIC_DRAW);
+
+    // Integers are passed through unnormalized and decoded in the shader.
+    for (const VertexAttribute& a : mesh.attributes) {
+        glVertexAttribPointer(a.location, a.components, a.type, GL_FALSE, (GLsizei)mesh.vertexStride, (void*)a.offset);
+        glEnableVertexAttribArray(a.location);
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindVertexArray(0);
+
+    return buffers;
+}
+
+// Empty VAO for PhongProcedural.vert: no vertex or index buffer, indexCount
+// is the number of vertices to draw with glDrawArrays.
+MeshBuffers createProceduralSphere(int width, int height) {
+    PROFILE_ZONE("createProceduralSphere");
+    MeshBuffers buffers;
+    buffers.indexCount = (int)(3 * sphere_triangle_count(width, height));
+    glGenVertexArrays(1, &buffers.VAO); // core profile still needs a VAO bound
+    return buffers;
+}
+
+// Adds the SphereInstance array to the VAO as attributes 2 (position, scale)
+// and 3 (material), advancing once per instance.
+void addInstanceBuffer(MeshBuffers& buffers, const std::vector<SphereInstance>& instances) {
+    PROFILE_ZONE("addInstanceBuffer");
+    glBindVertexArray(buffers.VAO);
+    glGenBuffers(1, &buffers.instanceVBO);
+    glBindBuffer(GL_ARRAY_BUFFER, buffers.instanceVBO);
+    glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(SphereInstance), instances.data(), GL_STATIC_DRAW);
+    buffers.instanceCount = (int)instances.size();
+    pointInstanceAttributes(buffers, buffers.instanceVBO, 0);
+}
+
+// Re-points attributes 2 and 3 at a SphereInstance array at offset in
+// buffer (--animate: this frame's slice of the ring buffer).
+void pointInstanceAttributes(const MeshBuffers& buffers, unsigned int buffer, size_t offset) {
+    // Leaves the VAO bound for the draw that follows.
+    gl_state().bindVertexArray(buffers.VAO);
+    gl_state().bindBuffer(GL_ARRAY_BUFFER, buffer);
+
+    glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(SphereInstance),
+        (void*)(offset + offsetof(SphereInstance, position)));
+    glEnableVertexAttribArray(2);
+    glVertexAttribDivisor(2, 1);
+    glVertexAttribIPointer(3, 1, GL_UNSIGNED_INT, sizeof(SphereInstance),
+        (void*)(offset + offsetof(SphereInstance, material)));
+    glEnableVertexAttribArray(3);
+    glVertexAttribDivisor(3, 1);
+}
+
+// Draws index sub-ranges of a mesh (bound VAO) with a single glMultiDrawElements.
+void drawRanges(const MeshBuffers& buffers, const std::vector<DrawRange>& ranges) {
+    static std::vector<GLsizei> counts;
+    static std::vector<const void*> offsets;
+    size_t indexSize = buffers.indexType == GL_UNSIGNED_SHORT ? 2 : 4;
+
+    counts.clear();
+    offsets.clear();
+    for (const DrawRange& r : ranges) {
+        counts.push_back((GLsizei)r.indexCount);
+        offsets.push_back((const void*)(r.indexOffset * indexSize));
     }
+    if (!counts.empty()) {
+        glMultiDrawElements(GL_TRIANGLES, counts.data(), buffers.indexType, offsets.data(), (GLsizei)counts.size());
+    }
+}
 
-    glValidateProgram(program);
+// The surviving meshlet ranges of the packet's mesh
+size_t drawMeshletPacket(const DrawPacket&, void* user) {
+    const MeshletDraw* draw = (const MeshletDraw*)user;
+    drawRanges(*draw->buffers, *draw->ranges);
+    return 1;
+}
 
-    glDeleteShader(vs);
-    glDeleteShader(fs);
+// The whole multi-draw batch; its own VAO is already bound.
+size_t drawBatchPacket(const DrawPacket&, void* user) {
+    return ((MultiDrawBatch*)user)->submit();
+}
 
-    return program;
+void deleteMeshBuffers(MeshBuffers& buffers) {
+    gl_state().deleteVertexArrays(1, &buffers.VAO);
+    gl_state().deleteBuffers(1, &buffers.VBO);
+    gl_state().deleteBuffers(1, &buffers.EBO);
+    gl_state().deleteBuffers(1, &buffers.instanceVBO);
+    buffers = MeshBuffers();
 }
 
 //   
-void setUniforms(unsigned int shaderProgram) {
-    glUniformMatrix4fv(glGetUniformLocation(shaderProgram, "modelMatrix"), 1, GL_FALSE, glm::value_ptr(modelMatrix));
-    glUniformMatrix4fv(glGetUniformLocation(shaderProgram, "viewMatrix"), 1, GL_FALSE, glm::value_ptr(viewMatrix));
-    glUniformMatrix4fv(glGetUniformLocation(shaderProgram, "projectionMatrix"), 1, GL_FALSE, glm::value_ptr(projectionMatrix));
-    glUniformMatrix3fv(glGetUniformLocation(shaderProgram, "normalMatrix"), 1, GL_FALSE, glm::value_ptr(normalMatrix));
-
-    glUniform3fv(glGetUniformLocation(shaderProgram, "eyePosWorld"), 1, glm::value_ptr(eye_pos_world));
-    glUniform3fv(glGetUniformLocation(shaderProgram, "lightPosWorld"), 1, glm::value_ptr(light_pos_world));
-    glUniform3fv(glGetUniformLocation(shaderProgram, "lightIl"), 1, glm::value_ptr(light_Il_intensity));
-    glUniform1f(glGetUniformLocation(shaderProgram, "lightIa"), light_Ia_intensity);
-
-    glUniform3fv(glGetUniformLocation(shaderProgram, "matKa"), 1, glm::value_ptr(mat_ka));
-    glUniform3fv(glGetUniformLocation(shaderProgram, "matKd"), 1, glm::value_ptr(mat_kd));
-    glUniform3fv(glGetUniformLocation(shaderProgram, "matKs"), 1, glm::value_ptr(mat_ks));
-    glUniform1f(glGetUniformLocation(shaderProgram, "matShininess"), mat_p_shininess);
-
-    glUniform1f(glGetUniformLocation(shaderProgram, "gamma"), gamma_val);
+// The blocks are rewritten every frame, but a buffer is only uploaded when
+// its bytes changed: the light and material once, the camera and object
+// when they move.
+void setUniforms(PhongUniforms& uniforms) {
+    PROFILE_ZONE("setUniforms");
+    CameraBlock camera = {};
+    camera.viewMatrix = viewMatrix;
+    camera.projectionMatrix = projectionMatrix;
+    camera.eyePosWorld = eye_pos_world;
+    camera.gamma = gamma_val;
+    uniforms.camera.update(camera);
+
+    LightBlock light = {};
+    light.lightPosWorld = light_pos_world;
+    light.lightIa = light_Ia_intensity;
+    light.lightIl = light_Il_intensity;
+    uniforms.light.update(light);
+
+    MaterialBlock material = {};
+    material.matKa = mat_ka;
+    material.matKd = mat_kd;
+    material.matKs = mat_ks;
+    material.matShininess = mat_p_shininess;
+    uniforms.material.update(material);
+
+    ObjectBlock object = {};
+    object.modelMatrix = modelMatrix;
+    object.setNormalMatrix(normalMatrix);
+    uniforms.object.update(object);
+
+    MaterialPaletteBlock palette;
+    fill_material_palette(material, palette);
+    uniforms.palette.update(palette);
+
+    uniforms.camera.upload();
+    uniforms.light.upload();
+    uniforms.material.upload();
+    uniforms.object.upload();
+    uniforms.palette.upload();
+}
+
+bool createPhongUniforms(PhongUniforms& uniforms) {
+    return uniforms.camera.create(sizeof(CameraBlock), kCameraBinding) &&
+        uniforms.light.create(sizeof(LightBlock), kLightBinding) &&
+        uniforms.material.create(sizeof(MaterialBlock), kMaterialBinding) &&
+        uniforms.object.create(sizeof(ObjectBlock), kObjectBinding) &&
+        uniforms.palette.create(sizeof(MaterialPaletteBlock), kPaletteBinding);
+}
+
+// Before the context goes away; the destructors would run too late.
+void deletePhongUniforms(PhongUniforms& uniforms) {
+    uniforms.camera.destroy();
+    uniforms.light.destroy();
+    uniforms.material.destroy();
+    uniforms.object.destroy();
+    uniforms.palette.destroy();
 }
 
 
-void processInput(GLFWwindow* window) {
+// Sphere model matrix from its current distance; the normal matrix follows.
+void updateModelMatrix(float distance) {
+    modelMatrix = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, -distance)) *
+        glm::scale(glm::mat4(1.0f), glm::vec3(sphereScale));
+    normalMatrix = glm::transpose(glm::inverse(glm::mat3(modelMatrix)));
+}
+
+// Up/Down move the sphere by 2% per 1/60 s, whatever the step rate.
+void processInput(GLFWwindow* window, double seconds) {
+    float step = std::pow(1.02f, (float)(seconds * 60.0));
     if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
         glfwSetWindowShouldClose(window, true);
+    if (glfwGetKey(window, GLFW_KEY_UP) == GLFW_PRESS)
+        sphereDistance = std::min(sphereDistance * step, 500.0f);
+    if (glfwGetKey(window, GLFW_KEY_DOWN) == GLFW_PRESS)
+        sphereDistance = std::max(sphereDistance / step, sphereScale + 0.2f);
 }
 
-// â ũ  ݹ
-void framebuffer_size_callback(GLFWwindow* window, int width, int height) {
-    glViewport(0, 0, width, height);
-}
\ No newline at end of file
+// One simulation step on the main thread, after the events were polled.
+// workMs of busy waiting stands in for game logic (--sim-ms). Without a
+// window (--headless) there is no input and the packet keeps its size.
+void simulate(GLFWwindow* window, double seconds, float workMs, FramePacket& packet) {
+    PROFILE_ZONE("simulate");
+    double inputTime = steady_seconds();
+    if (window != NULL) {
+        processInput(window, seconds);
+    }
+    while (steady_seconds() - inputTime < workMs * 1e-3) {
+    }
+    packet.inputTime = inputTime;
+    packet.sphereDistance = sphereDistance;
+    if (window != NULL) {
+        glfwGetFramebufferSize(window, &packet.framebufferWidth, &packet.framebufferHeight);
+    }
+}
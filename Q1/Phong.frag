@@ -5,18 +5,78 @@ in vec3 v_WorldPos;
 in vec3 v_WorldNormal;
 
 // C++ ޵ Uniform 
-uniform vec3 eyePosWorld;
+layout (std140) uniform CameraBlock // per frame, see uniforms.h
+{
+    mat4 viewMatrix;
+    mat4 projectionMatrix;
+    vec3 eyePosWorld;
+    float gamma;        // Gamma value (2.2)
+};
+
+layout (std140) uniform LightBlock // per light
+{
+    vec3 lightPosWorld;
+    float lightIa;
+    vec3 lightIl;
+};
+
+layout (std140) uniform MaterialBlock // per material
+{
+    vec3 matKa;
+    vec3 matKd;
+    vec3 matKs;         // Specular reflectivity (0.5, 0.5, 0.5)
+    float matShininess;
+};
+
+#ifdef MATERIAL_PALETTE
+// Per-instance material: PhongInstanced.vert passes an index into a palette
+// of MATERIAL_PALETTE entries (MaterialPaletteBlock in uniforms.h).
+flat in int v_Material;
 
-uniform vec3 lightPosWorld;
-uniform vec3 lightIl;       
-uniform float lightIa;     
+struct Material
+{
+    vec3 ka;
+    vec3 kd;
+    vec3 ks;
+    float shininess;
+};
+layout (std140) uniform MaterialPaletteBlock
+{
+    Material materials[MATERIAL_PALETTE];
+};
 
-uniform vec3 matKa;         
-uniform vec3 matKd;        
-uniform vec3 matKs;         // Specular reflectivity (0.5, 0.5, 0.5)
-uniform float matShininess; // 
+#define MAT_KA materials[v_Material].ka
+#define MAT_KD materials[v_Material].kd
+#define MAT_KS materials[v_Material].ks
+#define MAT_SHININESS materials[v_Material].shininess
+#endif
 
-uniform float gamma;        // Gamma value (2.2)
+// Permutation switches and constant-folded parameters, injected as #defines
+// after #version by shader_variants.cpp. Without them this is the generic
+// shader reading everything from the blocks above.
+#ifndef SPECULAR
+#define SPECULAR 1
+#endif
+#ifndef BLINN
+#define BLINN 0
+#endif
+#ifndef GAMMA_CORRECT
+#define GAMMA_CORRECT 1
+#endif
+#ifndef MAT_KA
+#define MAT_KA matKa
+#define MAT_KD matKd
+#define MAT_KS matKs
+#define MAT_SHININESS matShininess
+#endif
+#ifndef LIGHT_POS
+#define LIGHT_POS lightPosWorld
+#define LIGHT_IA lightIa
+#define LIGHT_IL lightIl
+#endif
+#ifndef GAMMA
+#define GAMMA gamma
+#endif
 
 void main()
 {
@@ -24,24 +84,37 @@ void main()
     vec3 N = normalize(v_WorldNormal);
     
     // 1. Ambient Term
-    vec3 ambient = lightIa * matKa;
+    vec3 ambient = LIGHT_IA * MAT_KA;
 
     // 2. Diffuse Term
-    vec3 L = normalize(lightPosWorld - v_WorldPos);
+    vec3 L = normalize(LIGHT_POS - v_WorldPos);
     float diffFactor = max(dot(N, L), 0.0);
-    vec3 diffuse = lightIl * matKd * diffFactor;
+    vec3 diffuse = LIGHT_IL * MAT_KD * diffFactor;
 
-    // 3. Specular Term (Phong)
+    // 3. Specular Term (Phong, or Blinn-Phong with BLINN)
+#if SPECULAR
     vec3 V = normalize(eyePosWorld - v_WorldPos);
+#if BLINN
+    vec3 H = normalize(L + V);
+    float specFactor = pow(max(dot(N, H), 0.0), MAT_SHININESS);
+#else
     vec3 R = reflect(-L, N);
-    float specFactor = pow(max(dot(V, R), 0.0), matShininess);
-    vec3 specular = lightIl * matKs * specFactor;
+    float specFactor = pow(max(dot(V, R), 0.0), MAT_SHININESS);
+#endif
+    vec3 specular = LIGHT_IL * MAT_KS * specFactor;
+#else
+    vec3 specular = vec3(0.0);
+#endif
 
     //   ( )
     vec3 finalColorLinear = ambient + diffuse + specular;
     
     //  
-    vec3 finalColorGammaCorrected = pow(finalColorLinear, vec3(1.0 / gamma));
+#if GAMMA_CORRECT
+    vec3 finalColorGammaCorrected = pow(finalColorLinear, vec3(1.0 / GAMMA));
+#else
+    vec3 finalColorGammaCorrected = finalColorLinear;
+#endif
 
     FragColor = vec4(finalColorGammaCorrected, 1.0);
 }
\ No newline at end of file
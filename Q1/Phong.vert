@@ -5,10 +5,18 @@ layout (location = 1) in vec3 aNormal; //
 out vec3 v_WorldPos;    // 
 out vec3 v_WorldNormal; //   
 
-uniform mat4 modelMatrix;
-uniform mat4 viewMatrix;
-uniform mat4 projectionMatrix;
-uniform mat3 normalMatrix; // transpose(inverse(mat3(modelMatrix)))
+layout (std140) uniform CameraBlock // per frame, see uniforms.h
+{
+    mat4 viewMatrix;
+    mat4 projectionMatrix;
+    vec3 eyePosWorld;
+    float gamma;
+};
+layout (std140) uniform ObjectBlock // per object
+{
+    mat4 modelMatrix;
+    mat3 normalMatrix; // transpose(inverse(mat3(modelMatrix)))
+};
 
 void main()
 {
@@ -0,0 +1,43 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec4 aInstance;         // SphereInstance position (xyz) and scale (w)
+layout (location = 3) in uint aInstanceMaterial; // SphereInstance material
+
+out vec3 v_WorldPos;
+out vec3 v_WorldNormal;
+flat out int v_Material;
+
+layout (std140) uniform CameraBlock // per frame, see uniforms.h
+{
+    mat4 viewMatrix;
+    mat4 projectionMatrix;
+    vec3 eyePosWorld;
+    float gamma;
+};
+layout (std140) uniform ObjectBlock // the whole group of instances
+{
+    mat4 modelMatrix;
+    mat3 normalMatrix; // unused, derived per instance below
+};
+
+void main()
+{
+    // Instance transform (scale, then translate) inside the group transform
+    mat4 instanceMatrix = mat4(vec4(aInstance.w, 0.0, 0.0, 0.0),
+                               vec4(0.0, aInstance.w, 0.0, 0.0),
+                               vec4(0.0, 0.0, aInstance.w, 0.0),
+                               vec4(aInstance.xyz, 1.0));
+    mat4 model = modelMatrix * instanceMatrix;
+    v_WorldPos = vec3(model * vec4(aPos, 1.0));
+
+    // Normal matrix derived here instead of uploaded per instance: the
+    // cofactor matrix equals transpose(inverse(m)) * determinant(m), and the
+    // positive factor disappears in normalize().
+    mat3 m = mat3(model);
+    mat3 cofactor = mat3(cross(m[1], m[2]), cross(m[2], m[0]), cross(m[0], m[1]));
+    v_WorldNormal = normalize(cofactor * aNormal);
+    v_Material = int(aInstanceMaterial);
+
+    gl_Position = projectionMatrix * viewMatrix * vec4(v_WorldPos, 1.0);
+}
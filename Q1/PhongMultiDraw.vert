@@ -0,0 +1,59 @@
+#version 330 core
+// USE_DRAW_ID is injected by MultiDrawBatch when glMultiDrawElementsIndirect
+// and ARB_shader_draw_parameters are both available.
+#ifndef USE_DRAW_ID
+#define USE_DRAW_ID 0
+#endif
+#if USE_DRAW_ID
+#extension GL_ARB_shader_draw_parameters : require
+#endif
+
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in uint aDrawID; // 0, 1, 2, ... picked by the command's baseInstance
+
+out vec3 v_WorldPos;
+out vec3 v_WorldNormal;
+flat out int v_Material;
+
+layout (std140) uniform CameraBlock // per frame, see uniforms.h
+{
+    mat4 viewMatrix;
+    mat4 projectionMatrix;
+    vec3 eyePosWorld;
+    float gamma;
+};
+layout (std140) uniform ObjectBlock // the whole batch
+{
+    mat4 modelMatrix;
+    mat3 normalMatrix; // unused, derived per draw below
+};
+
+// BatchDrawData (multi_draw.h), two RGBA32F texels per draw:
+// position (xyz) and scale (w), then the material index (x)
+uniform samplerBuffer drawData;
+
+void main()
+{
+#if USE_DRAW_ID
+    int drawID = gl_DrawIDARB;
+#else
+    int drawID = int(aDrawID);
+#endif
+    vec4 positionScale = texelFetch(drawData, 2 * drawID);
+    v_Material = int(texelFetch(drawData, 2 * drawID + 1).x);
+
+    mat4 drawMatrix = mat4(vec4(positionScale.w, 0.0, 0.0, 0.0),
+                           vec4(0.0, positionScale.w, 0.0, 0.0),
+                           vec4(0.0, 0.0, positionScale.w, 0.0),
+                           vec4(positionScale.xyz, 1.0));
+    mat4 model = modelMatrix * drawMatrix;
+    v_WorldPos = vec3(model * vec4(aPos, 1.0));
+
+    // Cofactor normal matrix, as in PhongInstanced.vert
+    mat3 m = mat3(model);
+    mat3 cofactor = mat3(cross(m[1], m[2]), cross(m[2], m[0]), cross(m[0], m[1]));
+    v_WorldNormal = normalize(cofactor * aNormal);
+
+    gl_Position = projectionMatrix * viewMatrix * vec4(v_WorldPos, 1.0);
+}
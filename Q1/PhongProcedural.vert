@@ -0,0 +1,76 @@
+#version 330 core
+// Attribute-less UV sphere: draw 3 * triangle count vertices with an empty
+// VAO and every vertex is generated from gl_VertexID, in the same vertex
+// numbering and triangle order as create_sphere(width, height).
+
+out vec3 v_WorldPos;
+out vec3 v_WorldNormal;
+
+layout (std140) uniform CameraBlock // per frame, see uniforms.h
+{
+    mat4 viewMatrix;
+    mat4 projectionMatrix;
+    vec3 eyePosWorld;
+    float gamma;
+};
+layout (std140) uniform ObjectBlock // per object
+{
+    mat4 modelMatrix;
+    mat3 normalMatrix; // transpose(inverse(mat3(modelMatrix)))
+};
+
+uniform ivec2 sphereResolution; // create_sphere() width, height
+
+const float PI = 3.14159265358979;
+
+// create_sphere() vertex index of corner `corner` of triangle `tri`
+int sphereIndex(int tri, int corner, int width, int height)
+{
+    // Two triangles per quad between the (height - 2) rings
+    int quads = (height - 3) * (width - 1);
+    if (tri < 2 * quads) {
+        int q = tri / 2;
+        int j = q / (width - 1);
+        int i = q - j * (width - 1);
+        int a = j * width + i;
+        int b = (j + 1) * width + (i + 1);
+        if ((tri & 1) == 0)
+            return corner == 0 ? a : corner == 1 ? b : a + 1;
+        return corner == 0 ? a : corner == 1 ? a + width : b;
+    }
+
+    // Fans around the poles, stored after the rings
+    int northPole = (height - 2) * width;
+    int k = tri - 2 * quads;
+    if (k < width - 1)
+        return corner == 0 ? northPole : corner == 1 ? k : k + 1;
+    k -= width - 1;
+    int bottomRing = (height - 3) * width;
+    return corner == 0 ? northPole + 1 : corner == 1 ? bottomRing + k + 1 : bottomRing + k;
+}
+
+vec3 sphereVertex(int index, int width, int height)
+{
+    int northPole = (height - 2) * width;
+    if (index == northPole) return vec3(0.0, 1.0, 0.0);
+    if (index == northPole + 1) return vec3(0.0, -1.0, 0.0);
+
+    int ring = index / width;
+    int i = index - ring * width;
+    float theta = float(ring + 1) / float(height - 1) * PI;
+    float phi = float(i) / float(width - 1) * PI * 2.0;
+    return vec3(sin(theta) * cos(phi), cos(theta), -sin(theta) * sin(phi));
+}
+
+void main()
+{
+    int tri = gl_VertexID / 3;
+    int corner = gl_VertexID - tri * 3;
+    vec3 aPos = sphereVertex(sphereIndex(tri, corner, sphereResolution.x, sphereResolution.y),
+                             sphereResolution.x, sphereResolution.y);
+
+    // Unit sphere: the position is the normal.
+    v_WorldPos = vec3(modelMatrix * vec4(aPos, 1.0));
+    v_WorldNormal = normalize(normalMatrix * aPos);
+    gl_Position = projectionMatrix * viewMatrix * vec4(v_WorldPos, 1.0);
+}
@@ -0,0 +1,45 @@
+#version 330 core
+layout (location = 0) in vec4 aPosQ;    // int16 x 4, relative to the mesh bounds
+layout (location = 1) in vec4 aNormalQ; // oct16 (xy) or 10_10_10_2 (xyz), unnormalized
+
+out vec3 v_WorldPos;
+out vec3 v_WorldNormal;
+
+layout (std140) uniform CameraBlock // per frame, see uniforms.h
+{
+    mat4 viewMatrix;
+    mat4 projectionMatrix;
+    vec3 eyePosWorld;
+    float gamma;
+};
+layout (std140) uniform ObjectBlock // per object
+{
+    mat4 modelMatrix;
+    mat3 normalMatrix; // transpose(inverse(mat3(modelMatrix)))
+};
+
+uniform vec3 positionOffset; // EncodedMesh::positionOffset
+uniform vec3 positionScale;  // EncodedMesh::positionScale
+uniform int normalEncoding;  // 0 = octahedral snorm16, 1 = snorm 10_10_10_2
+
+vec3 octDecode(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (n.z < 0.0)
+        n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    return normalize(n);
+}
+
+void main()
+{
+    vec3 aPos = positionOffset + positionScale * aPosQ.xyz;
+    vec3 aNormal;
+    if (normalEncoding == 0)
+        aNormal = octDecode(max(aNormalQ.xy / 32767.0, vec2(-1.0)));
+    else
+        aNormal = normalize(max(aNormalQ.xyz / 511.0, vec3(-1.0)));
+
+    v_WorldPos = vec3(modelMatrix * vec4(aPos, 1.0));
+    v_WorldNormal = normalize(normalMatrix * aNormal);
+    gl_Position = projectionMatrix * viewMatrix * vec4(v_WorldPos, 1.0);
+}
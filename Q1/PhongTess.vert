@@ -0,0 +1,10 @@
+#version 400 core
+layout (location = 0) in vec3 aPos; // base mesh vertex on the unit sphere
+
+out vec3 vs_ObjectPos;
+
+void main()
+{
+    // Projection happens after refinement in PhongTess.tese.
+    vs_ObjectPos = aPos;
+}
@@ -0,0 +1,702 @@
+//
+//  benchmarks.cpp
+//  CPU-side benchmarks and reports for the scene generators
+//
+
+#include <stdio.h>
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include "benchmarks.h"
+#include "sphere_scene.h"
+#include "mesh_encode.h"
+#include "mesh_optimize.h"
+#include "meshlet.h"
+#include "mesh_simplify.h"
+#include "parallel.h"
+#include "cpu_profiler.h"
+#include "render_queue.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+namespace {
+
+double seconds_since(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// The original single-threaded, per-vertex create_scene() loops, kept as the
+// reference that create_sphere() must reproduce bit for bit.
+void reference_sphere(int width, int height, std::vector<glm::vec3>& vertices, std::vector<int>& indices)
+{
+    vertices.resize((size_t)(height - 2) * width + 2);
+    indices.resize(3 * (size_t)((height - 3) * (width - 1) * 2 + (width - 1) * 2));
+
+    float theta, phi;
+    size_t t = 0;
+    for (int j = 1; j < height - 1; ++j)
+    {
+        for (int i = 0; i < width; ++i)
+        {
+            theta = (float)j / (height - 1) * M_PI;
+            phi = (float)i / (width - 1) * M_PI * 2;
+
+            float   x = sinf(theta) * cosf(phi);
+            float   y = cosf(theta);
+            float   z = -sinf(theta) * sinf(phi);
+
+            vertices[t++] = glm::vec3(x, y, z);
+        }
+    }
+    vertices[t++] = glm::vec3(0.0f, 1.0f, 0.0f);
+    vertices[t++] = glm::vec3(0.0f, -1.0f, 0.0f);
+
+    t = 0;
+    for (int j = 0; j < height - 3; ++j)
+    {
+        for (int i = 0; i < width - 1; ++i)
+        {
+            indices[t++] = j * width + i;
+            indices[t++] = (j + 1) * width + (i + 1);
+            indices[t++] = j * width + (i + 1);
+
+            indices[t++] = j * width + i;
+            indices[t++] = (j + 1) * width + i;
+            indices[t++] = (j + 1) * width + (i + 1);
+        }
+    }
+
+    int northPoleIndex = (height - 2) * width;
+    int southPoleIndex = northPoleIndex + 1;
+    for (int i = 0; i < width - 1; ++i)
+    {
+        indices[t++] = northPoleIndex;
+        indices[t++] = i;
+        indices[t++] = i + 1;
+    }
+
+    int bottomStripStart = (height - 3) * width;
+    for (int i = 0; i < width - 1; ++i)
+    {
+        indices[t++] = southPoleIndex;
+        indices[t++] = bottomStripStart + (i + 1);
+        indices[t++] = bottomStripStart + i;
+    }
+}
+
+bool matches_reference(int width, int height, const SphereOptions& options)
+{
+    std::vector<glm::vec3> refVertices;
+    std::vector<int> refIndices;
+    reference_sphere(width, height, refVertices, refIndices);
+
+    Mesh mesh = create_sphere(width, height, options);
+    return !mesh.empty() &&
+        mesh.vertexCount() == refVertices.size() &&
+        mesh.indexCount() == refIndices.size() &&
+        memcmp(mesh.vertices().data(), refVertices.data(), mesh.vertices().size_bytes()) == 0 &&
+        memcmp(mesh.indices().data(), refIndices.data(), mesh.indices().size_bytes()) == 0;
+}
+
+// Height of the smallest UV sphere in the create_scene() layout
+// (width = 2 * height) whose deviation is within maxError.
+int uv_height_for_error(float maxError)
+{
+    int lo = 3, hi = 4;
+    while (hi < 4096) {
+        if (measure_sphere_error(create_sphere(2 * hi, hi)) <= maxError)
+            break;
+        lo = hi + 1;
+        hi *= 2;
+    }
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (measure_sphere_error(create_sphere(2 * mid, mid)) <= maxError)
+            hi = mid;
+        else
+            lo = mid + 1;
+    }
+    return lo;
+}
+
+void print_layout(const char* layout, const char* resolution, const Mesh& mesh, const Mesh* uv)
+{
+    printf("  %-10s %-12s %12zu %12zu %12.3g", layout, resolution, mesh.vertexCount(), mesh.triangleCount(),
+        measure_sphere_error(mesh));
+    if (uv) printf("  (%.0f%% of uv)", 100.0 * mesh.triangleCount() / uv->triangleCount());
+    printf("\n");
+}
+
+// Returns false when the icosphere or the cube sphere needs more triangles
+// than the UV sphere for the same error.
+bool report_sphere_error(const char* label, float maxError)
+{
+    printf("target error %.3g (%s)\n", maxError, label);
+    printf("  %-10s %-12s %12s %12s %12s\n", "layout", "resolution", "vertices", "triangles", "max error");
+
+    char resolution[32];
+    int h = uv_height_for_error(maxError);
+    Mesh uv = create_sphere(2 * h, h);
+    snprintf(resolution, sizeof(resolution), "%dx%d", 2 * h, h);
+    print_layout("uv", resolution, uv, nullptr);
+
+    Mesh icosphere = create_icosphere(maxError);
+    snprintf(resolution, sizeof(resolution), "freq %d", icosphere_frequency_for_error(maxError));
+    print_layout("icosphere", resolution, icosphere, &uv);
+
+    Mesh cube = create_cube_sphere(maxError);
+    int n = cube_sphere_resolution_for_error(maxError);
+    snprintf(resolution, sizeof(resolution), "6x%dx%d", n, n);
+    print_layout("cube", resolution, cube, &uv);
+
+    bool fewer = icosphere.triangleCount() <= uv.triangleCount() && cube.triangleCount() <= uv.triangleCount();
+    if (!fewer) printf("  icosphere or cube needs more triangles than uv\n");
+    return fewer;
+}
+
+void report_quantization(int width, int height)
+{
+    Mesh mesh = create_sphere(width, height);
+    if (mesh.empty()) return;
+
+    // Float baselines: positions + separate normals, and the viewer's shared
+    // position/normal buffer. Both with 32-bit indices.
+    double indexBytes = (double)mesh.indices().size_bytes();
+    double separate = mesh.vertexCount() * 2.0 * sizeof(glm::vec3) + indexBytes;
+    double shared = (double)mesh.vertices().size_bytes() + indexBytes;
+
+    printf("sphere %dx%d: %zu vertices, %zu triangles\n", width, height, mesh.vertexCount(), mesh.triangleCount());
+    printf("  %-22s %8s %8s %12s %9s %9s %14s %12s\n", "format", "B/vert", "B/index", "total bytes",
+        "vs 24B", "vs 12B", "max pos err", "max n err");
+    printf("  %-22s %8d %8d %12.0f %8.0f%% %8.0f%% %14s %12s\n", "float pos + normal", 24, 4, separate,
+        100.0, 100.0 * separate / shared, "0", "0");
+    printf("  %-22s %8d %8d %12.0f %8.0f%% %8.0f%% %14s %12s\n", "float pos (shared)", 12, 4, shared,
+        100.0 * shared / separate, 100.0, "0", "0");
+
+    const NormalEncoding encodings[] = { NormalEncoding::Oct16, NormalEncoding::Snorm1010102 };
+    const char* names[] = { "snorm16 + oct16", "snorm16 + 10_10_10_2" };
+    for (int e = 0; e < 2; ++e) {
+        EncodeOptions options;
+        options.normals = encodings[e];
+        EncodedMesh encoded = encode_mesh(mesh, nullptr, options);
+        double total = (double)encoded.vertexData.size() + encoded.indexData.size();
+        printf("  %-22s %8zu %8d %12.0f %8.0f%% %8.0f%% %14.3g %10.4f deg\n", names[e], encoded.vertexStride,
+            encoded.indexType == GL_UNSIGNED_SHORT ? 2 : 4, total, 100.0 * total / separate, 100.0 * total / shared,
+            encoded.maxPositionError, encoded.maxNormalErrorDeg);
+    }
+}
+
+void report_vertex_cache(const char* name, Mesh mesh, int cacheSize, CacheModel model)
+{
+    if (mesh.empty()) return;
+    CacheStats before = simulate_vertex_cache(mesh.indices().data(), mesh.indexCount(), mesh.vertexCount(),
+        cacheSize, model);
+
+    auto start = std::chrono::steady_clock::now();
+    optimize_vertex_cache(mesh, cacheSize);
+    double ms = seconds_since(start) * 1e3;
+
+    CacheStats after = simulate_vertex_cache(mesh.indices().data(), mesh.indexCount(), mesh.vertexCount(),
+        cacheSize, model);
+    printf("  %-22s %10zu %8.3f %8.3f %8.3f %8.3f %10.2f\n", name, mesh.triangleCount(),
+        before.acmr, after.acmr, before.atvr, after.atvr, ms);
+}
+
+// Icosphere with radial bumps: a non-convex surface that, unlike the plain
+// sphere, overdraws even with back-face culling.
+Mesh bumpy_sphere()
+{
+    Mesh mesh = create_icosphere(0.0f, 32);
+    for (glm::vec3& v : mesh.vertices()) {
+        v *= 1.0f + 0.25f * sinf(7.0f * v.x) * sinf(7.0f * v.y) * sinf(7.0f * v.z);
+    }
+    return mesh;
+}
+
+// Returns false when optimize_overdraw() raised the ACMR by more than its
+// threshold.
+bool report_overdraw(const char* name, Mesh mesh, bool cull)
+{
+    if (mesh.empty()) return true;
+    const int cacheSize = 16;
+    const float threshold = 1.05f;
+    const size_t vertexBytes = sizeof(glm::vec3);
+
+    auto overdraw = [&]() {
+        return estimate_overdraw(mesh.vertices().data(), mesh.indices().data(), mesh.indexCount(),
+            256, 16, cull).overdraw;
+    };
+    auto acmr = [&]() {
+        return simulate_vertex_cache(mesh.indices().data(), mesh.indexCount(), mesh.vertexCount(),
+            cacheSize, CacheModel::Fifo).acmr;
+    };
+    auto fetch = [&]() {
+        return simulate_vertex_fetch(mesh.indices().data(), mesh.indexCount(), mesh.vertexCount(), vertexBytes);
+    };
+
+    double overdraw0 = overdraw(), acmr0 = acmr();
+    optimize_vertex_cache(mesh, cacheSize);
+    double overdraw1 = overdraw(), acmr1 = acmr();
+    optimize_overdraw(mesh, cacheSize, threshold);
+    double overdraw2 = overdraw(), acmr2 = acmr();
+    double fetch2 = fetch();
+    optimize_vertex_fetch(mesh);
+    double fetch3 = fetch();
+
+    printf("  %-20s %9zu | %6.3f %6.3f %6.3f | %6.3f %6.3f %6.3f | %6.2f %6.2f\n", name, mesh.triangleCount(),
+        overdraw0, overdraw1, overdraw2, acmr0, acmr1, acmr2, fetch2, fetch3);
+    if (acmr2 > acmr1 * threshold) {
+        printf("  %-20s ACMR rose %.3f -> %.3f, past the %.2fx bound\n", "", acmr1, acmr2, threshold);
+        return false;
+    }
+    return true;
+}
+
+// Culls the meshlets of a unit sphere drawn with `model` by the viewer's
+// camera and checks that no meshlet with a front-facing triangle is dropped
+// by the normal cone test.
+void report_meshlet_culling(const char* view, const Mesh& mesh, const std::vector<Meshlet>& meshlets,
+    const glm::mat4& model)
+{
+    glm::vec3 eye(0.0f);
+    glm::mat4 viewMatrix = glm::lookAt(eye, glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    glm::mat4 projection = glm::frustum(-0.1f, 0.1f, -0.1f, 0.1f, 0.1f, 1000.0f);
+    Frustum frustum = extract_frustum(projection * viewMatrix * model);
+    glm::vec3 camera = glm::vec3(glm::inverse(model) * glm::vec4(eye, 1.0f));
+
+    std::vector<DrawRange> ranges;
+    auto start = std::chrono::steady_clock::now();
+    CullStats stats = cull_meshlets(meshlets, frustum, camera, ranges);
+    double us = seconds_since(start) * 1e6;
+
+    // Front-facing triangles that are not in any surviving range.
+    size_t wrong = 0;
+    const glm::vec3* v = mesh.vertices().data();
+    const int* idx = mesh.indices().data();
+    std::vector<char> drawn(mesh.triangleCount(), 0);
+    for (const DrawRange& r : ranges)
+        std::fill(drawn.begin() + r.indexOffset / 3, drawn.begin() + (r.indexOffset + r.indexCount) / 3, 1);
+    for (const Meshlet& m : meshlets) {
+        bool insideFrustum = true;
+        for (const glm::vec4& p : frustum.planes)
+            if (glm::dot(glm::vec3(p), m.center) + p.w < -m.radius) insideFrustum = false;
+        if (!insideFrustum) continue;
+        for (size_t t = m.indexOffset / 3; t < (m.indexOffset + m.indexCount) / 3; ++t) {
+            const glm::vec3& a = v[idx[3 * t]];
+            glm::vec3 n = glm::cross(v[idx[3 * t + 1]] - a, v[idx[3 * t + 2]] - a);
+            if (!drawn[t] && glm::dot(camera - a, n) > 0.0f) ++wrong;
+        }
+    }
+
+    printf("    %-14s frustum culled %5zu, backface culled %5zu, triangles drawn %5.1f%%, %zu ranges, %.1f us, "
+        "front-facing triangles lost: %zu\n", view, stats.frustumCulled, stats.backfaceCulled,
+        100.0 * stats.trianglesDrawn / mesh.triangleCount(), ranges.size(), us, wrong);
+}
+
+void report_meshlets(const char* name, Mesh mesh)
+{
+    if (mesh.empty()) return;
+    optimize_vertex_cache(mesh);
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<Meshlet> meshlets = build_meshlets(mesh);
+    double ms = seconds_since(start) * 1e3;
+
+    double vertices = 0.0, triangles = 0.0;
+    for (const Meshlet& m : meshlets) {
+        vertices += m.vertexCount;
+        triangles += m.indexCount / 3;
+    }
+    printf("  %s: %zu meshlets (64 verts / 124 tris max), avg %.1f vertices %.1f triangles, built in %.2f ms\n",
+        name, meshlets.size(), vertices / meshlets.size(), triangles / meshlets.size(), ms);
+
+    glm::mat4 viewerModel = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, -7.0f)) *
+        glm::scale(glm::mat4(1.0f), glm::vec3(2.0f));
+    glm::mat4 closeUp = glm::translate(glm::mat4(1.0f), glm::vec3(0.8f, 0.0f, -2.6f)) *
+        glm::scale(glm::mat4(1.0f), glm::vec3(2.0f));
+    report_meshlet_culling("viewer camera", mesh, meshlets, viewerModel);
+    report_meshlet_culling("close-up", mesh, meshlets, closeUp);
+}
+
+void report_lod_chain(const char* name, Mesh mesh)
+{
+    if (mesh.empty()) return;
+    printf("  %s\n", name);
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<LodLevel> levels = build_lod_chain(mesh);
+    double total = seconds_since(start);
+
+    // The viewer draws the unit sphere scaled by 2 into 512 pixels with a
+    // projection[1][1] of 1, so one object unit spans 512 pixels at depth 1.
+    const float pixelsAtDepth1 = 2.0f * 512.0f * 0.5f;
+    printf("    %5s %10s %7s %12s %10s %14s\n", "level", "triangles", "ratio", "error", "ms", "1px beyond z");
+    for (size_t i = 0; i < levels.size(); ++i) {
+        const LodLevel& level = levels[i];
+        printf("    %5zu %10zu %6.1f%% %12.3g %10.1f %14.1f\n", i, level.mesh.triangleCount(), level.ratio * 100.0f,
+            level.error, level.seconds * 1e3, level.error * pixelsAtDepth1);
+    }
+
+    // Thread scaling of the first (largest) simplification.
+    size_t target = mesh.triangleCount() / 2;
+    SimplifyOptions serial;
+    serial.numThreads = 1;
+    start = std::chrono::steady_clock::now();
+    simplify_mesh(mesh, target, nullptr, serial);
+    double serialSeconds = seconds_since(start);
+    start = std::chrono::steady_clock::now();
+    simplify_mesh(mesh, target);
+    double threadedSeconds = seconds_since(start);
+    printf("    chain incl. error measurement %.2f s; 50%% level on 1 thread %.1f ms, %d threads %.1f ms\n",
+        total, serialSeconds * 1e3, resolve_thread_count(0), threadedSeconds * 1e3);
+}
+
+// Empty zones in a loop, minus the loop itself. volatile keeps the
+// compiler from folding the loop away.
+double zone_ns(size_t count, bool zone)
+{
+    volatile size_t sink = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < count; ++i) {
+        if (zone) {
+            PROFILE_ZONE("overhead");
+            sink = sink + i;
+        }
+        else {
+            sink = sink + i;
+        }
+    }
+    return seconds_since(start) * 1e9 / count;
+}
+
+// Best of a few runs; only for loops that record nothing, since every
+// enabled run adds count events to the buffers.
+double best_zone_ns(size_t count, bool zone)
+{
+    double best = zone_ns(count, zone);
+    for (int run = 1; run < 5; ++run) best = std::min(best, zone_ns(count, zone));
+    return best;
+}
+
+// Cost of one profiler timestamp read (rdtsc can trap under virtualization)
+double timestamp_ns(size_t count)
+{
+    volatile uint64_t sink = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < count; ++i) {
+        sink = sink + cpu_profiler_detail::timestamp();
+    }
+    return seconds_since(start) * 1e9 / count;
+}
+
+// Deterministic xorshift, so every run sorts the same scene.
+struct XorShift
+{
+    uint32_t state = 0x9E3779B9u;
+    uint32_t next()
+    {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state;
+    }
+    float unit() { return (next() >> 8) * (1.0f / 16777216.0f); }
+};
+
+// A scene of objects in random order, the way scene code walks them: each
+// has one of programs x materials x meshes and a random view depth.
+void fill_render_queue(RenderQueue& queue, size_t packets, int programs, int materials, int meshes)
+{
+    XorShift random;
+    queue.clear();
+    for (size_t i = 0; i < packets; ++i) {
+        DrawPacket packet;
+        uint32_t program = random.next() % programs;
+        uint32_t material = random.next() % materials;
+        uint32_t mesh = random.next() % meshes;
+        packet.program = 1 + program;
+        packet.vertexArray = 1 + mesh;
+        packet.material = material;
+        packet.indexType = GL_UNSIGNED_INT;
+        packet.count = 3 * 960;
+        packet.key = make_sort_key(0, program, material, mesh, random.unit());
+        queue.submit(packet);
+    }
+}
+
+void print_queue_order(const char* name, const RenderQueue& queue, double ms)
+{
+    RenderQueueStats stats = queue.stateChanges();
+    // Consecutive packets of the same state that go front to back
+    size_t sameState = 0, frontToBack = 0;
+    for (size_t i = 1; i < queue.size(); ++i) {
+        const DrawPacket& a = queue.packet(i - 1);
+        const DrawPacket& b = queue.packet(i);
+        if (a.program != b.program || a.material != b.material || a.vertexArray != b.vertexArray) continue;
+        sameState++;
+        if (a.key <= b.key) frontToBack++;
+    }
+    char time[16] = "-";
+    if (ms >= 0.0) snprintf(time, sizeof(time), "%.3f", ms);
+    printf("  %-20s %9s %10zu %10zu %10zu %9.1f%%\n", name, time, stats.programChanges, stats.materialChanges,
+        stats.vertexArrayChanges, sameState > 0 ? 100.0 * frontToBack / sameState : 100.0);
+}
+
+} // namespace
+
+// Vertices/sec of create_sphere() for 1, 2, 4, ... threads, plus the
+// reference scalar loop, and a bit-exactness check against that reference.
+int run_sphere_benchmark(int width, int height)
+{
+    const int repeats = 3;
+    int maxThreads = (int)std::thread::hardware_concurrency();
+    if (maxThreads < 1) maxThreads = 1;
+
+    SphereOptions serial;
+    serial.numThreads = 1;
+    SphereOptions threaded;
+    threaded.numThreads = maxThreads;
+    threaded.rowsPerTask = 1;
+
+    bool exact = matches_reference(32, 16, serial) && matches_reference(32, 16, threaded) &&
+        matches_reference(width, height, threaded);
+    printf("create_sphere bit-identical to reference (32x16 and %dx%d): %s\n", width, height, exact ? "yes" : "NO");
+
+    double vertexCount = (double)(height - 2) * width + 2;
+    printf("sphere %dx%d: %.0f vertices, %d hardware threads\n", width, height, vertexCount, maxThreads);
+
+    double best = 1e30;
+    for (int r = 0; r < repeats; ++r) {
+        std::vector<glm::vec3> v;
+        std::vector<int> idx;
+        auto start = std::chrono::steady_clock::now();
+        reference_sphere(width, height, v, idx);
+        best = std::min(best, seconds_since(start));
+    }
+    double referenceRate = vertexCount / best;
+    printf("  %-10s %10.2f ms %12.2f Mvert/s\n", "reference", best * 1e3, referenceRate * 1e-6);
+
+    for (int threads = 1; ; threads = std::min(threads * 2, maxThreads)) {
+        SphereOptions options;
+        options.numThreads = threads;
+        best = 1e30;
+        for (int r = 0; r < repeats; ++r) {
+            auto start = std::chrono::steady_clock::now();
+            Mesh mesh = create_sphere(width, height, options);
+            best = std::min(best, seconds_since(start));
+            if (mesh.empty()) return 1;
+        }
+        double rate = vertexCount / best;
+        printf("  %2d thread%s %10.2f ms %12.2f Mvert/s  (x%.2f vs reference)\n",
+            threads, threads == 1 ? " " : "s", best * 1e3, rate * 1e-6, rate / referenceRate);
+        if (threads == maxThreads) break;
+    }
+
+    return exact ? 0 : 1;
+}
+
+// Triangle count and measured deviation of the UV, icosphere and cube-sphere
+// layouts for the same error target. maxError <= 0 runs a default set that
+// includes half a pixel for the sphere drawn by the viewer. Fails when a
+// layout needs more triangles than the UV sphere.
+int run_sphere_error_report(float maxError)
+{
+    if (maxError > 0.0f) {
+        return report_sphere_error("relative to radius", maxError) ? 0 : 1;
+    }
+
+    bool fewer = true;
+    const float targets[] = { 1e-2f, 1e-3f, 1e-4f };
+    for (float e : targets) fewer &= report_sphere_error("relative to radius", e);
+
+    // Same camera as Phong.cpp: radius 2 sphere, 7 units away, 512x512.
+    glm::mat4 projection = glm::frustum(-0.1f, 0.1f, -0.1f, 0.1f, 0.1f, 1000.0f);
+    float pixelError = sphere_error_from_pixels(0.5f, projection, 512, 7.0f, 2.0f);
+    fewer &= report_sphere_error("0.5 px in the viewer", pixelError);
+    return fewer ? 0 : 1;
+}
+
+// Size and measured error of the quantized vertex formats for the viewer's
+// 32x16 sphere and for a WxH sphere.
+int run_quantize_report(int width, int height)
+{
+    report_quantization(32, 16);
+    report_quantization(width, height);
+    return 0;
+}
+
+// ACMR/ATVR of the generated meshes before and after optimize_vertex_cache()
+// for a FIFO or LRU post-transform cache of cacheSize entries.
+int run_vertex_cache_report(int width, int height, int cacheSize, bool lru)
+{
+    CacheModel model = lru ? CacheModel::Lru : CacheModel::Fifo;
+    printf("post-transform cache: %d entries, %s\n", cacheSize, lru ? "LRU" : "FIFO");
+    printf("  %-22s %10s %8s %8s %8s %8s %10s\n", "mesh", "triangles", "ACMR", "(opt)", "ATVR", "(opt)", "opt ms");
+
+    char name[64];
+    report_vertex_cache("uv 32x16", create_sphere(32, 16), cacheSize, model);
+    if (width != 32 || height != 16) {
+        snprintf(name, sizeof(name), "uv %dx%d", width, height);
+        report_vertex_cache(name, create_sphere(width, height), cacheSize, model);
+    }
+    report_vertex_cache("icosphere freq 32", create_icosphere(0.0f, 32), cacheSize, model);
+    report_vertex_cache("cube sphere 6x64x64", create_cube_sphere(0.0f, 64), cacheSize, model);
+    return 0;
+}
+
+// Overdraw (CPU rasterizer, no back-face culling like the viewer), ACMR and
+// vertex fetch overfetch through original -> vertex cache -> overdraw ->
+// vertex fetch passes.
+int run_overdraw_report(int width, int height)
+{
+    printf("overdraw: 16 views at 256x256, ACMR: 16-entry FIFO, overfetch: 32 x 64-byte lines\n");
+    printf("  %-20s %9s | %-20s | %-20s | %-13s\n", "", "", "overdraw", "ACMR", "overfetch");
+    printf("  %-20s %9s | %6s %6s %6s | %6s %6s %6s | %6s %6s\n", "mesh", "triangles",
+        "orig", "vcache", "odraw", "orig", "vcache", "odraw", "before", "after");
+
+    char name[64];
+    bool bounded = report_overdraw("uv 32x16", create_sphere(32, 16), false);
+    if (width != 32 || height != 16) {
+        snprintf(name, sizeof(name), "uv %dx%d", width, height);
+        bounded &= report_overdraw(name, create_sphere(width, height), false);
+    }
+    bounded &= report_overdraw("icosphere freq 32", create_icosphere(0.0f, 32), false);
+    bounded &= report_overdraw("cube sphere 6x64x64", create_cube_sphere(0.0f, 64), false);
+    bounded &= report_overdraw("bumpy sphere", bumpy_sphere(), false);
+    bounded &= report_overdraw("bumpy sphere (cull)", bumpy_sphere(), true);
+    printf("  odraw ACMR within 1.05x of vcache: %s\n", bounded ? "yes" : "NO");
+    return bounded ? 0 : 1;
+}
+
+// Meshlet sizes and CPU culling results for the viewer's sphere and a
+// WxH sphere, seen from the viewer camera and from close up.
+int run_meshlet_report(int width, int height)
+{
+    char name[64];
+    report_meshlets("uv 32x16", create_sphere(32, 16));
+    snprintf(name, sizeof(name), "uv %dx%d", width, height);
+    report_meshlets(name, create_sphere(width, height));
+    return 0;
+}
+
+// Quadric simplification LOD chains (50/25/12/6%) with the measured error of
+// each level and the view depth beyond which the viewer would select it.
+int run_lod_report(int width, int height)
+{
+    char name[64];
+    report_lod_chain("uv 32x16", create_sphere(32, 16));
+    snprintf(name, sizeof(name), "uv %dx%d", width, height);
+    report_lod_chain(name, create_sphere(width, height));
+    report_lod_chain("bumpy sphere", bumpy_sphere());
+    return 0;
+}
+
+int run_render_queue_report(size_t packets)
+{
+    const int programs = 8, materials = 64, meshes = 16, repeats = 10;
+    RenderQueue queue;
+    queue.reserve(packets);
+
+    double submitMs = 1e30, radixMs = 1e30, stdMs = 1e30;
+    for (int r = 0; r < repeats; ++r) {
+        auto start = std::chrono::steady_clock::now();
+        fill_render_queue(queue, packets, programs, materials, meshes);
+        submitMs = std::min(submitMs, seconds_since(start) * 1e3);
+
+        start = std::chrono::steady_clock::now();
+        queue.sort();
+        radixMs = std::min(radixMs, seconds_since(start) * 1e3);
+    }
+
+    // std::stable_sort of the same (key, index) pairs as the reference
+    std::vector<std::pair<uint64_t, size_t>> keys(packets);
+    std::vector<std::pair<uint64_t, size_t>> sorted;
+    for (int r = 0; r < repeats; ++r) {
+        fill_render_queue(queue, packets, programs, materials, meshes);
+        for (size_t i = 0; i < packets; ++i) keys[i] = std::make_pair(queue.packet(i).key, i);
+        sorted = keys;
+        auto start = std::chrono::steady_clock::now();
+        std::stable_sort(sorted.begin(), sorted.end(),
+            [](const std::pair<uint64_t, size_t>& a, const std::pair<uint64_t, size_t>& b) { return a.first < b.first; });
+        stdMs = std::min(stdMs, seconds_since(start) * 1e3);
+    }
+
+    printf("Render queue, %zu packets of %d programs x %d materials x %d meshes, best of %d\n", packets, programs,
+        materials, meshes, repeats);
+    printf("  submit %.3f ms (%.1f ns/packet)\n", submitMs, submitMs * 1e6 / packets);
+    printf("  %-20s %9s %10s %10s %10s %10s\n", "order", "sort ms", "programs", "materials", "meshes",
+        "front2back");
+    print_queue_order("submission", queue, -1.0);
+    queue.sort();
+    print_queue_order("radix sort", queue, radixMs);
+
+    bool same = true;
+    for (size_t i = 0; i < packets && same; ++i) same = queue.packet(i).key == sorted[i].first;
+    printf("  std::stable_sort of the keys %.3f ms; radix order identical: %s (%.1fx faster)\n", stdMs,
+        same ? "yes" : "NO", stdMs / radixMs);
+
+    // The farthest depth must stay inside its field and not bump the mesh.
+    const uint64_t meshMask = ((1ull << kSortKeyMeshBits) - 1) << kSortKeyDepthBits;
+    bool farDepth = (make_sort_key(0, 0, 0, 4, 1.0f) & meshMask) == (make_sort_key(0, 0, 0, 4, 0.0f) & meshMask) &&
+        make_sort_key(0, 0, 0, 4, 1.0f) < make_sort_key(0, 0, 0, 5, 0.0f);
+    printf("  mesh field kept at depth 1.0: %s\n", farDepth ? "yes" : "NO");
+    return same && farDepth ? 0 : 1;
+}
+
+int run_profiler_overhead_report()
+{
+    const size_t zones = 1000000;
+    const int threads = resolve_thread_count(0);
+
+    double loop = best_zone_ns(zones, false);
+    double disabled = best_zone_ns(zones, true) - loop;
+    cpu_profiler_enable(true);
+    double growing = zone_ns(zones, true) - loop;
+    cpu_profiler_reserve(zones);
+    double reserved = zone_ns(zones, true) - loop;
+
+    // All threads at once: no shared state on the recording path
+    std::vector<double> perThread(threads);
+    parallel_for(0, (size_t)threads, 1, threads, [&](size_t begin, size_t end) {
+        for (size_t t = begin; t < end; ++t) {
+            cpu_profiler_reserve(zones);
+            perThread[t] = zone_ns(zones, true) - zone_ns(zones, false);
+        }
+    });
+    cpu_profiler_enable(false);
+    double worst = *std::max_element(perThread.begin(), perThread.end());
+
+    printf("CPU profiler zone overhead, %zu zones per run (%s timestamps)\n", zones,
+#ifdef CPU_PROFILER_RDTSC
+        "rdtsc"
+#else
+        "steady_clock"
+#endif
+    );
+    // A difference under 0.1 ns is noise of the loop timing, not a cost.
+    auto printCost = [](const char* name, double ns) {
+        if (ns < 0.1) {
+            printf("  %-28s %8s ns/zone (below timer resolution)\n", name, "< 0.1");
+        }
+        else {
+            printf("  %-28s %8.1f ns/zone\n", name, ns);
+        }
+    };
+    printCost("disabled", disabled);
+    printCost("enabled, growing buffer", growing);
+    printCost("enabled, reserved buffer", reserved);
+    char name[48];
+    snprintf(name, sizeof(name), "reserved, %d thread%s (worst)", threads, threads > 1 ? "s" : "");
+    printCost(name, worst);
+    printf("  %zu zones recorded; timestamp read alone: %.1f ns\n", cpu_profiler_event_count(), timestamp_ns(zones));
+    return 0;
+}
@@ -0,0 +1,22 @@
+#pragma once
+#ifndef BENCHMARKS_H
+#define BENCHMARKS_H
+
+#include <stddef.h>
+
+// CPU-side benchmarks and reports. They run without a window or GL context
+// and print their results to stdout. Each returns 0 on success.
+
+int run_sphere_benchmark(int width, int height);
+int run_sphere_error_report(float maxError);
+int run_quantize_report(int width, int height);
+int run_vertex_cache_report(int width, int height, int cacheSize, bool lru);
+int run_overdraw_report(int width, int height);
+int run_meshlet_report(int width, int height);
+int run_lod_report(int width, int height);
+// Sort time and state changes of a render queue of random draw packets
+int run_render_queue_report(size_t packets);
+// Cost of a PROFILE_ZONE when the CPU profiler is disabled and enabled
+int run_profiler_overhead_report();
+
+#endif // BENCHMARKS_H
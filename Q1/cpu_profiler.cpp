@@ -0,0 +1,218 @@
+//
+//  cpu_profiler.cpp
+//  Per-thread zone buffers and the Chrome trace export
+//
+
+#include <stdio.h>
+#include <string.h>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <chrono>
+#include "cpu_profiler.h"
+
+namespace cpu_profiler_detail {
+
+std::atomic<bool> enabled(false);
+
+} // namespace cpu_profiler_detail
+
+namespace {
+
+struct ZoneEvent
+{
+    const char* name;
+    uint64_t begin;
+    uint64_t end;
+};
+
+// Written by its thread only. count is published with release stores so the
+// exporter can read the events below it while the thread keeps going.
+// Reserved chunks are linked ahead of the current one with count 0.
+struct Chunk
+{
+    static const size_t kEvents = 4096;
+    ZoneEvent events[kEvents];
+    std::atomic<size_t> count{ 0 };
+    std::atomic<Chunk*> next{ nullptr };
+};
+
+struct ThreadBuffer
+{
+    Chunk first;
+    Chunk* current = &first;
+    int id = 0;
+    std::string name;
+
+    ~ThreadBuffer()
+    {
+        Chunk* chunk = first.next.load();
+        while (chunk != nullptr) {
+            Chunk* next = chunk->next.load();
+            delete chunk;
+            chunk = next;
+        }
+    }
+};
+
+// Buffers outlive their threads, so zones of finished workers still export.
+std::mutex registryMutex;
+std::vector<std::unique_ptr<ThreadBuffer>> registry;
+thread_local ThreadBuffer* threadBuffer = nullptr;
+
+// Clock calibration, set by cpu_profiler_enable(true)
+uint64_t startTicks = 0;
+std::chrono::steady_clock::time_point startTime;
+
+ThreadBuffer* register_thread()
+{
+    std::unique_ptr<ThreadBuffer> buffer(new ThreadBuffer());
+    memset(buffer->first.events, 0, sizeof(buffer->first.events));
+    std::lock_guard<std::mutex> lock(registryMutex);
+    buffer->id = (int)registry.size() + 1;
+    buffer->name = "thread " + std::to_string(buffer->id);
+    registry.push_back(std::move(buffer));
+    return registry.back().get();
+}
+
+ThreadBuffer& this_thread_buffer()
+{
+    if (threadBuffer == nullptr) threadBuffer = register_thread();
+    return *threadBuffer;
+}
+
+void write_json_string(std::ostream& out, const char* text)
+{
+    out << '"';
+    for (const char* c = text; *c != '\0'; ++c) {
+        if (*c == '"' || *c == '\\') out << '\\';
+        if ((unsigned char)*c >= 0x20) out << *c;
+    }
+    out << '"';
+}
+
+} // namespace
+
+namespace cpu_profiler_detail {
+
+void record(const char* name, uint64_t begin, uint64_t end)
+{
+    ThreadBuffer& buffer = this_thread_buffer();
+    Chunk* chunk = buffer.current;
+    size_t count = chunk->count.load(std::memory_order_relaxed);
+    if (count == Chunk::kEvents) {
+        Chunk* next = chunk->next.load(std::memory_order_relaxed);
+        if (next == nullptr) {
+            next = new Chunk();
+            chunk->next.store(next, std::memory_order_release);
+        }
+        buffer.current = chunk = next;
+        count = 0;
+    }
+    chunk->events[count] = { name, begin, end };
+    chunk->count.store(count + 1, std::memory_order_release);
+}
+
+} // namespace cpu_profiler_detail
+
+void cpu_profiler_enable(bool enable)
+{
+    if (enable && startTicks == 0) {
+        startTime = std::chrono::steady_clock::now();
+        startTicks = cpu_profiler_detail::timestamp();
+    }
+    cpu_profiler_detail::enabled.store(enable, std::memory_order_relaxed);
+}
+
+void cpu_profiler_reserve(size_t events)
+{
+    ThreadBuffer& buffer = this_thread_buffer();
+    size_t available = Chunk::kEvents - buffer.current->count.load(std::memory_order_relaxed);
+    Chunk* last = buffer.current;
+    for (Chunk* next = last->next.load(); next != nullptr; next = next->next.load()) {
+        available += Chunk::kEvents;
+        last = next;
+    }
+    while (available < events) {
+        Chunk* chunk = new Chunk();
+        // Touch every page now rather than on the first zone that lands there.
+        memset(chunk->events, 0, sizeof(chunk->events));
+        last->next.store(chunk, std::memory_order_release);
+        last = chunk;
+        available += Chunk::kEvents;
+    }
+}
+
+void cpu_profiler_set_thread_name(const char* name)
+{
+    ThreadBuffer& buffer = this_thread_buffer();
+    std::lock_guard<std::mutex> lock(registryMutex);
+    buffer.name = name;
+}
+
+size_t cpu_profiler_event_count()
+{
+    std::lock_guard<std::mutex> lock(registryMutex);
+    size_t total = 0;
+    for (const std::unique_ptr<ThreadBuffer>& buffer : registry) {
+        for (const Chunk* chunk = &buffer->first; chunk != nullptr; chunk = chunk->next.load(std::memory_order_acquire)) {
+            total += chunk->count.load(std::memory_order_acquire);
+        }
+    }
+    return total;
+}
+
+bool write_chrome_trace(const std::string& path)
+{
+    // Ticks per microsecond from the time since cpu_profiler_enable(); a
+    // few milliseconds of spinning keep a very short run accurate.
+    double ticksPerUs = 1000.0;
+#ifdef CPU_PROFILER_RDTSC
+    std::chrono::steady_clock::time_point now;
+    do {
+        now = std::chrono::steady_clock::now();
+    } while (now - startTime < std::chrono::milliseconds(20));
+    uint64_t nowTicks = cpu_profiler_detail::timestamp();
+    ticksPerUs = (nowTicks - startTicks) / std::chrono::duration<double, std::micro>(now - startTime).count();
+#endif
+
+    std::ofstream file(path);
+    if (!file.is_open()) {
+        fprintf(stderr, "Failed to open %s\n", path.c_str());
+        return false;
+    }
+    file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    file << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"Q1 viewer\"}}";
+
+    char text[128];
+    std::lock_guard<std::mutex> lock(registryMutex);
+    for (const std::unique_ptr<ThreadBuffer>& buffer : registry) {
+        snprintf(text, sizeof(text), ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":",
+            buffer->id);
+        file << text;
+        write_json_string(file, buffer->name.c_str());
+        file << "}}";
+        for (const Chunk* chunk = &buffer->first; chunk != nullptr; chunk = chunk->next.load(std::memory_order_acquire)) {
+            size_t count = chunk->count.load(std::memory_order_acquire);
+            for (size_t i = 0; i < count; ++i) {
+                const ZoneEvent& event = chunk->events[i];
+                double begin = (double)(int64_t)(event.begin - startTicks) / ticksPerUs;
+                double duration = (double)(event.end - event.begin) / ticksPerUs;
+                file << ",\n{\"name\":";
+                write_json_string(file, event.name);
+                snprintf(text, sizeof(text), ",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                    buffer->id, begin, duration);
+                file << text;
+            }
+        }
+    }
+    file << "\n]}\n";
+    file.close();
+    if (file.fail()) {
+        fprintf(stderr, "Failed to write %s\n", path.c_str());
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,103 @@
+#pragma once
+#ifndef CPU_PROFILER_H
+#define CPU_PROFILER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <string>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define CPU_PROFILER_RDTSC 1
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define CPU_PROFILER_RDTSC 1
+#else
+#include <chrono>
+#endif
+
+// Scoped CPU zones for the hot paths, exported as Chrome trace_event JSON
+// (chrome://tracing, ui.perfetto.dev).
+//
+//     void upload() {
+//         PROFILE_ZONE("upload");
+//         ...
+//     }
+//
+// Each thread records into its own chunked buffer with no locks: a zone is
+// two timestamp reads and one store of {name, begin, end}. Timestamps are
+// rdtsc ticks on x86 (converted with a steady_clock calibration at export)
+// and steady_clock nanoseconds elsewhere. Names must be string literals or
+// otherwise outlive the export. While the profiler is disabled a zone costs
+// one relaxed load; define CPU_PROFILER_DISABLED to compile zones out.
+
+namespace cpu_profiler_detail {
+
+extern std::atomic<bool> enabled;
+
+inline uint64_t timestamp()
+{
+#ifdef CPU_PROFILER_RDTSC
+    return __rdtsc();
+#else
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+void record(const char* name, uint64_t begin, uint64_t end);
+
+} // namespace cpu_profiler_detail
+
+// Starts recording (and the clock calibration) or pauses it.
+void cpu_profiler_enable(bool enable);
+inline bool cpu_profiler_enabled()
+{
+    return cpu_profiler_detail::enabled.load(std::memory_order_relaxed);
+}
+// Allocates and touches room for events more zones of the calling thread, so
+// recording them never allocates or page-faults.
+void cpu_profiler_reserve(size_t events);
+// Thread name shown in the trace; the default is "thread N".
+void cpu_profiler_set_thread_name(const char* name);
+// Zones recorded so far, over all threads
+size_t cpu_profiler_event_count();
+// Writes every recorded zone as Chrome trace_event JSON. Threads may keep
+// recording meanwhile; zones finished after the call are not included.
+bool write_chrome_trace(const std::string& path);
+
+class CpuZone
+{
+public:
+    explicit CpuZone(const char* name)
+        : mName(cpu_profiler_enabled() ? name : nullptr)
+    {
+        if (mName != nullptr) mBegin = cpu_profiler_detail::timestamp();
+    }
+    ~CpuZone() { end(); }
+    CpuZone(const CpuZone&) = delete;
+    CpuZone& operator=(const CpuZone&) = delete;
+
+    // Closes the zone before the end of its scope.
+    void end()
+    {
+        if (mName == nullptr) return;
+        cpu_profiler_detail::record(mName, mBegin, cpu_profiler_detail::timestamp());
+        mName = nullptr;
+    }
+
+private:
+    const char* mName;
+    uint64_t mBegin = 0;
+};
+
+#define CPU_PROFILER_CONCAT_(a, b) a##b
+#define CPU_PROFILER_CONCAT(a, b) CPU_PROFILER_CONCAT_(a, b)
+#ifdef CPU_PROFILER_DISABLED
+#define PROFILE_ZONE(name) ((void)0)
+#else
+#define PROFILE_ZONE(name) CpuZone CPU_PROFILER_CONCAT(cpuZone, __LINE__)(name)
+#endif
+
+#endif // CPU_PROFILER_H
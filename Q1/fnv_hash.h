@@ -0,0 +1,23 @@
+#pragma once
+#ifndef FNV_HASH_H
+#define FNV_HASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// 64-bit FNV-1a, for cache keys (shader variants, program binaries)
+const uint64_t kFnvOffset = 14695981039346656037ull;
+const uint64_t kFnvPrime = 1099511628211ull;
+
+// Continues hash over size bytes of data; start with kFnvOffset.
+inline uint64_t fnv1a(uint64_t hash, const void* data, size_t size)
+{
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= bytes[i];
+        hash *= kFnvPrime;
+    }
+    return hash;
+}
+
+#endif // FNV_HASH_H
@@ -0,0 +1,223 @@
+//
+//  frame_capture.cpp
+//  Pipelined PBO readback with encoder threads
+//
+
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <algorithm>
+#include "frame_capture.h"
+#include "frame_timing.h"
+#include "gl_state.h"
+#include "parallel.h"
+#include "ring_buffer.h"
+
+namespace {
+
+const int kMaxDefaultThreads = 8;
+
+} // namespace
+
+bool valid_frame_pattern(const std::string& pattern)
+{
+    int conversions = 0;
+    for (size_t i = 0; i < pattern.size(); ++i) {
+        if (pattern[i] != '%') continue;
+        if (i + 1 < pattern.size() && pattern[i + 1] == '%') {
+            ++i;
+            continue;
+        }
+        ++i;
+        while (i < pattern.size() && (pattern[i] == '0' || pattern[i] == '-' || isdigit((unsigned char)pattern[i]))) {
+            ++i;
+        }
+        if (i >= pattern.size() || pattern[i] != 'd') return false;
+        ++conversions;
+    }
+    return conversions == 1;
+}
+
+bool FrameCapture::create(int width, int height, ImageFormat format, const std::string& pathPattern, int threads)
+{
+    destroy();
+    if (!pathPattern.empty() && !valid_frame_pattern(pathPattern)) {
+        fprintf(stderr, "Capture path needs one %%d for the frame number: %s\n", pathPattern.c_str());
+        return false;
+    }
+    mWidth = width;
+    mHeight = height;
+    mFormat = format;
+    mPattern = pathPattern;
+    mImageBytes = (size_t)width * height * image_bytes_per_pixel(format);
+    mStats = CaptureStats();
+
+    GLStateCache& state = gl_state();
+    mSlots.resize(kRingSize);
+    for (Slot& slot : mSlots) {
+        glGenBuffers(1, &slot.buffer);
+        state.bindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+        glBufferData(GL_PIXEL_PACK_BUFFER, (GLsizeiptr)mImageBytes, nullptr, GL_STREAM_READ);
+    }
+    // A bound pack buffer would turn every other glReadPixels into a readback
+    // into it.
+    state.bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    mNext = 0;
+
+    if (threads <= 0) threads = defaultThreads();
+    mStopping = false;
+    mBusy = 0;
+    for (int i = 0; i < threads; ++i) {
+        mWorkers.emplace_back([this]() { work(); });
+    }
+    return true;
+}
+
+int FrameCapture::defaultThreads()
+{
+    return std::min(std::max(resolve_thread_count(0) - 1, 1), kMaxDefaultThreads);
+}
+
+void FrameCapture::destroy()
+{
+    if (mSlots.empty()) return;
+    finish();
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStopping = true;
+    }
+    mWorkReady.notify_all();
+    for (std::thread& worker : mWorkers) worker.join();
+    mWorkers.clear();
+    mFreeBuffers.clear();
+
+    for (Slot& slot : mSlots) {
+        gl_state().deleteBuffers(1, &slot.buffer);
+    }
+    mSlots.clear();
+}
+
+void FrameCapture::capture(size_t frame)
+{
+    if (mSlots.empty()) return;
+    Slot& slot = mSlots[mNext];
+    if (slot.fence != nullptr) retire(slot);
+
+    GLStateCache& state = gl_state();
+    state.bindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glReadPixels(0, 0, mWidth, mHeight, GL_RGBA, image_pixel_type(mFormat), nullptr);
+    state.bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    slot.frame = frame;
+    mNext = (mNext + 1) % kRingSize;
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    mStats.frames++;
+}
+
+void FrameCapture::finish()
+{
+    if (mSlots.empty()) return;
+    // Oldest first, so the workers see the frames in order.
+    for (int i = 0; i < kRingSize; ++i) {
+        Slot& slot = mSlots[(mNext + i) % kRingSize];
+        if (slot.fence != nullptr) retire(slot);
+    }
+    std::unique_lock<std::mutex> lock(mMutex);
+    mBufferFree.wait(lock, [this]() { return mBusy == 0; });
+}
+
+CaptureStats FrameCapture::stats() const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mStats;
+}
+
+void FrameCapture::retire(Slot& slot)
+{
+    double stallMs = wait_fence(slot.fence);
+
+    // A buffer for the copy: a recycled one, a new one while the workers
+    // have fewer than one each plus one queued, or wait for one.
+    std::vector<unsigned char> pixels;
+    {
+        std::unique_lock<std::mutex> lock(mMutex);
+        if (stallMs > 0.0) {
+            mStats.readbackStalls++;
+            mStats.readbackWaitMs += stallMs;
+        }
+        if (mFreeBuffers.empty() && mBusy >= mWorkers.size() + 1) {
+            double waitStart = steady_seconds();
+            mBufferFree.wait(lock, [this]() { return !mFreeBuffers.empty(); });
+            mStats.encoderWaits++;
+            mStats.encoderWaitMs += (steady_seconds() - waitStart) * 1e3;
+        }
+        if (!mFreeBuffers.empty()) {
+            pixels = std::move(mFreeBuffers.back());
+            mFreeBuffers.pop_back();
+        }
+    }
+    pixels.resize(mImageBytes);
+
+    double copyStart = steady_seconds();
+    GLStateCache& state = gl_state();
+    state.bindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+    const void* mapped = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, (GLsizeiptr)mImageBytes, GL_MAP_READ_BIT);
+    bool ok = mapped != nullptr;
+    if (ok) {
+        memcpy(pixels.data(), mapped, mImageBytes);
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    state.bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    double copyMs = (steady_seconds() - copyStart) * 1e3;
+
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStats.copyMs += copyMs;
+        if (!ok) {
+            mStats.failures++;
+            mFreeBuffers.push_back(std::move(pixels));
+            return;
+        }
+        mJobs.push_back({ slot.frame, std::move(pixels) });
+        mBusy++;
+    }
+    mWorkReady.notify_one();
+}
+
+void FrameCapture::work()
+{
+    std::vector<unsigned char> encoded;
+    for (;;) {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mWorkReady.wait(lock, [this]() { return mStopping || !mJobs.empty(); });
+            if (mJobs.empty()) return;
+            job = std::move(mJobs.front());
+            mJobs.pop_front();
+        }
+
+        double start = steady_seconds();
+        encode_image(mFormat, job.pixels.data(), mWidth, mHeight, encoded);
+        bool ok = true;
+        if (!mPattern.empty()) {
+            char path[1024];
+            snprintf(path, sizeof(path), mPattern.c_str(), (int)job.frame);
+            ok = write_file(path, encoded);
+        }
+        double encodeMs = (steady_seconds() - start) * 1e3;
+
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mStats.encoded++;
+            if (!ok) mStats.failures++;
+            mStats.encodeMs += encodeMs;
+            mStats.bytes += encoded.size();
+            mFreeBuffers.push_back(std::move(job.pixels));
+            mBusy--;
+        }
+        mBufferFree.notify_all();
+    }
+}
@@ -0,0 +1,112 @@
+#pragma once
+#ifndef FRAME_CAPTURE_H
+#define FRAME_CAPTURE_H
+
+#include <stddef.h>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "gl_extensions.h"
+#include "image_encode.h"
+
+struct CaptureStats
+{
+    size_t frames = 0;         // readbacks issued
+    size_t encoded = 0;        // images finished by the workers
+    size_t failures = 0;       // images that could not be written
+    size_t readbackStalls = 0; // readbacks mapped before their fence signaled
+    double readbackWaitMs = 0.0;
+    size_t encoderWaits = 0;   // captures that waited for a worker to free a buffer
+    double encoderWaitMs = 0.0;
+    double copyMs = 0.0;       // mapped readback to the worker's buffer, GL thread
+    double encodeMs = 0.0;     // summed over the workers
+    size_t bytes = 0;          // encoded output
+};
+
+// Frame capture that keeps glReadPixels off the critical path. Each
+// capture() reads the current read framebuffer into the next pixel buffer
+// object of a ring and fences it; the transfer runs on the GPU while later
+// frames are drawn. A buffer is mapped only when the ring comes back to it,
+// kRingSize frames later, by which time the fence has normally signaled.
+// The pixels are copied out and handed to a pool of encoder threads, so
+// the GL thread never waits on PNG / EXR encoding or on the disk.
+//
+// Pixel buffers for the workers are recycled; when the encoders fall behind
+// by more than one buffer per worker plus one, capture() waits for them
+// (counted in encoderWaits) rather than dropping frames or growing memory.
+class FrameCapture
+{
+public:
+    static const int kRingSize = 3;
+
+    FrameCapture() = default;
+    ~FrameCapture() { destroy(); }
+    FrameCapture(const FrameCapture&) = delete;
+    FrameCapture& operator=(const FrameCapture&) = delete;
+
+    // Needs a current context. pathPattern holds one printf conversion for
+    // the frame number, e.g. "frame_%05d.png"; an empty pattern encodes and
+    // discards (for measuring). threads 0 = defaultThreads().
+    bool create(int width, int height, ImageFormat format, const std::string& pathPattern, int threads = 0);
+    // finish(), then stops the workers and frees the buffers.
+    void destroy();
+    bool created() const { return !mSlots.empty(); }
+
+    int width() const { return mWidth; }
+    int height() const { return mHeight; }
+    ImageFormat format() const { return mFormat; }
+    int threads() const { return (int)mWorkers.size(); }
+    // One encoder per core but one (the GL thread's), at most 8
+    static int defaultThreads();
+
+    // Queues the readback of the current read framebuffer as image frame.
+    void capture(size_t frame);
+    // Maps every pending readback and waits until the workers are idle.
+    void finish();
+
+    CaptureStats stats() const;
+
+private:
+    struct Slot
+    {
+        GLuint buffer = 0;
+        GLsync fence = nullptr;
+        size_t frame = 0;
+    };
+    struct Job
+    {
+        size_t frame;
+        std::vector<unsigned char> pixels;
+    };
+
+    // Maps the slot's readback and queues it for the workers.
+    void retire(Slot& slot);
+    void work();
+
+    int mWidth = 0;
+    int mHeight = 0;
+    ImageFormat mFormat = ImageFormat::Png;
+    std::string mPattern;
+    size_t mImageBytes = 0;
+    std::vector<Slot> mSlots;
+    int mNext = 0;
+
+    std::vector<std::thread> mWorkers;
+    mutable std::mutex mMutex;
+    std::condition_variable mWorkReady;  // job queued or stopping
+    std::condition_variable mBufferFree; // a job finished
+    std::deque<Job> mJobs;
+    std::vector<std::vector<unsigned char>> mFreeBuffers;
+    size_t mBusy = 0; // jobs queued or being encoded
+    bool mStopping = false;
+    CaptureStats mStats;
+};
+
+// Checks that pattern holds exactly one integer conversion (%d, %05d, ...)
+// and no other '%' except "%%".
+bool valid_frame_pattern(const std::string& pattern);
+
+#endif // FRAME_CAPTURE_H
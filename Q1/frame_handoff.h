@@ -0,0 +1,67 @@
+#pragma once
+#ifndef FRAME_HANDOFF_H
+#define FRAME_HANDOFF_H
+
+#include <stddef.h>
+#include <atomic>
+
+// Hands the latest value from one producer thread to one consumer thread
+// without locks or waiting: the simulation publishes a frame packet per
+// step, the render thread picks up the newest one per frame.
+//
+// The two sides double buffer through a third slot in the middle. The
+// producer fills back() and publish() swaps it with the middle slot; the
+// consumer's acquire() swaps its front slot with the middle one if that
+// holds something new. Each swap is one atomic exchange of a slot index
+// (plus a "fresh" bit), so neither side ever blocks the other. A value
+// published twice before the consumer looks is replaced, not queued.
+template <typename T>
+class FrameHandoff
+{
+public:
+    FrameHandoff() = default;
+    FrameHandoff(const FrameHandoff&) = delete;
+    FrameHandoff& operator=(const FrameHandoff&) = delete;
+
+    // Producer: the slot to fill before publish()
+    T& back() { return mSlots[mBack]; }
+    void publish()
+    {
+        unsigned int previous = mMiddle.exchange(mBack | kFresh, std::memory_order_acq_rel);
+        if (previous & kFresh) mReplaced.fetch_add(1, std::memory_order_relaxed);
+        mBack = previous & kIndexMask;
+        mPublished.fetch_add(1, std::memory_order_relaxed);
+    }
+    void publish(const T& value)
+    {
+        back() = value;
+        publish();
+    }
+
+    // Consumer: true if something was published since the last call, which
+    // front() then holds. front() keeps the previous value otherwise.
+    bool acquire()
+    {
+        if ((mMiddle.load(std::memory_order_relaxed) & kFresh) == 0) return false;
+        mFront = mMiddle.exchange(mFront, std::memory_order_acq_rel) & kIndexMask;
+        return true;
+    }
+    const T& front() const { return mSlots[mFront]; }
+
+    // Values published, and those replaced before the consumer saw them
+    size_t published() const { return mPublished.load(std::memory_order_relaxed); }
+    size_t replaced() const { return mReplaced.load(std::memory_order_relaxed); }
+
+private:
+    static const unsigned int kIndexMask = 3;
+    static const unsigned int kFresh = 4;
+
+    T mSlots[3];
+    unsigned int mBack = 0;  // producer only
+    unsigned int mFront = 1; // consumer only
+    std::atomic<unsigned int> mMiddle{ 2 };
+    std::atomic<size_t> mPublished{ 0 };
+    std::atomic<size_t> mReplaced{ 0 };
+};
+
+#endif // FRAME_HANDOFF_H
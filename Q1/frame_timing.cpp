@@ -0,0 +1,270 @@
+//
+//  frame_timing.cpp
+//  Vsync modes, a frame limiter and frame-time percentiles
+//
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <thread>
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include "frame_timing.h"
+
+namespace {
+
+struct VsyncName
+{
+    const char* name;
+    VsyncMode mode;
+};
+
+const VsyncName kVsyncNames[] = {
+    { "off", VsyncMode::Off },
+    { "on", VsyncMode::On },
+    { "adaptive", VsyncMode::Adaptive },
+};
+
+// Below this much remaining time the limiter spins instead of sleeping.
+const double kSpinSeconds = 0.002;
+
+// Nearest-rank percentile of sorted samples
+double percentile(const std::vector<float>& sorted, double p)
+{
+    if (sorted.empty()) return 0.0;
+    size_t rank = (size_t)(p / 100.0 * sorted.size() + 0.5);
+    rank = std::min(std::max(rank, (size_t)1), sorted.size());
+    return sorted[rank - 1];
+}
+
+void json_summary(std::ostream& out, const char* name, const FrameTimeSummary& s, bool last)
+{
+    char line[256];
+    snprintf(line, sizeof(line), "    \"%s\": { \"count\": %zu, \"mean\": %.4f, \"stddev\": %.4f, \"p50\": %.4f, "
+        "\"p95\": %.4f, \"p99\": %.4f, \"max\": %.4f }%s\n", name, s.count, s.mean, s.stddev, s.p50, s.p95, s.p99,
+        s.max, last ? "" : ",");
+    out << line;
+}
+
+} // namespace
+
+bool parse_vsync_mode(const char* name, VsyncMode& mode)
+{
+    for (const VsyncName& entry : kVsyncNames) {
+        if (strcmp(name, entry.name) == 0) {
+            mode = entry.mode;
+            return true;
+        }
+    }
+    return false;
+}
+
+const char* vsync_mode_name(VsyncMode mode)
+{
+    for (const VsyncName& entry : kVsyncNames) {
+        if (entry.mode == mode) return entry.name;
+    }
+    return "?";
+}
+
+VsyncMode apply_vsync(VsyncMode mode)
+{
+    if (mode == VsyncMode::Adaptive && !glfwExtensionSupported("WGL_EXT_swap_control_tear") &&
+        !glfwExtensionSupported("GLX_EXT_swap_control_tear")) {
+        fprintf(stderr, "Adaptive vsync needs EXT_swap_control_tear; using vsync on\n");
+        mode = VsyncMode::On;
+    }
+    glfwSwapInterval(mode == VsyncMode::Off ? 0 : mode == VsyncMode::On ? 1 : -1);
+    return mode;
+}
+
+double steady_seconds()
+{
+    static const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void FrameLimiter::setRate(double fps)
+{
+    mPeriod = fps > 0.0 ? 1.0 / fps : 0.0;
+    mDeadline = 0.0;
+}
+
+double FrameLimiter::wait()
+{
+    if (mPeriod <= 0.0) return 0.0;
+    const double start = steady_seconds();
+    if (mDeadline == 0.0 || start - mDeadline > mPeriod) {
+        // First frame, or more than a frame late: start over from now.
+        mDeadline = start + mPeriod;
+        return 0.0;
+    }
+    double now = start;
+    while (mDeadline - now > kSpinSeconds) {
+        std::this_thread::sleep_for(std::chrono::duration<double>(mDeadline - now - kSpinSeconds));
+        now = steady_seconds();
+    }
+    while (now < mDeadline) {
+        now = steady_seconds();
+    }
+    mDeadline += mPeriod;
+    return now - start;
+}
+
+FrameTimeSeries::FrameTimeSeries(size_t capacity)
+    : mCapacity(std::max(capacity, (size_t)1))
+{
+    mSamples.reserve(mCapacity);
+}
+
+void FrameTimeSeries::add(double ms)
+{
+    if (mSamples.size() < mCapacity) {
+        mSamples.push_back((float)ms);
+        return;
+    }
+    mSamples[mNext] = (float)ms;
+    mNext = (mNext + 1) % mCapacity;
+}
+
+void FrameTimeSeries::clear()
+{
+    mSamples.clear();
+    mNext = 0;
+}
+
+FrameTimeSummary FrameTimeSeries::summary() const
+{
+    FrameTimeSummary s;
+    if (mSamples.empty()) return s;
+    std::vector<float> sorted(mSamples);
+    std::sort(sorted.begin(), sorted.end());
+    double sum = 0.0;
+    for (float ms : sorted) sum += ms;
+    s.count = sorted.size();
+    s.mean = sum / sorted.size();
+    double squares = 0.0;
+    for (float ms : sorted) squares += (ms - s.mean) * (ms - s.mean);
+    s.stddev = sqrt(squares / sorted.size());
+    s.p50 = percentile(sorted, 50.0);
+    s.p95 = percentile(sorted, 95.0);
+    s.p99 = percentile(sorted, 99.0);
+    s.max = sorted.back();
+    return s;
+}
+
+FrameTimer::FrameTimer(size_t window)
+    : mInterval(window), mCpu(window), mGpu(window)
+{
+}
+
+FrameTimer::~FrameTimer()
+{
+    destroy();
+}
+
+void FrameTimer::create()
+{
+    destroy();
+    glGenQueries(kQueryFrames * 2, &mQueries[0][0]);
+}
+
+void FrameTimer::destroy()
+{
+    if (mQueries[0][0] != 0) {
+        glDeleteQueries(kQueryFrames * 2, &mQueries[0][0]);
+    }
+    memset(mQueries, 0, sizeof(mQueries));
+    memset(mPending, 0, sizeof(mPending));
+    mSlot = 0;
+    mFrameStart = -1.0;
+}
+
+void FrameTimer::beginFrame()
+{
+    double now = steady_seconds();
+    if (mFrameStart >= 0.0) {
+        mInterval.add((now - mFrameStart) * 1e3);
+    }
+    mFrameStart = now;
+    mFrames++;
+
+    if (mQueries[0][0] == 0) return;
+    collectGpu(false);
+    // The slot about to be reused is read even if that has to wait.
+    if (mPending[mSlot]) collectGpu(true);
+    glQueryCounter(mQueries[mSlot][0], GL_TIMESTAMP);
+}
+
+void FrameTimer::endFrame()
+{
+    mCpu.add((steady_seconds() - mFrameStart) * 1e3);
+    if (mQueries[0][0] == 0) return;
+    glQueryCounter(mQueries[mSlot][1], GL_TIMESTAMP);
+    mPending[mSlot] = true;
+    mSlot = (mSlot + 1) % kQueryFrames;
+}
+
+// Reads finished frames oldest first; with wait, blocks on the oldest one.
+void FrameTimer::collectGpu(bool wait)
+{
+    for (int i = 0; i < kQueryFrames; ++i) {
+        int slot = (mSlot + i) % kQueryFrames;
+        if (!mPending[slot]) continue;
+        GLint available = 0;
+        glGetQueryObjectiv(mQueries[slot][1], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available && !wait) return;
+        GLuint64 begin = 0, end = 0;
+        glGetQueryObjectui64v(mQueries[slot][0], GL_QUERY_RESULT, &begin);
+        glGetQueryObjectui64v(mQueries[slot][1], GL_QUERY_RESULT, &end);
+        mGpu.add((end - begin) * 1e-6);
+        mPending[slot] = false;
+        wait = false;
+    }
+}
+
+void print_frame_time_header()
+{
+    printf("  %-9s %8s %9s %9s %9s %9s %9s %9s\n", "series", "frames", "mean", "stddev", "p50", "p95", "p99", "max");
+}
+
+void print_frame_time_summary(const char* name, const FrameTimeSummary& s)
+{
+    printf("  %-9s %8zu %9.3f %9.3f %9.3f %9.3f %9.3f %9.3f\n", name, s.count, s.mean, s.stddev, s.p50, s.p95, s.p99,
+        s.max);
+}
+
+void FrameTimer::print() const
+{
+    printf("Frame times over the last %zu frames (ms):\n", mInterval.size());
+    print_frame_time_header();
+    print_frame_time_summary("interval", mInterval.summary());
+    print_frame_time_summary("cpu", mCpu.summary());
+    print_frame_time_summary("gpu", mGpu.summary());
+}
+
+bool FrameTimer::writeJson(const std::string& path, VsyncMode vsync, double fpsLimit) const
+{
+    std::ofstream file(path);
+    if (!file.is_open()) {
+        fprintf(stderr, "Failed to open %s\n", path.c_str());
+        return false;
+    }
+    char header[256];
+    snprintf(header, sizeof(header), "{\n  \"vsync\": \"%s\",\n  \"fps_limit\": %.3f,\n  \"frames\": %zu,\n"
+        "  \"frame_time_ms\": {\n", vsync_mode_name(vsync), fpsLimit, mFrames);
+    file << header;
+    json_summary(file, "interval", mInterval.summary(), false);
+    json_summary(file, "cpu", mCpu.summary(), false);
+    json_summary(file, "gpu", mGpu.summary(), true);
+    file << "  }\n}\n";
+    file.close();
+    if (file.fail()) {
+        fprintf(stderr, "Failed to write %s\n", path.c_str());
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,133 @@
+#pragma once
+#ifndef FRAME_TIMING_H
+#define FRAME_TIMING_H
+
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+// Swap interval of the viewer window
+enum class VsyncMode
+{
+    Off,      // glfwSwapInterval(0), unthrottled
+    On,       // glfwSwapInterval(1)
+    Adaptive, // glfwSwapInterval(-1): tear instead of waiting when late
+};
+
+// Parses "off", "on" or "adaptive". Returns false on anything else.
+bool parse_vsync_mode(const char* name, VsyncMode& mode);
+const char* vsync_mode_name(VsyncMode mode);
+// Sets the swap interval of the current context. Adaptive needs
+// EXT_swap_control_tear and falls back to On without it; returns the mode
+// actually applied.
+VsyncMode apply_vsync(VsyncMode mode);
+
+// Seconds on a monotonic clock since the first call; the viewer's clock.
+// Unlike glfwGetTime() it works without glfwInit(), which --headless skips.
+double steady_seconds();
+
+// Keeps frames at least 1 / fps apart. Sleeps for most of the remaining
+// time and spins the last stretch, since sleep granularity is about 1 ms on
+// Windows (15.6 ms without timeBeginPeriod). Deadlines advance by a fixed
+// period so small oversleeps do not accumulate; after a long hitch the
+// limiter resynchronizes instead of rushing frames to catch up.
+class FrameLimiter
+{
+public:
+    explicit FrameLimiter(double fps = 0.0) { setRate(fps); }
+
+    // 0 disables the limiter.
+    void setRate(double fps);
+    double rate() const { return mPeriod > 0.0 ? 1.0 / mPeriod : 0.0; }
+
+    // Blocks until the next frame may start; call once per frame after the
+    // swap. Returns the seconds spent waiting.
+    double wait();
+
+private:
+    double mPeriod = 0.0;
+    double mDeadline = 0.0;
+};
+
+// p50 / p95 / p99 / max of a window of frame times, in milliseconds
+struct FrameTimeSummary
+{
+    size_t count = 0;
+    double mean = 0.0;
+    double stddev = 0.0;
+    double p50 = 0.0;
+    double p95 = 0.0;
+    double p99 = 0.0;
+    double max = 0.0;
+};
+
+// The last capacity samples of one timing series
+class FrameTimeSeries
+{
+public:
+    explicit FrameTimeSeries(size_t capacity = 1000);
+
+    void add(double ms);
+    void clear();
+    size_t size() const { return mSamples.size(); }
+    FrameTimeSummary summary() const;
+
+private:
+    std::vector<float> mSamples;
+    size_t mCapacity;
+    size_t mNext = 0; // oldest sample once the window is full
+};
+
+// Table rows as printed by FrameTimer::print(): the header, then one line
+// per series
+void print_frame_time_header();
+void print_frame_time_summary(const char* name, const FrameTimeSummary& summary);
+
+// Per-frame timing of the viewer loop, three series over a rolling window:
+//  - interval: start of one frame to the start of the next (what the user
+//    sees, including swap, vsync and limiter waits)
+//  - cpu: start of the frame to endFrame() (the CPU work, before the swap)
+//  - gpu: GL_TIMESTAMP at beginFrame() to the one at endFrame()
+// The timestamp queries rotate through a small ring and are read once
+// available, so the GPU series lags a few frames but never stalls.
+class FrameTimer
+{
+public:
+    explicit FrameTimer(size_t window = 1000);
+    ~FrameTimer();
+    FrameTimer(const FrameTimer&) = delete;
+    FrameTimer& operator=(const FrameTimer&) = delete;
+
+    // Needs a current GL context (GL 3.3 timer queries).
+    void create();
+    void destroy();
+
+    void beginFrame();
+    void endFrame();
+
+    const FrameTimeSeries& interval() const { return mInterval; }
+    const FrameTimeSeries& cpu() const { return mCpu; }
+    const FrameTimeSeries& gpu() const { return mGpu; }
+    size_t frames() const { return mFrames; }
+
+    // Human-readable table of the three series
+    void print() const;
+    // Writes the summaries and settings as JSON; returns false on I/O errors.
+    bool writeJson(const std::string& path, VsyncMode vsync, double fpsLimit) const;
+
+private:
+    static const int kQueryFrames = 4;
+
+    void collectGpu(bool wait);
+
+    FrameTimeSeries mInterval;
+    FrameTimeSeries mCpu;
+    FrameTimeSeries mGpu;
+    unsigned int mQueries[kQueryFrames][2] = {}; // [slot][begin, end]
+    bool mPending[kQueryFrames] = {};
+    int mSlot = 0;
+    double mFrameStart = -1.0;
+    size_t mFrames = 0;
+};
+
+#endif // FRAME_TIMING_H
@@ -0,0 +1,1025 @@
+//
+//  gl_benchmarks.cpp
+//  Offscreen GPU benchmarks of the viewer's shaders
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include "gl_benchmarks.h"
+#include "sphere_scene.h"
+#include "shader_variants.h"
+#include "uniforms.h"
+#include "gl_extensions.h"
+#include "multi_draw.h"
+#include "ring_buffer.h"
+#include "gl_state.h"
+#include "headless_context.h"
+#include "frame_capture.h"
+#include "frame_timing.h"
+#include "program_cache.h"
+#include "shader_compiler.h"
+
+namespace {
+
+std::string load_text_file(const char* path)
+{
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        fprintf(stderr, "Failed to open %s\n", path);
+        return std::string();
+    }
+    std::stringstream text;
+    text << file.rdbuf();
+    return text.str();
+}
+
+unsigned int compile_stage(unsigned int type, const std::string& source)
+{
+    unsigned int shader = glCreateShader(type);
+    const char* text = source.c_str();
+    glShaderSource(shader, 1, &text, nullptr);
+    glCompileShader(shader);
+    int ok = 0;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &ok);
+    if (!ok) {
+        char log[1024];
+        glGetShaderInfoLog(shader, sizeof(log), nullptr, log);
+        fprintf(stderr, "Failed to compile shader:\n%s\n", log);
+        glDeleteShader(shader);
+        return 0;
+    }
+    return shader;
+}
+
+// Vertex + fragment program, 0 on failure
+unsigned int build_program(const std::string& vertexSource, const std::string& fragmentSource)
+{
+    unsigned int vs = compile_stage(GL_VERTEX_SHADER, vertexSource);
+    unsigned int fs = compile_stage(GL_FRAGMENT_SHADER, fragmentSource);
+    if (vs == 0 || fs == 0) {
+        glDeleteShader(vs);
+        glDeleteShader(fs);
+        return 0;
+    }
+    unsigned int program = glCreateProgram();
+    glAttachShader(program, vs);
+    glAttachShader(program, fs);
+    program_cache().prepare(program);
+    glLinkProgram(program);
+    glDeleteShader(vs);
+    glDeleteShader(fs);
+    int ok = 0;
+    glGetProgramiv(program, GL_LINK_STATUS, &ok);
+    if (!ok) {
+        char log[1024];
+        glGetProgramInfoLog(program, sizeof(log), nullptr, log);
+        fprintf(stderr, "Failed to link program:\n%s\n", log);
+        glDeleteProgram(program);
+        return 0;
+    }
+    return program;
+}
+
+// Material and light of the viewer (Phong.cpp)
+PhongConstants viewer_constants()
+{
+    PhongConstants c;
+    c.matKa = glm::vec3(0.0f, 1.0f, 0.0f);
+    c.matKd = glm::vec3(0.0f, 0.5f, 0.0f);
+    c.matKs = glm::vec3(0.5f, 0.5f, 0.5f);
+    c.matShininess = 32.0f;
+    c.lightPosWorld = glm::vec3(-4.0f, 4.0f, -3.0f);
+    c.lightIa = 0.2f;
+    c.lightIl = glm::vec3(1.0f, 1.0f, 1.0f);
+    c.gamma = 2.2f;
+    return c;
+}
+
+// Uploads a position/normal mesh the way uploadMesh() does; returns the VAO.
+unsigned int upload_mesh(const Mesh& mesh, unsigned int buffers[2])
+{
+    unsigned int vao = 0;
+    glGenVertexArrays(1, &vao);
+    glBindVertexArray(vao);
+    glGenBuffers(2, buffers);
+    glBindBuffer(GL_ARRAY_BUFFER, buffers[0]);
+    glBufferData(GL_ARRAY_BUFFER, mesh.vertices().size_bytes(), mesh.vertices().data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers[1]);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, mesh.indices().size_bytes(), mesh.indices().data(), GL_STATIC_DRAW);
+    // Unit sphere: the position doubles as the normal.
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)0);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)0);
+    glEnableVertexAttribArray(1);
+    return vao;
+}
+
+// Points instance attributes 2 and 3 of PhongInstanced.vert at the
+// SphereInstance array at offset in buffer, as addInstanceBuffer()
+void point_instances(unsigned int vao, unsigned int buffer, size_t offset)
+{
+    glBindVertexArray(vao);
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(SphereInstance),
+        (void*)(offset + offsetof(SphereInstance, position)));
+    glEnableVertexAttribArray(2);
+    glVertexAttribDivisor(2, 1);
+    glVertexAttribIPointer(3, 1, GL_UNSIGNED_INT, sizeof(SphereInstance),
+        (void*)(offset + offsetof(SphereInstance, material)));
+    glEnableVertexAttribArray(3);
+    glVertexAttribDivisor(3, 1);
+}
+
+void upload_instances(unsigned int vao, unsigned int buffer, const std::vector<SphereInstance>& instances)
+{
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(SphereInstance), instances.data(), GL_STATIC_DRAW);
+    point_instances(vao, buffer, 0);
+}
+
+// The viewer's uniform blocks: camera at the origin looking down -z, the
+// given material and light, and the material palette for instancing.
+struct SceneUniforms
+{
+    UniformBuffer camera;
+    UniformBuffer light;
+    UniformBuffer material;
+    UniformBuffer object;
+    UniformBuffer palette;
+
+    void create(const PhongConstants& c)
+    {
+        camera.create(sizeof(CameraBlock), kCameraBinding);
+        light.create(sizeof(LightBlock), kLightBinding);
+        material.create(sizeof(MaterialBlock), kMaterialBinding);
+        object.create(sizeof(ObjectBlock), kObjectBinding);
+        palette.create(sizeof(MaterialPaletteBlock), kPaletteBinding);
+
+        CameraBlock cameraBlock = {};
+        cameraBlock.viewMatrix = glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+        cameraBlock.projectionMatrix = glm::frustum(-0.1f, 0.1f, -0.1f, 0.1f, 0.1f, 1000.0f);
+        cameraBlock.gamma = c.gamma;
+        camera.update(cameraBlock);
+        LightBlock lightBlock = {};
+        lightBlock.lightPosWorld = c.lightPosWorld;
+        lightBlock.lightIa = c.lightIa;
+        lightBlock.lightIl = c.lightIl;
+        light.update(lightBlock);
+        MaterialBlock materialBlock = {};
+        materialBlock.matKa = c.matKa;
+        materialBlock.matKd = c.matKd;
+        materialBlock.matKs = c.matKs;
+        materialBlock.matShininess = c.matShininess;
+        material.update(materialBlock);
+        MaterialPaletteBlock paletteBlock;
+        fill_material_palette(materialBlock, paletteBlock);
+        palette.update(paletteBlock);
+
+        camera.upload();
+        light.upload();
+        material.upload();
+        palette.upload();
+    }
+
+    void setObject(const glm::mat4& model)
+    {
+        ObjectBlock block = {};
+        block.modelMatrix = model;
+        block.setNormalMatrix(glm::transpose(glm::inverse(glm::mat3(model))));
+        object.update(block);
+        object.upload();
+    }
+
+    void destroy()
+    {
+        camera.destroy();
+        light.destroy();
+        material.destroy();
+        object.destroy();
+        palette.destroy();
+    }
+};
+
+} // namespace
+
+int run_shader_variant_report()
+{
+    const int width = 512, height = 512;
+    const int layers = 8;  // overlapping draws per frame, depth test off
+    const int frames = 5;
+
+    HeadlessContext context;
+    if (!context.create(width, height)) return 1;
+    std::string vertexSource = load_text_file("Phong.vert");
+    std::string fragmentSource = load_text_file("Phong.frag");
+    if (vertexSource.empty() || fragmentSource.empty()) return 1;
+
+    ShaderVariantCache variants(fragmentSource, [&](const std::string& fragment) {
+        return build_program(vertexSource, fragment);
+    });
+
+    // The sphere fills the view, so every layer shades the whole framebuffer.
+    Mesh sphere = create_sphere(64, 32);
+    unsigned int buffers[2] = {};
+    unsigned int vao = upload_mesh(sphere, buffers);
+    const PhongConstants constants = viewer_constants();
+    glm::mat4 model = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, -2.3f)) *
+        glm::scale(glm::mat4(1.0f), glm::vec3(2.0f));
+
+    SceneUniforms scene;
+    scene.create(constants);
+    scene.setObject(model);
+
+    unsigned int samplesQuery = 0;
+    glGenQueries(1, &samplesQuery);
+    glDisable(GL_DEPTH_TEST);
+
+    printf("Fragment cost, %dx%d, %d full-screen layers, average of %d frames\n", width, height, layers, frames);
+    printf("  %-24s %9s %10s %11s %10s\n", "variant", "build ms", "frame ms", "ns/fragment", "max diff");
+
+    const unsigned int kinds[] = {
+        kPhongDefault,
+        kPhongDefault | kPhongConstAll,
+        kPhongSpecular | kPhongBlinn | kPhongGamma,
+        kPhongSpecular | kPhongBlinn | kPhongGamma | kPhongConstAll,
+        kPhongGamma | kPhongConstAll,
+        kPhongSpecular | kPhongConstAll,
+    };
+    std::vector<unsigned char> reference;
+    for (unsigned int features : kinds) {
+        ShaderVariantKey key;
+        key.features = features;
+        key.constants = constants;
+        double buildStart = steady_seconds();
+        unsigned int program = variants.program(key);
+        glFinish();
+        double buildMs = (steady_seconds() - buildStart) * 1e3;
+        if (program == 0) continue;
+        ProgramUniforms uniforms(program);
+        bind_phong_blocks(uniforms);
+
+        glUseProgram(program);
+        glBindVertexArray(vao);
+        // Wall clock up to glFinish(): GL_TIME_ELAPSED only covers command
+        // submission on software rasterizers such as llvmpipe.
+        double frameMs = 0.0;
+        GLuint64 samples = 0;
+        for (int frame = -1; frame < frames; ++frame) { // frame -1 warms up
+            double frameStart = steady_seconds();
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            glBeginQuery(GL_SAMPLES_PASSED, samplesQuery);
+            for (int layer = 0; layer < layers; ++layer) {
+                glDrawElements(GL_TRIANGLES, (GLsizei)sphere.indexCount(), GL_UNSIGNED_INT, 0);
+            }
+            glEndQuery(GL_SAMPLES_PASSED);
+            glFinish();
+            GLuint64 passed = 0;
+            glGetQueryObjectui64v(samplesQuery, GL_QUERY_RESULT, &passed);
+            if (frame >= 0) {
+                frameMs += (steady_seconds() - frameStart) * 1e3;
+                samples += passed;
+            }
+        }
+
+        // Image difference against the generic shader (same features only)
+        std::vector<unsigned char> pixels = context.readPixels();
+        int maxDiff = 0;
+        if (features == kPhongDefault) reference = pixels;
+        if ((features & ~kPhongConstAll) == kPhongDefault && !reference.empty()) {
+            for (size_t i = 0; i < pixels.size(); ++i) {
+                maxDiff = std::max(maxDiff, abs((int)pixels[i] - (int)reference[i]));
+            }
+        }
+        char diff[16] = "-";
+        if ((features & ~kPhongConstAll) == kPhongDefault) snprintf(diff, sizeof(diff), "%d", maxDiff);
+        printf("  %-24s %9.2f %10.3f %11.3f %10s\n", shader_features_name(features).c_str(), buildMs,
+            frameMs / frames, samples > 0 ? frameMs * 1e6 / samples : 0.0, diff);
+    }
+
+    // Asking again only hits the cache.
+    for (unsigned int features : kinds) {
+        ShaderVariantKey key;
+        key.features = features;
+        key.constants = constants;
+        variants.program(key);
+    }
+    printf("Variant cache: %zu programs, %zu builds, %zu hits\n", variants.size(), variants.builds(), variants.hits());
+
+    glDeleteQueries(1, &samplesQuery);
+    glDeleteVertexArrays(1, &vao);
+    glDeleteBuffers(2, buffers);
+    scene.destroy();
+    variants.clear();
+    return 0;
+}
+
+int run_instancing_report()
+{
+    const int width = 256, height = 256;
+    const int frames = 3;
+    const size_t maxSeparateDraws = 10000; // one glDrawElements per sphere up to here
+
+    HeadlessContext context;
+    if (!context.create(width, height)) return 1;
+    std::string instancedSource = load_text_file("PhongInstanced.vert");
+    std::string vertexSource = load_text_file("Phong.vert");
+    std::string fragmentSource = load_text_file("Phong.frag");
+    if (instancedSource.empty() || vertexSource.empty() || fragmentSource.empty()) return 1;
+
+    ShaderVariantKey key;
+    key.features = kPhongDefault | kPhongMaterialPalette;
+    unsigned int instancedProgram = build_program(instancedSource, build_shader_variant(fragmentSource, key));
+    unsigned int singleProgram = build_program(vertexSource, fragmentSource);
+    if (instancedProgram == 0 || singleProgram == 0) return 1;
+    ProgramUniforms instancedUniforms(instancedProgram), singleUniforms(singleProgram);
+    bind_phong_blocks(instancedUniforms);
+    bind_phong_blocks(singleUniforms);
+
+    // A low-poly sphere keeps 1M instances within reach of a software
+    // rasterizer; the draw-call overhead is the same for any mesh.
+    Mesh sphere = create_icosphere(0.0f, 2);
+    unsigned int buffers[3] = {};
+    unsigned int vao = upload_mesh(sphere, buffers);
+    glGenBuffers(1, &buffers[2]);
+    const GLsizei indexCount = (GLsizei)sphere.indexCount();
+
+    SceneUniforms scene;
+    scene.create(viewer_constants());
+    // The [-1, 1]^3 instance grid in front of the camera, fully in view
+    const glm::mat4 group = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, -4.0f)) *
+        glm::scale(glm::mat4(1.0f), glm::vec3(1.5f));
+    glEnable(GL_DEPTH_TEST);
+
+    printf("Instanced drawing, %d-triangle sphere, %dx%d, average of %d frames\n", (int)sphere.triangleCount(),
+        width, height, frames);
+    printf("(1 draw/sphere: submit / frame ms with a uniform buffer update per sphere)\n");
+    printf("  %9s %12s %10s %10s %10s %12s %20s\n", "instances", "triangles", "upload ms", "submit ms", "frame ms",
+        "ns/instance", "1 draw/sphere");
+
+    for (size_t count = 1; count <= 1000000; count *= 10) {
+        std::vector<SphereInstance> instances = create_sphere_instances(count, kMaterialPaletteSize);
+        double uploadStart = steady_seconds();
+        upload_instances(vao, buffers[2], instances);
+        glFinish();
+        double uploadMs = (steady_seconds() - uploadStart) * 1e3;
+
+        // Submit: CPU time to issue the frame; frame: until glFinish() returns.
+        // Large counts get a single frame and no warm-up.
+        const int runs = count >= 100000 ? 1 : frames;
+        glUseProgram(instancedProgram);
+        scene.setObject(group);
+        double submitMs = 0.0, frameMs = 0.0;
+        for (int frame = runs > 1 ? -1 : 0; frame < runs; ++frame) { // frame -1 warms up
+            double frameStart = steady_seconds();
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            glDrawElementsInstanced(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, 0, (GLsizei)count);
+            double submitted = steady_seconds();
+            glFinish();
+            if (frame >= 0) {
+                submitMs += (submitted - frameStart) * 1e3;
+                frameMs += (steady_seconds() - frameStart) * 1e3;
+            }
+        }
+        submitMs /= runs;
+        frameMs /= runs;
+
+        // The same spheres with a uniform buffer update and a draw call each
+        char separate[32] = "-";
+        if (count <= maxSeparateDraws) {
+            glUseProgram(singleProgram);
+            double separateSubmitMs = 0.0, separateMs = 0.0;
+            for (int frame = -1; frame < runs; ++frame) {
+                double frameStart = steady_seconds();
+                glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+                for (const SphereInstance& instance : instances) {
+                    scene.setObject(group * glm::translate(glm::mat4(1.0f), instance.position) *
+                        glm::scale(glm::mat4(1.0f), glm::vec3(instance.scale)));
+                    glDrawElements(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, 0);
+                }
+                double submitted = steady_seconds();
+                glFinish();
+                if (frame >= 0) {
+                    separateSubmitMs += (submitted - frameStart) * 1e3;
+                    separateMs += (steady_seconds() - frameStart) * 1e3;
+                }
+            }
+            snprintf(separate, sizeof(separate), "%.3f / %.3f ms", separateSubmitMs / runs, separateMs / runs);
+        }
+
+        printf("  %9zu %12zu %10.3f %10.3f %10.3f %12.1f %20s\n", count, count * sphere.triangleCount(), uploadMs,
+            submitMs, frameMs, frameMs * 1e6 / count, separate);
+    }
+
+    glDeleteVertexArrays(1, &vao);
+    glDeleteBuffers(3, buffers);
+    glDeleteProgram(instancedProgram);
+    glDeleteProgram(singleProgram);
+    scene.destroy();
+    return 0;
+}
+
+int run_multi_draw_report()
+{
+    const int width = 256, height = 256;
+    const int frames = 5;
+    const size_t objects = 10000;
+
+    // MultiDrawElementsIndirect is core in 4.3; a 4.2 context falls back
+    // to one glDrawElementsIndirect per object.
+    HeadlessContext context;
+    if (!context.create(width, height, 4, 3) && !context.create(width, height, 4, 2)) return 1;
+    std::string batchSource = load_text_file("PhongMultiDraw.vert");
+    std::string vertexSource = load_text_file("Phong.vert");
+    std::string fragmentSource = load_text_file("Phong.frag");
+    if (batchSource.empty() || vertexSource.empty() || fragmentSource.empty()) return 1;
+
+    // Four different low-poly meshes in one set of buffers
+    MultiDrawBatch batch;
+    batch.addMesh(create_icosphere(0.0f, 1));
+    batch.addMesh(create_icosphere(0.0f, 2));
+    batch.addMesh(create_sphere(8, 6));
+    batch.addMesh(create_sphere(12, 8));
+    if (!batch.create(objects)) return 1;
+
+    ShaderVariantKey key;
+    key.features = kPhongDefault | kPhongMaterialPalette;
+    unsigned int batchProgram = build_program(inject_defines(batchSource, batch.shaderDefines()),
+        build_shader_variant(fragmentSource, key));
+    unsigned int singleProgram = build_program(vertexSource, fragmentSource);
+    if (batchProgram == 0 || singleProgram == 0) return 1;
+    ProgramUniforms batchUniforms(batchProgram), singleUniforms(singleProgram);
+    bind_phong_blocks(batchUniforms);
+    bind_phong_blocks(singleUniforms);
+    glUseProgram(batchProgram);
+    batchUniforms.set("drawData", 0);
+
+    const PhongConstants constants = viewer_constants();
+    SceneUniforms scene;
+    scene.create(constants);
+    MaterialBlock base = {};
+    base.matKa = constants.matKa;
+    base.matKd = constants.matKd;
+    base.matKs = constants.matKs;
+    base.matShininess = constants.matShininess;
+    MaterialPaletteBlock palette;
+    fill_material_palette(base, palette);
+
+    const glm::mat4 group = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, -4.0f)) *
+        glm::scale(glm::mat4(1.0f), glm::vec3(1.5f));
+    std::vector<SphereInstance> placement = create_sphere_instances(objects, kMaterialPaletteSize);
+    glEnable(GL_DEPTH_TEST);
+
+    printf("%zu objects of %zu meshes, %dx%d, average of %d frames (%s)\n", objects, batch.meshCount(), width, height,
+        frames, batch.usesMultiDraw() ? "glMultiDrawElementsIndirect" : "no multi-draw, one glDrawElementsIndirect each");
+    printf("  %-28s %11s %10s %10s\n", "path", "draw calls", "submit ms", "frame ms");
+
+    // Naive: per object, update the object and material blocks and draw.
+    {
+        glUseProgram(singleProgram);
+        glBindVertexArray(batch.vertexArray());
+        double submitMs = 0.0, frameMs = 0.0;
+        size_t drawCalls = 0;
+        for (int frame = -1; frame < frames; ++frame) { // frame -1 warms up
+            double frameStart = steady_seconds();
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            drawCalls = 0;
+            for (size_t i = 0; i < objects; ++i) {
+                const SphereInstance& object = placement[i];
+                const BatchMesh& mesh = batch.mesh(i % batch.meshCount());
+                scene.setObject(group * glm::translate(glm::mat4(1.0f), object.position) *
+                    glm::scale(glm::mat4(1.0f), glm::vec3(object.scale)));
+                scene.material.update(palette.materials[object.material]);
+                scene.material.upload();
+                glDrawElementsBaseVertex(GL_TRIANGLES, (GLsizei)mesh.indexCount, GL_UNSIGNED_INT,
+                    (void*)(mesh.firstIndex * sizeof(int)), mesh.baseVertex);
+                drawCalls++;
+            }
+            double submitted = steady_seconds();
+            glFinish();
+            if (frame >= 0) {
+                submitMs += (submitted - frameStart) * 1e3;
+                frameMs += (steady_seconds() - frameStart) * 1e3;
+            }
+        }
+        printf("  %-28s %11zu %10.3f %10.3f\n", "glDrawElements per object", drawCalls, submitMs / frames,
+            frameMs / frames);
+    }
+
+    // Batched: the draw list is rebuilt and uploaded every frame, as it
+    // would be after CPU culling.
+    {
+        glUseProgram(batchProgram);
+        scene.setObject(group);
+        double submitMs = 0.0, frameMs = 0.0;
+        size_t drawCalls = 0;
+        for (int frame = -1; frame < frames; ++frame) {
+            double frameStart = steady_seconds();
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            batch.clear();
+            for (size_t i = 0; i < objects; ++i) {
+                const SphereInstance& object = placement[i];
+                batch.add(i % batch.meshCount(), object.position, object.scale, object.material);
+            }
+            drawCalls = batch.submit();
+            double submitted = steady_seconds();
+            glFinish();
+            if (frame >= 0) {
+                submitMs += (submitted - frameStart) * 1e3;
+                frameMs += (steady_seconds() - frameStart) * 1e3;
+            }
+        }
+        printf("  %-28s %11zu %10.3f %10.3f\n", "indirect batch", drawCalls, submitMs / frames, frameMs / frames);
+    }
+
+    batch.destroy();
+    glDeleteProgram(batchProgram);
+    glDeleteProgram(singleProgram);
+    scene.destroy();
+    return 0;
+}
+
+int run_ring_buffer_report()
+{
+    const int width = 256, height = 256;
+    const int frames = 30;
+    const size_t count = 10000;
+
+    // Buffer storage is core in 4.4; glDrawElementsIndirect needs 4.0.
+    HeadlessContext context;
+    if (!context.create(width, height, 4, 4) && !context.create(width, height, 4, 0)) return 1;
+    std::string instancedSource = load_text_file("PhongInstanced.vert");
+    std::string fragmentSource = load_text_file("Phong.frag");
+    if (instancedSource.empty() || fragmentSource.empty()) return 1;
+    ShaderVariantKey key;
+    key.features = kPhongDefault | kPhongMaterialPalette;
+    unsigned int program = build_program(instancedSource, build_shader_variant(fragmentSource, key));
+    if (program == 0) return 1;
+    ProgramUniforms uniforms(program);
+    bind_phong_blocks(uniforms);
+
+    Mesh sphere = create_icosphere(0.0f, 1);
+    unsigned int buffers[4] = {}; // vertices, indices, instances, indirect command
+    unsigned int vao = upload_mesh(sphere, buffers);
+    glGenBuffers(2, &buffers[2]);
+    SceneUniforms scene;
+    scene.create(viewer_constants());
+
+    // Everything a frame rewrites: the instance array, the object block and
+    // the draw command.
+    const std::vector<SphereInstance> rest = create_sphere_instances(count, kMaterialPaletteSize);
+    std::vector<SphereInstance> animated(count);
+    const size_t instanceBytes = count * sizeof(SphereInstance);
+    auto objectAt = [](int frame) {
+        glm::mat4 model = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, -4.0f)) *
+            glm::rotate(glm::mat4(1.0f), 0.01f * frame, glm::vec3(0.0f, 1.0f, 0.0f)) *
+            glm::scale(glm::mat4(1.0f), glm::vec3(1.5f));
+        ObjectBlock block = {};
+        block.modelMatrix = model;
+        block.setNormalMatrix(glm::transpose(glm::inverse(glm::mat3(model))));
+        return block;
+    };
+    DrawElementsIndirectCommand command = {};
+    command.count = (uint32_t)sphere.indexCount();
+    command.instanceCount = (uint32_t)count;
+
+    glUseProgram(program);
+    glEnable(GL_DEPTH_TEST);
+    printf("%zu animated instances, %.1f KB per frame, %dx%d, %d frames without glFinish in between (%s)\n", count,
+        (instanceBytes + sizeof(ObjectBlock) + sizeof(command)) / 1024.0, width, height, frames,
+        gl_extensions().bufferStorage != nullptr ? "persistent mapping" : "no buffer storage, glBufferSubData copy");
+    printf("  %-22s %12s %10s %8s %12s %9s\n", "upload path", "CPU ms/frame", "frame ms", "stalls", "stall ms/frm",
+        "max diff");
+
+    std::vector<unsigned char> reference;
+    auto finish = [&](const char* name, double cpuMs, double totalMs, const RingStats* ring) {
+        std::vector<unsigned char> pixels = context.readPixels();
+        if (reference.empty()) reference = pixels;
+        int maxDiff = 0;
+        for (size_t i = 0; i < pixels.size(); ++i) {
+            maxDiff = std::max(maxDiff, abs((int)pixels[i] - (int)reference[i]));
+        }
+        char stalls[16] = "-", stallMs[16] = "-";
+        if (ring != nullptr) {
+            snprintf(stalls, sizeof(stalls), "%zu", ring->stalls);
+            snprintf(stallMs, sizeof(stallMs), "%.3f", ring->stallMs / frames);
+        }
+        printf("  %-22s %12.3f %10.3f %8s %12s %9d\n", name, cpuMs / frames, totalMs / frames, stalls, stallMs,
+            maxDiff);
+    };
+
+    // glBufferSubData into buffers the previous frames may still read, and
+    // the same with the buffers orphaned by glBufferData first.
+    for (int orphan = 0; orphan < 2; ++orphan) {
+        glBindBuffer(GL_ARRAY_BUFFER, buffers[2]);
+        glBufferData(GL_ARRAY_BUFFER, instanceBytes, nullptr, GL_DYNAMIC_DRAW);
+        point_instances(vao, buffers[2], 0);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, buffers[3]);
+        glBufferData(GL_DRAW_INDIRECT_BUFFER, sizeof(command), &command, GL_DYNAMIC_DRAW);
+        glFinish();
+        double cpuMs = 0.0, start = steady_seconds();
+        for (int frame = 0; frame < frames; ++frame) {
+            double frameStart = steady_seconds();
+            animate_sphere_instances(rest, frame / 60.0f, animated.data());
+            glBindBuffer(GL_ARRAY_BUFFER, buffers[2]);
+            if (orphan) glBufferData(GL_ARRAY_BUFFER, instanceBytes, nullptr, GL_DYNAMIC_DRAW);
+            glBufferSubData(GL_ARRAY_BUFFER, 0, instanceBytes, animated.data());
+            scene.object.update(objectAt(frame));
+            scene.object.upload();
+            if (orphan) glBufferData(GL_DRAW_INDIRECT_BUFFER, sizeof(command), nullptr, GL_DYNAMIC_DRAW);
+            glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, sizeof(command), &command);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            glDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, 0);
+            cpuMs += (steady_seconds() - frameStart) * 1e3;
+        }
+        glFinish();
+        finish(orphan ? "orphan + glBufferSubData" : "glBufferSubData", cpuMs, (steady_seconds() - start) * 1e3, nullptr);
+    }
+
+    // The ring with three segments, and with one to show what the stall
+    // counter catches when the CPU runs into frames still in flight.
+    const int segmentCounts[] = { FrameRingBuffer::kDefaultFrames, 1 };
+    for (int segments : segmentCounts) {
+        FrameRingBuffer ring;
+        if (!ring.create(instanceBytes + 2 * 256 + sizeof(ObjectBlock) + sizeof(command), segments)) continue;
+        glFinish();
+        double cpuMs = 0.0, start = steady_seconds();
+        for (int frame = 0; frame < frames; ++frame) {
+            double frameStart = steady_seconds();
+            ring.beginFrame();
+            RingAllocation instances = ring.allocate(instanceBytes);
+            RingAllocation object = ring.allocateUniform(sizeof(ObjectBlock));
+            RingAllocation indirect = ring.allocate(sizeof(command), 4);
+            animate_sphere_instances(rest, frame / 60.0f, (SphereInstance*)instances.data);
+            ObjectBlock block = objectAt(frame);
+            memcpy(object.data, &block, sizeof(block));
+            memcpy(indirect.data, &command, sizeof(command));
+            ring.flush();
+
+            point_instances(vao, ring.buffer(), instances.offset);
+            // Through the cache, which also tracks the generic binding that
+            // UniformBuffer::upload() relies on.
+            gl_state().bindBufferRange(GL_UNIFORM_BUFFER, kObjectBinding, ring.buffer(), (GLintptr)object.offset,
+                sizeof(ObjectBlock));
+            gl_state().bindBuffer(GL_DRAW_INDIRECT_BUFFER, ring.buffer());
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            glDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)indirect.offset);
+            ring.endFrame();
+            cpuMs += (steady_seconds() - frameStart) * 1e3;
+        }
+        glFinish();
+        char name[32];
+        snprintf(name, sizeof(name), "ring, %d segment%s", segments, segments > 1 ? "s" : "");
+        finish(name, cpuMs, (steady_seconds() - start) * 1e3, &ring.stats());
+        ring.destroy();
+    }
+
+    glDeleteVertexArrays(1, &vao);
+    glDeleteBuffers(4, buffers);
+    glDeleteProgram(program);
+    scene.destroy();
+    return 0;
+}
+
+int run_capture_report()
+{
+    struct CaptureSize
+    {
+        int width, height, frames;
+    };
+    const CaptureSize sizes[] = { { 512, 512, 240 }, { 3840, 2160, 24 } };
+    const int repeats = 3;
+    const ImageFormat formats[] = { ImageFormat::Ppm, ImageFormat::Png, ImageFormat::Exr };
+    std::string vertexSource = load_text_file("Phong.vert");
+    std::string fragmentSource = load_text_file("Phong.frag");
+    if (vertexSource.empty() || fragmentSource.empty()) return 1;
+
+    for (const CaptureSize& size : sizes) {
+        // Headless, like the batch jobs that capture frames.
+        HeadlessContext context;
+        if (!context.create(size.width, size.height)) return 1;
+        ShaderVariantKey key;
+        key.constants = viewer_constants();
+        unsigned int program = build_program(vertexSource, build_shader_variant(fragmentSource, key));
+        if (program == 0) return 1;
+        ProgramUniforms uniforms(program);
+        bind_phong_blocks(uniforms);
+        Mesh sphere = create_sphere(128, 64);
+        unsigned int buffers[2] = {};
+        unsigned int vao = upload_mesh(sphere, buffers);
+        SceneUniforms scene;
+        scene.create(key.constants);
+        glUseProgram(program);
+        glBindVertexArray(vao);
+        glEnable(GL_DEPTH_TEST);
+
+        // A turning sphere, so consecutive frames differ.
+        auto drawFrame = [&](int frame) {
+            scene.setObject(glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, -4.0f)) *
+                glm::rotate(glm::mat4(1.0f), 0.02f * frame, glm::vec3(0.0f, 1.0f, 0.0f)) *
+                glm::scale(glm::mat4(1.0f), glm::vec3(1.5f)));
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            glDrawElements(GL_TRIANGLES, (GLsizei)sphere.indexCount(), GL_UNSIGNED_INT, 0);
+        };
+        // Untimed warm-up, so no row pays for first-use costs.
+        for (int frame = 0; frame < size.frames; ++frame) {
+            drawFrame(frame);
+            context.present();
+        }
+        context.finish();
+
+        printf("Capture, %dx%d, %d frames, best of %d, %d encoder threads, %d readbacks in flight\n", size.width,
+            size.height, size.frames, repeats, FrameCapture::defaultThreads(), FrameCapture::kRingSize);
+        printf("  %-22s %10s %8s %11s %7s %9s %10s %11s %9s\n", "mode", "render fps", "vs none", "capture fps",
+            "stalls", "enc waits", "copy ms/f", "encode ms/f", "KB/image");
+
+        double baseFps = 0.0;
+        auto row = [&](const char* name, double renderFps, double captureFps, const CaptureStats* stats) {
+            if (baseFps == 0.0) baseFps = renderFps;
+            char capture[16] = "-", stalls[16] = "-", waits[16] = "-", copy[16] = "-", encode[16] = "-", kb[16] = "-";
+            if (captureFps > 0.0) snprintf(capture, sizeof(capture), "%.1f", captureFps);
+            if (stats != nullptr && stats->frames > 0 && stats->encoded > 0) {
+                snprintf(stalls, sizeof(stalls), "%zu", stats->readbackStalls);
+                snprintf(waits, sizeof(waits), "%zu", stats->encoderWaits);
+                snprintf(copy, sizeof(copy), "%.2f", stats->copyMs / stats->frames);
+                snprintf(encode, sizeof(encode), "%.2f", stats->encodeMs / stats->encoded);
+                snprintf(kb, sizeof(kb), "%.0f", stats->bytes / 1024.0 / stats->encoded);
+            }
+            printf("  %-22s %10.1f %7.0f%% %11s %7s %9s %10s %11s %9s\n", name, renderFps, renderFps * 100.0 / baseFps,
+                capture, stalls, waits, copy, encode, kb);
+        };
+
+        // One timed pass of size.frames frames. The render time of every
+        // mode runs up to context.finish(), so it covers the GPU work of
+        // all its frames; capture time runs to the last image encoded.
+        std::vector<unsigned char> pixels((size_t)size.width * size.height * 4);
+        auto timedPass = [&](bool readPixels, FrameCapture* capture, double& captureSeconds) {
+            double start = steady_seconds();
+            for (int frame = 0; frame < size.frames; ++frame) {
+                drawFrame(frame);
+                // The naive capture: glReadPixels into memory after every
+                // frame, which waits for the frame to finish first.
+                if (readPixels) glReadPixels(0, 0, size.width, size.height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+                if (capture != nullptr) capture->capture((size_t)frame);
+                context.present();
+            }
+            context.finish();
+            double renderSeconds = steady_seconds() - start;
+            if (capture != nullptr) capture->finish();
+            captureSeconds = steady_seconds() - start;
+            return renderSeconds;
+        };
+
+        // Modes: no capture, glReadPixels, then the pipeline per format,
+        // encoding into memory so the disk stays out of it. They take
+        // turns within each repeat, so drift of the machine hits all alike.
+        const int modes = 2 + (int)(sizeof(formats) / sizeof(formats[0]));
+        std::vector<double> renderSeconds(modes, 1e30), captureSeconds(modes, 1e30);
+        std::vector<CaptureStats> stats(modes);
+        for (int r = 0; r < repeats; ++r) {
+            for (int m = 0; m < modes; ++m) {
+                double captured = 0.0;
+                if (m < 2) {
+                    renderSeconds[m] = std::min(renderSeconds[m], timedPass(m == 1, nullptr, captured));
+                    captureSeconds[m] = std::min(captureSeconds[m], captured);
+                    continue;
+                }
+                FrameCapture capture;
+                if (!capture.create(size.width, size.height, formats[m - 2], std::string())) continue;
+                renderSeconds[m] = std::min(renderSeconds[m], timedPass(false, &capture, captured));
+                captureSeconds[m] = std::min(captureSeconds[m], captured);
+                stats[m] = capture.stats();
+                capture.destroy();
+            }
+        }
+
+        row("no capture", size.frames / renderSeconds[0], 0.0, nullptr);
+        row("glReadPixels (no enc.)", size.frames / renderSeconds[1], size.frames / captureSeconds[1], nullptr);
+        for (int m = 2; m < modes; ++m) {
+            if (stats[m].encoded == 0) continue;
+            char name[32];
+            snprintf(name, sizeof(name), "PBO ring + %s", image_format_name(formats[m - 2]));
+            row(name, size.frames / renderSeconds[m], stats[m].encoded / captureSeconds[m], &stats[m]);
+        }
+
+        glDeleteVertexArrays(1, &vao);
+        glDeleteBuffers(2, buffers);
+        glDeleteProgram(program);
+        scene.destroy();
+    }
+    return 0;
+}
+
+int run_program_cache_report()
+{
+    const char* directory = "program_cache_report";
+    std::string vertexSource = load_text_file("Phong.vert");
+    std::string fragmentSource = load_text_file("Phong.frag");
+    if (vertexSource.empty() || fragmentSource.empty()) return 1;
+
+    // Every combination of the lighting and constant-folding features
+    std::vector<std::string> fragments;
+    ShaderVariantKey key;
+    key.constants = viewer_constants();
+    for (unsigned int features = 0; features < kPhongMaterialPalette; ++features) {
+        key.features = features;
+        fragments.push_back(build_shader_variant(fragmentSource, key));
+    }
+
+    enum class Pass { NoCache, Cold, Warm };
+    const Pass passes[] = { Pass::NoCache, Pass::Cold, Pass::Warm };
+    const char* names[] = { "no cache", "cold cache", "warm cache" };
+    double baseMs = 0.0;
+    for (Pass pass : passes) {
+        HeadlessContext context;
+        if (!context.create(64, 64)) return 1;
+        ProgramBinaryCache& cache = program_cache();
+        if (pass == Pass::NoCache) {
+            GLint formats = 0;
+            glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+            printf("Program cache, %zu variants of Phong.vert + Phong.frag, %s, %d binary formats\n",
+                fragments.size(), (const char*)glGetString(GL_RENDERER), formats);
+            printf("  %-12s %10s %10s %7s %7s %7s %10s %8s\n", "pass", "total ms", "ms/program", "hits", "misses",
+                "stores", "KB stored", "vs none");
+        }
+        else if (!cache.open(directory)) {
+            return 1;
+        }
+        cache.resetStats();
+
+        std::vector<ProgramStage> stages(2);
+        stages[0].type = GL_VERTEX_SHADER;
+        stages[0].source = &vertexSource;
+        stages[1].type = GL_FRAGMENT_SHADER;
+        std::vector<unsigned int> programs;
+        double start = steady_seconds();
+        for (const std::string& fragment : fragments) {
+            stages[1].source = &fragment;
+            uint64_t programKey = cache.enabled() ? cache.key(stages) : 0;
+            if (pass == Pass::Cold) cache.remove(programKey);
+            unsigned int program = cache.enabled() ? cache.load(programKey) : 0;
+            if (program == 0) {
+                program = build_program(vertexSource, fragment);
+                if (program != 0) cache.store(programKey, program);
+            }
+            programs.push_back(program);
+        }
+        // Drivers may compile lazily; the first use would pay for it.
+        glFinish();
+        double totalMs = (steady_seconds() - start) * 1e3;
+        if (baseMs == 0.0) baseMs = totalMs;
+
+        ProgramCacheStats stats = cache.stats();
+        size_t built = 0;
+        for (unsigned int program : programs) {
+            if (program != 0) built++;
+            glDeleteProgram(program);
+        }
+        char hits[16] = "-", misses[16] = "-", stores[16] = "-", kb[16] = "-";
+        if (cache.enabled()) {
+            snprintf(hits, sizeof(hits), "%zu", stats.hits);
+            snprintf(misses, sizeof(misses), "%zu", stats.misses + stats.rejected);
+            snprintf(stores, sizeof(stores), "%zu", stats.stores);
+            snprintf(kb, sizeof(kb), "%.0f", pass == Pass::Cold ? stats.bytes / 1024.0 : 0.0);
+        }
+        printf("  %-12s %10.1f %10.2f %7s %7s %7s %10s %7.0f%%\n", names[(int)pass], totalMs,
+            built > 0 ? totalMs / built : 0.0, hits, misses, stores, kb, totalMs * 100.0 / baseMs);
+        cache.close();
+        if (built != fragments.size()) {
+            fprintf(stderr, "%zu of %zu programs failed\n", fragments.size() - built, fragments.size());
+            return 1;
+        }
+    }
+    printf("Binaries are kept in %s/. The driver's own shader cache (Mesa, NVIDIA) may already\n"
+        "shorten the compiles of the first two passes.\n", directory);
+    return 0;
+}
+
+int run_parallel_compile_report()
+{
+    const int variantCount = 100;
+    std::string vertexSource = load_text_file("Phong.vert");
+    std::string fragmentSource = load_text_file("Phong.frag");
+    if (vertexSource.empty() || fragmentSource.empty()) return 1;
+
+    enum class Pass { Serial, Deferred, Parallel };
+    const Pass passes[] = { Pass::Serial, Pass::Deferred, Pass::Parallel };
+    const char* names[] = { "check each call", "deferred, 1 thread", "deferred, driver" };
+    double baseMs = 0.0;
+    for (Pass pass : passes) {
+        HeadlessContext context;
+        if (!context.create(256, 256)) return 1;
+        const bool parallel = gl_extensions().parallelShaderCompile;
+        if (pass == Pass::Serial) {
+            printf("Shader compile, %d variants of Phong.vert + Phong.frag, %s, %s\n", variantCount,
+                (const char*)glGetString(GL_RENDERER),
+                parallel ? "KHR_parallel_shader_compile" : "no parallel shader compile");
+            printf("  %-20s %10s %11s %12s %14s %8s\n", "pass", "wall ms", "ms/variant", "first ready",
+                "frames drawn", "vs each");
+        }
+        if (pass == Pass::Deferred && !parallel) continue;
+        // Threads only matter while nothing asks for a status early.
+        set_shader_compiler_threads(pass == Pass::Deferred ? 0 : 0xFFFFFFFFu);
+
+        // A run-unique define keeps the driver's shader cache out of it.
+        char run[80];
+        snprintf(run, sizeof(run), "#define COMPILE_REPORT_RUN %lld\n",
+            (long long)std::chrono::steady_clock::now().time_since_epoch().count() + (int)pass);
+        std::string vertex = inject_defines(vertexSource, run);
+        std::vector<std::string> fragments;
+        ShaderVariantKey key;
+        key.constants = viewer_constants();
+        for (int i = 0; i < variantCount; ++i) {
+            key.features = kPhongConstAll | (unsigned int)(i & (kPhongSpecular | kPhongBlinn | kPhongGamma));
+            key.constants.matShininess = 4.0f + i;
+            fragments.push_back(inject_defines(build_shader_variant(fragmentSource, key), run));
+        }
+
+        // The fallback: the generic shader, built before the clock starts.
+        key.features = kPhongDefault;
+        unsigned int fallback = build_program(vertexSource, build_shader_variant(fragmentSource, key));
+        if (fallback == 0) return 1;
+        ProgramUniforms uniforms(fallback);
+        bind_phong_blocks(uniforms);
+        Mesh sphere = create_sphere(32, 16);
+        unsigned int buffers[2] = {};
+        unsigned int vao = upload_mesh(sphere, buffers);
+        SceneUniforms scene;
+        scene.create(key.constants);
+        scene.setObject(glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, -4.0f)));
+        glEnable(GL_DEPTH_TEST);
+        context.finish();
+
+        std::vector<unsigned int> programs;
+        size_t frames = 0;
+        double firstReadyMs = 0.0;
+        double start = steady_seconds();
+        if (pass == Pass::Serial) {
+            for (const std::string& fragment : fragments) {
+                programs.push_back(build_program(vertex, fragment));
+                if (firstReadyMs == 0.0) firstReadyMs = (steady_seconds() - start) * 1e3;
+            }
+        }
+        else {
+            std::vector<ProgramStage> stages(2);
+            stages[0].type = GL_VERTEX_SHADER;
+            stages[0].source = &vertex;
+            stages[1].type = GL_FRAGMENT_SHADER;
+            std::vector<PendingProgram> pending;
+            for (const std::string& fragment : fragments) {
+                stages[1].source = &fragment;
+                pending.push_back(submit_program(stages));
+            }
+            // A frame with the fallback, then every variant that would not
+            // block, until all are done.
+            size_t done = 0;
+            while (done < pending.size()) {
+                glUseProgram(fallback);
+                glBindVertexArray(vao);
+                glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+                glDrawElements(GL_TRIANGLES, (GLsizei)sphere.indexCount(), GL_UNSIGNED_INT, 0);
+                context.present();
+                frames++;
+                for (PendingProgram& program : pending) {
+                    if (program.finished || !program_ready(program)) continue;
+                    programs.push_back(finish_program(program));
+                    if (firstReadyMs == 0.0) firstReadyMs = (steady_seconds() - start) * 1e3;
+                    done++;
+                }
+            }
+        }
+        context.finish();
+        double wallMs = (steady_seconds() - start) * 1e3;
+        if (baseMs == 0.0) baseMs = wallMs;
+
+        size_t built = 0;
+        for (unsigned int program : programs) {
+            if (program != 0) built++;
+            glDeleteProgram(program);
+        }
+        char drawn[16] = "-";
+        if (pass != Pass::Serial) snprintf(drawn, sizeof(drawn), "%zu", frames);
+        printf("  %-20s %10.1f %11.2f %12.1f %14s %7.0f%%\n", parallel || pass == Pass::Serial ? names[(int)pass] :
+            "deferred", wallMs, wallMs / variantCount, firstReadyMs, drawn, wallMs * 100.0 / baseMs);
+
+        glDeleteVertexArrays(1, &vao);
+        glDeleteBuffers(2, buffers);
+        glDeleteProgram(fallback);
+        scene.destroy();
+        if (built != fragments.size()) {
+            fprintf(stderr, "%zu of %zu variants failed\n", fragments.size() - built, fragments.size());
+            return 1;
+        }
+    }
+    return 0;
+}
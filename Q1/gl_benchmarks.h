@@ -0,0 +1,42 @@
+#pragma once
+#ifndef GL_BENCHMARKS_H
+#define GL_BENCHMARKS_H
+
+// GPU benchmarks and reports. Each creates its own HeadlessContext and
+// renders into its offscreen framebuffer, so they run without a display and
+// vsync and the window system stay out of the measurement. Each returns 0
+// on success.
+
+// Fragment cost of the generic Phong.frag against specialized permutations.
+int run_shader_variant_report();
+
+// Frame time of one glDrawElementsInstanced for 1 to 1M spheres, against
+// one draw call per sphere up to 10k.
+int run_instancing_report();
+
+// 10k objects of four different meshes: one draw call per object against a
+// single glMultiDrawElementsIndirect (draw calls, CPU submit and frame time).
+int run_multi_draw_report();
+
+// 10k instances animated every frame: per-frame glBufferSubData and buffer
+// orphaning against the fenced FrameRingBuffer (CPU time and stalls).
+int run_ring_buffer_report();
+
+// Frame capture at 512x512 and 4K: render throughput without capture, with
+// a synchronous glReadPixels per frame and with the PBO ring + encoder
+// threads for PPM, PNG and EXR, and the sustained captured frames/s.
+int run_capture_report();
+
+// Shader build time of a start that needs 64 Phong.frag variants: compiling
+// without the program cache, with a cold cache (compile, link and store the
+// binaries) and with a warm one (glProgramBinary only). Each pass gets a
+// fresh headless context, like a new process.
+int run_program_cache_report();
+
+// Wall time to build 100 Phong.frag variants: status checked after every
+// compile and link, against all submitted first and checked afterwards on
+// one and on the driver's compiler threads (KHR_parallel_shader_compile),
+// with frames drawn by a fallback program while the variants finish.
+int run_parallel_compile_report();
+
+#endif // GL_BENCHMARKS_H
@@ -0,0 +1,66 @@
+//
+//  gl_extensions.cpp
+//  Loader for entry points missing from the bundled GLEW
+//
+
+#include <string.h>
+#include "gl_extensions.h"
+#include <GLFW/glfw3.h>
+
+namespace {
+
+GLExtensions extensions;
+
+} // namespace
+
+bool has_gl_extension(const char* name)
+{
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (GLint i = 0; i < count; ++i) {
+        const char* extension = (const char*)glGetStringi(GL_EXTENSIONS, (GLuint)i);
+        if (extension != nullptr && strcmp(extension, name) == 0) return true;
+    }
+    return false;
+}
+
+int gl_version()
+{
+    GLint major = 0, minor = 0;
+    glGetIntegerv(GL_MAJOR_VERSION, &major);
+    glGetIntegerv(GL_MINOR_VERSION, &minor);
+    return major * 10 + minor;
+}
+
+const GLExtensions& load_gl_extensions(GLProcLoader loader)
+{
+    if (loader == nullptr) loader = glfwGetProcAddress;
+    extensions = GLExtensions();
+    const int version = gl_version();
+
+    if (version >= 43 || has_gl_extension("GL_ARB_multi_draw_indirect")) {
+        extensions.multiDrawElementsIndirect =
+            (PFNGLMULTIDRAWELEMENTSINDIRECTPROC)loader("glMultiDrawElementsIndirect");
+    }
+    if (version >= 44 || has_gl_extension("GL_ARB_buffer_storage")) {
+        extensions.bufferStorage = (PFNGLBUFFERSTORAGEPROC)loader("glBufferStorage");
+    }
+    extensions.pipelineStatistics = version >= 46 || has_gl_extension("GL_ARB_pipeline_statistics_query");
+    extensions.shaderDrawParameters = version >= 46 || has_gl_extension("GL_ARB_shader_draw_parameters");
+    extensions.baseInstance = version >= 42 || has_gl_extension("GL_ARB_base_instance");
+    if (has_gl_extension("GL_KHR_parallel_shader_compile")) {
+        extensions.maxShaderCompilerThreads =
+            (PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)loader("glMaxShaderCompilerThreadsKHR");
+    }
+    else if (has_gl_extension("GL_ARB_parallel_shader_compile")) {
+        extensions.maxShaderCompilerThreads =
+            (PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)loader("glMaxShaderCompilerThreadsARB");
+    }
+    extensions.parallelShaderCompile = extensions.maxShaderCompilerThreads != nullptr;
+    return extensions;
+}
+
+const GLExtensions& gl_extensions()
+{
+    return extensions;
+}
@@ -0,0 +1,71 @@
+#pragma once
+#ifndef GL_EXTENSIONS_H
+#define GL_EXTENSIONS_H
+
+#include <GL/glew.h>
+
+// Entry points and tokens newer than the bundled GLEW (GL 4.2). They are
+// loaded by load_gl_extensions() once a context is current; a null pointer
+// means the driver does not provide them.
+
+#ifndef GL_VERSION_4_3
+typedef void (GLAPIENTRY* PFNGLMULTIDRAWELEMENTSINDIRECTPROC)(GLenum mode, GLenum type, const void* indirect,
+    GLsizei drawcount, GLsizei stride);
+#endif
+
+#ifndef GL_VERSION_4_4
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#define GL_MAP_COHERENT_BIT 0x0080
+#define GL_DYNAMIC_STORAGE_BIT 0x0100
+#define GL_CLIENT_STORAGE_BIT 0x0200
+typedef void (GLAPIENTRY* PFNGLBUFFERSTORAGEPROC)(GLenum target, GLsizeiptr size, const void* data,
+    GLbitfield flags);
+#endif
+
+#ifndef GL_KHR_parallel_shader_compile
+#define GL_MAX_SHADER_COMPILER_THREADS_KHR 0x91B0
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+typedef void (GLAPIENTRY* PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)(GLuint count);
+#endif
+
+#ifndef GL_VERTICES_SUBMITTED_ARB
+#define GL_VERTICES_SUBMITTED_ARB 0x82EE
+#define GL_PRIMITIVES_SUBMITTED_ARB 0x82EF
+#define GL_FRAGMENT_SHADER_INVOCATIONS_ARB 0x82F4
+#endif
+
+struct GLExtensions
+{
+    // GL 4.3 / ARB_multi_draw_indirect
+    PFNGLMULTIDRAWELEMENTSINDIRECTPROC multiDrawElementsIndirect = nullptr;
+    // GL 4.4 / ARB_buffer_storage (immutable, persistently mappable buffers)
+    PFNGLBUFFERSTORAGEPROC bufferStorage = nullptr;
+    // ARB_pipeline_statistics_query (glBeginQuery targets), core in GL 4.6
+    bool pipelineStatistics = false;
+    // ARB_shader_draw_parameters (gl_DrawIDARB), core in GL 4.6
+    bool shaderDrawParameters = false;
+    // GL 4.2 / ARB_base_instance: baseInstance of indirect commands is honored
+    bool baseInstance = false;
+    // KHR_parallel_shader_compile (or the ARB version, same tokens): compiles
+    // and links may finish on driver threads; GL_COMPLETION_STATUS_KHR polls
+    // them without blocking
+    PFNGLMAXSHADERCOMPILERTHREADSKHRPROC maxShaderCompilerThreads = nullptr;
+    bool parallelShaderCompile = false;
+};
+
+// Entry point lookup of the window system behind the current context
+typedef void (*GLProc)(void);
+typedef GLProc (*GLProcLoader)(const char* name);
+
+// Loads the entry points for the current context; call after glewInit().
+// The loader defaults to glfwGetProcAddress (contexts of GLFW windows).
+const GLExtensions& load_gl_extensions(GLProcLoader loader = nullptr);
+// The table filled by the last load_gl_extensions()
+const GLExtensions& gl_extensions();
+
+// True if the current context lists the extension (glGetStringi).
+bool has_gl_extension(const char* name);
+// GL version of the current context as major * 10 + minor, e.g. 43
+int gl_version();
+
+#endif // GL_EXTENSIONS_H
@@ -0,0 +1,361 @@
+//
+//  gl_state.cpp
+//  Redundant state change elision with a glGet* cross-check
+//
+
+#include <stdio.h>
+#include "gl_state.h"
+
+namespace {
+
+// Only this many mismatches are printed; the rest are just counted.
+const size_t kMaxReports = 16;
+
+struct BufferTargetInfo
+{
+    GLenum target;
+    GLenum binding;
+};
+
+// In GLStateCache::BufferTarget order
+const BufferTargetInfo kBufferTargetInfo[] = {
+    { GL_ARRAY_BUFFER, GL_ARRAY_BUFFER_BINDING },
+    { GL_ELEMENT_ARRAY_BUFFER, GL_ELEMENT_ARRAY_BUFFER_BINDING },
+    { GL_UNIFORM_BUFFER, GL_UNIFORM_BUFFER_BINDING },
+    { GL_DRAW_INDIRECT_BUFFER, GL_DRAW_INDIRECT_BUFFER_BINDING },
+    { GL_COPY_READ_BUFFER, GL_COPY_READ_BUFFER },
+    { GL_COPY_WRITE_BUFFER, GL_COPY_WRITE_BUFFER },
+    { GL_TEXTURE_BUFFER, GL_TEXTURE_BUFFER },
+    { GL_PIXEL_PACK_BUFFER, GL_PIXEL_PACK_BUFFER_BINDING },
+    { GL_PIXEL_UNPACK_BUFFER, GL_PIXEL_UNPACK_BUFFER_BINDING },
+};
+
+// In GLStateCache::TextureTarget order
+const BufferTargetInfo kTextureTargetInfo[] = {
+    { GL_TEXTURE_2D, GL_TEXTURE_BINDING_2D },
+    { GL_TEXTURE_3D, GL_TEXTURE_BINDING_3D },
+    { GL_TEXTURE_CUBE_MAP, GL_TEXTURE_BINDING_CUBE_MAP },
+    { GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BINDING_2D_ARRAY },
+    { GL_TEXTURE_BUFFER, GL_TEXTURE_BINDING_BUFFER },
+};
+
+// In GLStateCache::Capability order
+const GLenum kCapabilityEnums[] = { GL_DEPTH_TEST, GL_BLEND, GL_SCISSOR_TEST, GL_CULL_FACE };
+
+template <size_t N>
+int slot_of(const BufferTargetInfo (&table)[N], GLenum target)
+{
+    for (size_t i = 0; i < N; ++i) {
+        if (table[i].target == target) return (int)i;
+    }
+    return -1;
+}
+
+int capability_slot(GLenum cap)
+{
+    for (size_t i = 0; i < sizeof(kCapabilityEnums) / sizeof(kCapabilityEnums[0]); ++i) {
+        if (kCapabilityEnums[i] == cap) return (int)i;
+    }
+    return -1;
+}
+
+GLint get_integer(GLenum query)
+{
+    GLint value = 0;
+    glGetIntegerv(query, &value);
+    return value;
+}
+
+} // namespace
+
+GLStateCache& gl_state()
+{
+    static GLStateCache cache;
+    return cache;
+}
+
+void GLStateCache::invalidate()
+{
+    mProgram = kUnknown;
+    mVertexArray = kUnknown;
+    for (GLuint& buffer : mBuffers) buffer = kUnknown;
+    for (IndexedBinding& binding : mUniformBindings) binding = IndexedBinding{ 0, 0, 0, false };
+    mActiveTexture = kUnknown;
+    for (auto& unit : mTextures) {
+        for (GLuint& texture : unit) texture = kUnknown;
+    }
+    for (int& cap : mCapabilities) cap = -1;
+    mDepthFunc = kUnknown;
+    mDepthMask = -1;
+    mBlendSrc = mBlendDst = kUnknown;
+    mViewportKnown = false;
+}
+
+bool GLStateCache::mismatch(const char* what, GLint cached, GLint actual)
+{
+    if (mStats.mismatches++ < kMaxReports) {
+        fprintf(stderr, "GL state mismatch: %s cached %d, actual %d\n", what, cached, actual);
+    }
+    return true;
+}
+
+// Counts the call and returns true when it has to reach GL. In debug mode a
+// call the cache would skip is checked against glGetIntegerv(query) first.
+bool GLStateCache::needed(bool matches, const char* what, GLenum query, GLint cached)
+{
+    if (matches && mDebug && query != 0) {
+        GLint actual = get_integer(query);
+        if (actual != cached) matches = !mismatch(what, cached, actual);
+    }
+    if (matches) {
+        mStats.avoided++;
+        return false;
+    }
+    mStats.issued++;
+    return true;
+}
+
+void GLStateCache::useProgram(GLuint program)
+{
+    if (!needed(mProgram == program, "program", GL_CURRENT_PROGRAM, (GLint)program)) return;
+    glUseProgram(program);
+    mProgram = program;
+}
+
+void GLStateCache::bindVertexArray(GLuint vao)
+{
+    if (!needed(mVertexArray == vao, "vertex array", GL_VERTEX_ARRAY_BINDING, (GLint)vao)) return;
+    glBindVertexArray(vao);
+    mVertexArray = vao;
+    mBuffers[kElementArrayBuffer] = kUnknown;
+}
+
+void GLStateCache::bindBuffer(GLenum target, GLuint buffer)
+{
+    int slot = slot_of(kBufferTargetInfo, target);
+    if (slot < 0) {
+        mStats.issued++;
+        glBindBuffer(target, buffer);
+        return;
+    }
+    if (!needed(mBuffers[slot] == buffer, "buffer binding", kBufferTargetInfo[slot].binding, (GLint)buffer)) return;
+    glBindBuffer(target, buffer);
+    mBuffers[slot] = buffer;
+}
+
+void GLStateCache::bindBufferBase(GLenum target, GLuint index, GLuint buffer)
+{
+    bindBufferRange(target, index, buffer, 0, 0);
+}
+
+void GLStateCache::bindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size)
+{
+    int slot = slot_of(kBufferTargetInfo, target);
+    IndexedBinding* binding = target == GL_UNIFORM_BUFFER && index < (GLuint)kIndexedBindings ?
+        &mUniformBindings[index] : nullptr;
+    bool matches = binding != nullptr && binding->known && binding->buffer == buffer &&
+        binding->offset == offset && binding->size == size;
+    if (matches && mDebug) {
+        GLint actual = 0;
+        glGetIntegeri_v(GL_UNIFORM_BUFFER_BINDING, index, &actual);
+        if (actual != (GLint)buffer) matches = !mismatch("uniform buffer range", (GLint)buffer, actual);
+    }
+    if (!needed(matches, "uniform buffer range")) return;
+
+    if (size == 0) glBindBufferBase(target, index, buffer);
+    else glBindBufferRange(target, index, buffer, offset, size);
+    // Both also bind the buffer to the generic target.
+    if (slot >= 0) mBuffers[slot] = buffer;
+    if (binding != nullptr) *binding = IndexedBinding{ buffer, offset, size, true };
+}
+
+void GLStateCache::activeTexture(GLenum unit)
+{
+    if (!needed(mActiveTexture == unit, "active texture", GL_ACTIVE_TEXTURE, (GLint)unit)) return;
+    glActiveTexture(unit);
+    mActiveTexture = unit;
+}
+
+void GLStateCache::bindTexture(GLuint unit, GLenum target, GLuint texture)
+{
+    int slot = slot_of(kTextureTargetInfo, target);
+    if (slot < 0 || unit >= (GLuint)kTextureUnits) {
+        activeTexture(GL_TEXTURE0 + unit);
+        mStats.issued++;
+        glBindTexture(target, texture);
+        return;
+    }
+    bool matches = mTextures[unit][slot] == texture;
+    // The binding query reads the active unit.
+    if (matches && mDebug) activeTexture(GL_TEXTURE0 + unit);
+    if (!needed(matches, "texture binding", kTextureTargetInfo[slot].binding, (GLint)texture)) return;
+    activeTexture(GL_TEXTURE0 + unit);
+    glBindTexture(target, texture);
+    mTextures[unit][slot] = texture;
+}
+
+void GLStateCache::setEnabled(GLenum cap, bool enabled)
+{
+    int slot = capability_slot(cap);
+    bool matches = slot >= 0 && mCapabilities[slot] == (enabled ? 1 : 0);
+    if (matches && mDebug && (glIsEnabled(cap) == GL_TRUE) != enabled) {
+        matches = !mismatch("capability", enabled ? 1 : 0, enabled ? 0 : 1);
+    }
+    if (!needed(matches, "capability")) return;
+    if (enabled) glEnable(cap);
+    else glDisable(cap);
+    if (slot >= 0) mCapabilities[slot] = enabled ? 1 : 0;
+}
+
+void GLStateCache::depthFunc(GLenum func)
+{
+    if (!needed(mDepthFunc == func, "depth func", GL_DEPTH_FUNC, (GLint)func)) return;
+    glDepthFunc(func);
+    mDepthFunc = func;
+}
+
+void GLStateCache::depthMask(bool write)
+{
+    if (!needed(mDepthMask == (write ? 1 : 0), "depth mask", GL_DEPTH_WRITEMASK, write ? 1 : 0)) return;
+    glDepthMask(write ? GL_TRUE : GL_FALSE);
+    mDepthMask = write ? 1 : 0;
+}
+
+void GLStateCache::blendFunc(GLenum src, GLenum dst)
+{
+    bool matches = mBlendSrc == src && mBlendDst == dst;
+    if (matches && mDebug && (GLenum)get_integer(GL_BLEND_DST_RGB) != dst) {
+        matches = !mismatch("blend dst", (GLint)dst, get_integer(GL_BLEND_DST_RGB));
+    }
+    if (!needed(matches, "blend src", GL_BLEND_SRC_RGB, (GLint)src)) return;
+    glBlendFunc(src, dst);
+    mBlendSrc = src;
+    mBlendDst = dst;
+}
+
+void GLStateCache::viewport(GLint x, GLint y, GLsizei width, GLsizei height)
+{
+    bool matches = mViewportKnown && mViewport[0] == x && mViewport[1] == y && mViewport[2] == width &&
+        mViewport[3] == height;
+    if (matches && mDebug) {
+        GLint actual[4];
+        glGetIntegerv(GL_VIEWPORT, actual);
+        for (int i = 0; i < 4 && matches; ++i) {
+            if (actual[i] != mViewport[i]) matches = !mismatch("viewport", mViewport[i], actual[i]);
+        }
+    }
+    if (!needed(matches, "viewport")) return;
+    glViewport(x, y, width, height);
+    mViewport[0] = x;
+    mViewport[1] = y;
+    mViewport[2] = width;
+    mViewport[3] = height;
+    mViewportKnown = true;
+}
+
+void GLStateCache::deleteBuffers(GLsizei count, const GLuint* buffers)
+{
+    for (GLsizei i = 0; i < count; ++i) {
+        if (buffers[i] == 0) continue;
+        for (GLuint& bound : mBuffers) {
+            if (bound == buffers[i]) bound = 0;
+        }
+        for (IndexedBinding& binding : mUniformBindings) {
+            if (binding.known && binding.buffer == buffers[i]) binding = IndexedBinding{ 0, 0, 0, true };
+        }
+    }
+    glDeleteBuffers(count, buffers);
+}
+
+void GLStateCache::deleteVertexArrays(GLsizei count, const GLuint* arrays)
+{
+    for (GLsizei i = 0; i < count; ++i) {
+        if (arrays[i] != 0 && mVertexArray == arrays[i]) {
+            mVertexArray = 0;
+            mBuffers[kElementArrayBuffer] = kUnknown;
+        }
+    }
+    glDeleteVertexArrays(count, arrays);
+}
+
+void GLStateCache::deleteTextures(GLsizei count, const GLuint* textures)
+{
+    for (GLsizei i = 0; i < count; ++i) {
+        if (textures[i] == 0) continue;
+        for (auto& unit : mTextures) {
+            for (GLuint& bound : unit) {
+                if (bound == textures[i]) bound = 0;
+            }
+        }
+    }
+    glDeleteTextures(count, textures);
+}
+
+size_t GLStateCache::verify()
+{
+    size_t before = mStats.mismatches;
+    auto check = [this](const char* what, GLuint& cached, GLint actual) {
+        if (cached == kUnknown || (GLint)cached == actual) return;
+        mismatch(what, (GLint)cached, actual);
+        cached = (GLuint)actual;
+    };
+
+    check("program", mProgram, get_integer(GL_CURRENT_PROGRAM));
+    check("vertex array", mVertexArray, get_integer(GL_VERTEX_ARRAY_BINDING));
+    for (int i = 0; i < kBufferTargets; ++i) {
+        check("buffer binding", mBuffers[i], get_integer(kBufferTargetInfo[i].binding));
+    }
+    for (GLuint i = 0; i < (GLuint)kIndexedBindings; ++i) {
+        IndexedBinding& binding = mUniformBindings[i];
+        if (!binding.known) continue;
+        GLint buffer = 0, offset = 0, size = 0;
+        glGetIntegeri_v(GL_UNIFORM_BUFFER_BINDING, i, &buffer);
+        glGetIntegeri_v(GL_UNIFORM_BUFFER_START, i, &offset);
+        glGetIntegeri_v(GL_UNIFORM_BUFFER_SIZE, i, &size);
+        if (buffer != (GLint)binding.buffer || offset != (GLint)binding.offset || size != (GLint)binding.size) {
+            mismatch("uniform buffer range", (GLint)binding.buffer, buffer);
+            binding = IndexedBinding{ (GLuint)buffer, offset, size, true };
+        }
+    }
+
+    // Texture bindings are per unit, so walk the units and restore the active one.
+    GLint active = get_integer(GL_ACTIVE_TEXTURE);
+    check("active texture", mActiveTexture, active);
+    for (GLuint unit = 0; unit < (GLuint)kTextureUnits; ++unit) {
+        bool known = false;
+        for (GLuint texture : mTextures[unit]) known = known || texture != kUnknown;
+        if (!known) continue;
+        glActiveTexture(GL_TEXTURE0 + unit);
+        for (int i = 0; i < kTextureTargets; ++i) {
+            check("texture binding", mTextures[unit][i], get_integer(kTextureTargetInfo[i].binding));
+        }
+    }
+    glActiveTexture((GLenum)active);
+
+    for (int i = 0; i < kCapabilities; ++i) {
+        int actual = glIsEnabled(kCapabilityEnums[i]) == GL_TRUE ? 1 : 0;
+        if (mCapabilities[i] >= 0 && mCapabilities[i] != actual) {
+            mismatch("capability", mCapabilities[i], actual);
+            mCapabilities[i] = actual;
+        }
+    }
+    check("depth func", mDepthFunc, get_integer(GL_DEPTH_FUNC));
+    int depthMask = get_integer(GL_DEPTH_WRITEMASK) ? 1 : 0;
+    if (mDepthMask >= 0 && mDepthMask != depthMask) {
+        mismatch("depth mask", mDepthMask, depthMask);
+        mDepthMask = depthMask;
+    }
+    check("blend src", mBlendSrc, get_integer(GL_BLEND_SRC_RGB));
+    check("blend dst", mBlendDst, get_integer(GL_BLEND_DST_RGB));
+    if (mViewportKnown) {
+        GLint actual[4];
+        glGetIntegerv(GL_VIEWPORT, actual);
+        for (int i = 0; i < 4; ++i) {
+            if (actual[i] != mViewport[i]) {
+                mismatch("viewport", mViewport[i], actual[i]);
+                mViewport[i] = actual[i];
+            }
+        }
+    }
+    return mStats.mismatches - before;
+}
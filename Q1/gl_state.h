@@ -0,0 +1,114 @@
+#pragma once
+#ifndef GL_STATE_H
+#define GL_STATE_H
+
+#include <stddef.h>
+#include <GL/glew.h>
+
+// GL state calls since the last resetStats(); the viewer resets every frame.
+struct GLStateStats
+{
+    size_t issued = 0;     // calls that reached GL
+    size_t avoided = 0;    // calls skipped because the state already matched
+    size_t mismatches = 0; // debug mode: cached values GL disagreed with
+};
+
+// Shadow copy of the bind points the frame loop touches: program, VAO,
+// buffer bindings (plus indexed uniform buffer ranges), textures per unit,
+// the depth / blend / scissor / cull state and the viewport. A call that
+// would set what is already current is skipped.
+//
+// Every entry starts unknown and stays unknown until it is set through the
+// cache, so the first call always reaches GL. Code that changes state
+// directly must call invalidate() before the cache is used again. The
+// GL_ELEMENT_ARRAY_BUFFER binding belongs to the VAO and is forgotten on
+// every VAO change. Deleting an object unbinds it, and GL may hand its name
+// out again, so objects the cache may have bound are deleted through it.
+//
+// In debug mode each skipped call first reads the real value with glGet*,
+// and verify() compares every known entry; differences are reported, counted
+// and the call is issued, so state changed behind the cache's back shows up.
+class GLStateCache
+{
+public:
+    GLStateCache() { invalidate(); }
+
+    // Forgets everything; the next call of each kind reaches GL.
+    void invalidate();
+    void setDebug(bool debug) { mDebug = debug; }
+    bool debug() const { return mDebug; }
+
+    void useProgram(GLuint program);
+    void bindVertexArray(GLuint vao);
+    void bindBuffer(GLenum target, GLuint buffer);
+    void bindBufferBase(GLenum target, GLuint index, GLuint buffer);
+    void bindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size);
+    void activeTexture(GLenum unit);
+    // Binds to the given unit, switching the active unit only if needed.
+    void bindTexture(GLuint unit, GLenum target, GLuint texture);
+    void setEnabled(GLenum cap, bool enabled);
+    void depthFunc(GLenum func);
+    void depthMask(bool write);
+    void blendFunc(GLenum src, GLenum dst);
+    void viewport(GLint x, GLint y, GLsizei width, GLsizei height);
+
+    // glDelete* that also drop the deleted names from the cache
+    void deleteBuffers(GLsizei count, const GLuint* buffers);
+    void deleteVertexArrays(GLsizei count, const GLuint* arrays);
+    void deleteTextures(GLsizei count, const GLuint* textures);
+
+    // Compares every known entry with glGet*; returns the number of
+    // differences, which are printed and adopted as the new cached values.
+    size_t verify();
+
+    const GLStateStats& stats() const { return mStats; }
+    void resetStats() { mStats = GLStateStats(); }
+
+    static const int kTextureUnits = 16;
+    static const int kIndexedBindings = 16;
+
+private:
+    enum BufferTarget
+    {
+        kArrayBuffer, kElementArrayBuffer, kUniformBuffer, kDrawIndirectBuffer, kCopyReadBuffer,
+        kCopyWriteBuffer, kTextureBuffer, kPixelPackBuffer, kPixelUnpackBuffer, kBufferTargets
+    };
+    enum TextureTarget { kTexture2D, kTexture3D, kTextureCubeMap, kTexture2DArray, kTextureBufferTarget, kTextureTargets };
+    enum Capability { kDepthTest, kBlend, kScissorTest, kCullFace, kCapabilities };
+
+    struct IndexedBinding
+    {
+        GLuint buffer;
+        GLintptr offset;
+        GLsizeiptr size; // 0 = whole buffer (glBindBufferBase)
+        bool known;
+    };
+
+    // Counts the call; true when it has to be issued.
+    bool needed(bool matches, const char* what, GLenum query = 0, GLint cached = 0);
+    bool mismatch(const char* what, GLint cached, GLint actual);
+
+    static const GLuint kUnknown = 0xFFFFFFFFu;
+
+    GLuint mProgram;
+    GLuint mVertexArray;
+    GLuint mBuffers[kBufferTargets];
+    IndexedBinding mUniformBindings[kIndexedBindings];
+    GLuint mActiveTexture;
+    GLuint mTextures[kTextureUnits][kTextureTargets];
+    int mCapabilities[kCapabilities]; // -1 unknown, 0 off, 1 on
+    GLuint mDepthFunc;
+    int mDepthMask;
+    GLuint mBlendSrc, mBlendDst;
+    GLint mViewport[4];
+    bool mViewportKnown;
+
+    bool mDebug = false;
+    GLStateStats mStats;
+};
+
+// The cache of the current context, shared by the frame loop and the
+// modules it calls into.
+GLStateCache& gl_state();
+
+#endif // GL_STATE_H
@@ -0,0 +1,257 @@
+//
+//  gpu_profiler.cpp
+//  Scoped GPU timer and pipeline statistics queries
+//
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include "gl_extensions.h"
+#include "gl_state.h"
+#include "gpu_profiler.h"
+
+namespace {
+
+// Overlay bar colors, cycled by pass
+const float kBarColors[][3] = {
+    { 0.90f, 0.30f, 0.25f },
+    { 0.30f, 0.75f, 0.30f },
+    { 0.30f, 0.50f, 0.95f },
+    { 0.95f, 0.80f, 0.25f },
+    { 0.75f, 0.35f, 0.85f },
+};
+
+const double kSmoothing = 0.1; // weight of the newest frame
+
+} // namespace
+
+GpuProfiler::~GpuProfiler()
+{
+    destroy();
+}
+
+bool GpuProfiler::create(const std::string& csvPath)
+{
+    destroy();
+    mPipelineStatistics = gl_extensions().pipelineStatistics;
+    if (!csvPath.empty()) {
+        mCsv.open(csvPath);
+        if (!mCsv.is_open()) {
+            fprintf(stderr, "Failed to open %s\n", csvPath.c_str());
+            return false;
+        }
+        mCsv << "frame,pass,gpu_ms,vertices,primitives,fragment_invocations\n";
+    }
+    mCreated = true;
+    return true;
+}
+
+void GpuProfiler::destroy()
+{
+    for (Slot& slot : mSlots) {
+        if (!slot.queries.empty()) {
+            glDeleteQueries((GLsizei)slot.queries.size(), slot.queries.data());
+        }
+        slot = Slot();
+    }
+    if (mCsv.is_open()) {
+        mCsv.close();
+    }
+    mPasses.clear();
+    mSlot = 0;
+    mActive = -1;
+    mFrame = 0;
+    mLateFrames = 0;
+    mCreated = false;
+}
+
+int GpuProfiler::passIndex(const char* name)
+{
+    for (size_t i = 0; i < mPasses.size(); ++i) {
+        if (mPasses[i].name == name) return (int)i;
+    }
+    GpuPassStats pass;
+    pass.name = name;
+    mPasses.push_back(pass);
+    return (int)mPasses.size() - 1;
+}
+
+void GpuProfiler::beginFrame()
+{
+    if (!mCreated) return;
+    Slot& slot = mSlots[mSlot];
+    if (slot.pending) collect(slot);
+    slot.issued.clear();
+    slot.frame = mFrame;
+}
+
+void GpuProfiler::begin(const char* name)
+{
+    if (!mCreated || mActive >= 0) return;
+    Slot& slot = mSlots[mSlot];
+    int pass = passIndex(name);
+    size_t entry = slot.issued.size();
+    size_t needed = (entry + 1) * kQueryCount;
+    if (slot.queries.size() < needed) {
+        size_t first = slot.queries.size();
+        slot.queries.resize(needed);
+        glGenQueries((GLsizei)(needed - first), slot.queries.data() + first);
+    }
+    const unsigned int* queries = slot.queries.data() + entry * kQueryCount;
+    glQueryCounter(queries[kBegin], GL_TIMESTAMP);
+    if (mPipelineStatistics) {
+        glBeginQuery(GL_VERTICES_SUBMITTED_ARB, queries[kVertices]);
+        glBeginQuery(GL_PRIMITIVES_SUBMITTED_ARB, queries[kPrimitives]);
+        glBeginQuery(GL_FRAGMENT_SHADER_INVOCATIONS_ARB, queries[kFragments]);
+    }
+    slot.issued.push_back(pass);
+    mActive = (int)entry;
+}
+
+void GpuProfiler::end()
+{
+    if (!mCreated || mActive < 0) return;
+    const unsigned int* queries = mSlots[mSlot].queries.data() + mActive * kQueryCount;
+    if (mPipelineStatistics) {
+        glEndQuery(GL_FRAGMENT_SHADER_INVOCATIONS_ARB);
+        glEndQuery(GL_PRIMITIVES_SUBMITTED_ARB);
+        glEndQuery(GL_VERTICES_SUBMITTED_ARB);
+    }
+    glQueryCounter(queries[kEnd], GL_TIMESTAMP);
+    mActive = -1;
+}
+
+void GpuProfiler::endFrame()
+{
+    if (!mCreated) return;
+    end();
+    mSlots[mSlot].pending = !mSlots[mSlot].issued.empty();
+    mSlot = (mSlot + 1) % kFrames;
+    mFrame++;
+}
+
+void GpuProfiler::flush()
+{
+    // Oldest first, so the CSV stays in frame order.
+    for (int i = 0; i < kFrames; ++i) {
+        Slot& slot = mSlots[(mSlot + i) % kFrames];
+        if (slot.pending) collect(slot);
+    }
+}
+
+void GpuProfiler::collect(Slot& slot)
+{
+    slot.pending = false;
+    if (slot.issued.empty()) return;
+    // The last end timestamp of the frame finishes after all the others.
+    const unsigned int* last = slot.queries.data() + (slot.issued.size() - 1) * kQueryCount;
+    GLint available = 0;
+    glGetQueryObjectiv(last[kEnd], GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available) mLateFrames++;
+
+    // Sum the entries of each pass, in order of their first use.
+    struct Sample
+    {
+        int pass;
+        double ms;
+        GLuint64 vertices, primitives, fragments;
+    };
+    std::vector<Sample> samples;
+    for (size_t entry = 0; entry < slot.issued.size(); ++entry) {
+        const unsigned int* queries = slot.queries.data() + entry * kQueryCount;
+        GLuint64 begin = 0, end = 0, vertices = 0, primitives = 0, fragments = 0;
+        glGetQueryObjectui64v(queries[kBegin], GL_QUERY_RESULT, &begin);
+        glGetQueryObjectui64v(queries[kEnd], GL_QUERY_RESULT, &end);
+        if (mPipelineStatistics) {
+            glGetQueryObjectui64v(queries[kVertices], GL_QUERY_RESULT, &vertices);
+            glGetQueryObjectui64v(queries[kPrimitives], GL_QUERY_RESULT, &primitives);
+            glGetQueryObjectui64v(queries[kFragments], GL_QUERY_RESULT, &fragments);
+        }
+        double ms = end > begin ? (end - begin) * 1e-6 : 0.0;
+        int pass = slot.issued[entry];
+        auto it = std::find_if(samples.begin(), samples.end(), [pass](const Sample& s) { return s.pass == pass; });
+        if (it == samples.end()) {
+            samples.push_back({ pass, ms, vertices, primitives, fragments });
+        }
+        else {
+            it->ms += ms;
+            it->vertices += vertices;
+            it->primitives += primitives;
+            it->fragments += fragments;
+        }
+    }
+
+    for (const Sample& sample : samples) {
+        const double ms = sample.ms;
+        const GLuint64 vertices = sample.vertices, primitives = sample.primitives, fragments = sample.fragments;
+        GpuPassStats& stats = mPasses[sample.pass];
+        stats.smoothedMs = stats.frames == 0 ? ms : stats.smoothedMs + kSmoothing * (ms - stats.smoothedMs);
+        stats.frames++;
+        stats.lastMs = ms;
+        stats.totalMs += ms;
+        stats.maxMs = std::max(stats.maxMs, ms);
+        stats.vertices = vertices;
+        stats.primitives = primitives;
+        stats.fragments = fragments;
+        stats.totalVertices += vertices;
+        stats.totalPrimitives += primitives;
+        stats.totalFragments += fragments;
+        if (mCsv.is_open()) {
+            char line[160];
+            snprintf(line, sizeof(line), "%zu,%s,%.4f,%llu,%llu,%llu\n", slot.frame, stats.name.c_str(), ms,
+                (unsigned long long)vertices, (unsigned long long)primitives, (unsigned long long)fragments);
+            mCsv << line;
+        }
+    }
+}
+
+std::string GpuProfiler::overlayText() const
+{
+    std::string text;
+    char line[96];
+    for (const GpuPassStats& pass : mPasses) {
+        snprintf(line, sizeof(line), "%s%s %.2f ms", text.empty() ? "" : " | ", pass.name.c_str(), pass.smoothedMs);
+        text += line;
+    }
+    return text;
+}
+
+void GpuProfiler::drawOverlay(int framebufferWidth, int framebufferHeight, double budgetMs) const
+{
+    const int margin = 8, barHeight = 6, spacing = 3;
+    const int fullWidth = framebufferWidth - 2 * margin;
+    if (fullWidth <= 0 || budgetMs <= 0.0) return;
+
+    GLfloat clearColor[4];
+    glGetFloatv(GL_COLOR_CLEAR_VALUE, clearColor);
+    gl_state().setEnabled(GL_SCISSOR_TEST, true);
+    for (size_t i = 0; i < mPasses.size(); ++i) {
+        int y = framebufferHeight - margin - (int)(i + 1) * (barHeight + spacing);
+        if (y < 0) break;
+        // Dark track for the whole budget, then the pass on top of it.
+        glScissor(margin, y, fullWidth, barHeight);
+        glClearColor(0.15f, 0.15f, 0.15f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT);
+        int width = std::min(fullWidth, std::max(1, (int)(mPasses[i].smoothedMs / budgetMs * fullWidth + 0.5)));
+        const float* color = kBarColors[i % (sizeof(kBarColors) / sizeof(kBarColors[0]))];
+        glScissor(margin, y, width, barHeight);
+        glClearColor(color[0], color[1], color[2], 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT);
+    }
+    gl_state().setEnabled(GL_SCISSOR_TEST, false);
+    glClearColor(clearColor[0], clearColor[1], clearColor[2], clearColor[3]);
+}
+
+void GpuProfiler::print() const
+{
+    printf("GPU passes (%zu late frames%s):\n", mLateFrames,
+        mPipelineStatistics ? "" : ", no ARB_pipeline_statistics_query");
+    printf("  %-10s %7s %9s %9s %12s %12s %14s\n", "pass", "frames", "avg ms", "max ms", "vertices", "primitives",
+        "fragments");
+    for (const GpuPassStats& pass : mPasses) {
+        if (pass.frames == 0) continue;
+        printf("  %-10s %7zu %9.3f %9.3f %12.0f %12.0f %14.0f\n", pass.name.c_str(), pass.frames,
+            pass.totalMs / pass.frames, pass.maxMs, (double)pass.totalVertices / pass.frames,
+            (double)pass.totalPrimitives / pass.frames, (double)pass.totalFragments / pass.frames);
+    }
+}
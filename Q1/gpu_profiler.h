@@ -0,0 +1,119 @@
+#pragma once
+#ifndef GPU_PROFILER_H
+#define GPU_PROFILER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// Results of one named pass, accumulated over the collected frames
+struct GpuPassStats
+{
+    std::string name;
+    size_t frames = 0;
+    double lastMs = 0.0;
+    double smoothedMs = 0.0; // exponential average for the overlay
+    double totalMs = 0.0;
+    double maxMs = 0.0;
+    // ARB_pipeline_statistics_query counters of the last frame and totals
+    uint64_t vertices = 0;
+    uint64_t primitives = 0;
+    uint64_t fragments = 0;
+    uint64_t totalVertices = 0;
+    uint64_t totalPrimitives = 0;
+    uint64_t totalFragments = 0;
+};
+
+// Per-pass GPU time from a GL_TIMESTAMP pair around each pass, plus the
+// vertex / primitive / fragment shader counters of ARB_pipeline_statistics_query
+// when the driver has it. Passes are flat (begin / end do not nest) and
+// keep their order of first use. A pass timed more than once in a frame
+// gets queries for every use, and the uses add up to one sample.
+//
+// Queries live in kFrames slots; a frame's results are read when its slot
+// comes around again, kFrames - 1 frames later, by which time the GPU has
+// normally finished them. Slots that are still not ready count as late and
+// are read anyway.
+class GpuProfiler
+{
+public:
+    static const int kFrames = 3;
+
+    GpuProfiler() = default;
+    ~GpuProfiler();
+    GpuProfiler(const GpuProfiler&) = delete;
+    GpuProfiler& operator=(const GpuProfiler&) = delete;
+
+    // Needs a current context and load_gl_extensions(). With a csvPath,
+    // every collected pass becomes a line of that file.
+    bool create(const std::string& csvPath = std::string());
+    void destroy();
+    bool pipelineStatistics() const { return mPipelineStatistics; }
+
+    void beginFrame();
+    void begin(const char* name);
+    void end();
+    void endFrame();
+
+    // Reads the frames still in flight (blocking); call before the report.
+    void flush();
+
+    const std::vector<GpuPassStats>& passes() const { return mPasses; }
+    size_t lateFrames() const { return mLateFrames; }
+
+    // One line per pass with its smoothed time, for the window title
+    std::string overlayText() const;
+    // Horizontal bars of the smoothed pass times in the top left corner of
+    // the framebuffer, full width = budgetMs. Drawn with scissored clears,
+    // so no shader or font is needed.
+    void drawOverlay(int framebufferWidth, int framebufferHeight, double budgetMs = 1000.0 / 60.0) const;
+    // Table of averages over all collected frames
+    void print() const;
+
+private:
+    enum { kBegin, kEnd, kVertices, kPrimitives, kFragments, kQueryCount };
+
+    struct Slot
+    {
+        std::vector<unsigned int> queries; // kQueryCount per issued entry
+        std::vector<int> issued;           // pass of each begin() in this frame, in order
+        size_t frame = 0;
+        bool pending = false;
+    };
+
+    int passIndex(const char* name);
+    void collect(Slot& slot);
+
+    std::vector<GpuPassStats> mPasses;
+    Slot mSlots[kFrames];
+    int mSlot = 0;
+    int mActive = -1; // issued entry between begin() and end()
+    size_t mFrame = 0;
+    size_t mLateFrames = 0;
+    bool mCreated = false;
+    bool mPipelineStatistics = false;
+    std::ofstream mCsv;
+};
+
+// Times its enclosing block as one pass of the profiler (may be null).
+class GpuScope
+{
+public:
+    GpuScope(GpuProfiler* profiler, const char* name) : mProfiler(profiler)
+    {
+        if (mProfiler != nullptr) mProfiler->begin(name);
+    }
+    ~GpuScope()
+    {
+        if (mProfiler != nullptr) mProfiler->end();
+    }
+    GpuScope(const GpuScope&) = delete;
+    GpuScope& operator=(const GpuScope&) = delete;
+
+private:
+    GpuProfiler* mProfiler;
+};
+
+#endif // GPU_PROFILER_H
@@ -0,0 +1,267 @@
+//
+//  headless_context.cpp
+//  Windowless GL context and framebuffer for --headless
+//
+
+#include <stdio.h>
+#include <string.h>
+#include "headless_context.h"
+#include "gl_state.h"
+#include "ring_buffer.h"
+#include <GLFW/glfw3.h>
+
+#ifdef __linux__
+// Keep Xlib out of eglplatform.h; only the display-less platforms are used.
+#define EGL_NO_X11
+#define MESA_EGL_NO_X11_HEADERS
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+namespace {
+
+#ifdef __linux__
+
+// True if the space separated list contains the name (lists may be null).
+bool has_extension(const char* list, const char* name)
+{
+    if (list == nullptr) return false;
+    const size_t length = strlen(name);
+    for (const char* p = strstr(list, name); p != nullptr; p = strstr(p + length, name)) {
+        if ((p == list || p[-1] == ' ') && (p[length] == ' ' || p[length] == '\0')) return true;
+    }
+    return false;
+}
+
+bool initialize(EGLDisplay display)
+{
+    EGLint major = 0, minor = 0;
+    return display != EGL_NO_DISPLAY && eglInitialize(display, &major, &minor);
+}
+
+// The first display that initializes, most headless-friendly first
+EGLDisplay open_display(const char*& backend)
+{
+    const char* clientExtensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+    PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+        (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+    if (getPlatformDisplay != nullptr && has_extension(clientExtensions, "EGL_MESA_platform_surfaceless")) {
+        EGLDisplay display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+        if (initialize(display)) {
+            backend = "EGL surfaceless";
+            return display;
+        }
+    }
+    PFNEGLQUERYDEVICESEXTPROC queryDevices = (PFNEGLQUERYDEVICESEXTPROC)eglGetProcAddress("eglQueryDevicesEXT");
+    if (getPlatformDisplay != nullptr && queryDevices != nullptr &&
+        has_extension(clientExtensions, "EGL_EXT_platform_device")) {
+        EGLDeviceEXT devices[8];
+        EGLint count = 0;
+        if (queryDevices(8, devices, &count)) {
+            for (EGLint i = 0; i < count; ++i) {
+                EGLDisplay display = getPlatformDisplay(EGL_PLATFORM_DEVICE_EXT, devices[i], nullptr);
+                if (initialize(display)) {
+                    backend = "EGL device";
+                    return display;
+                }
+            }
+        }
+    }
+    EGLDisplay display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    if (initialize(display)) {
+        backend = "EGL default display";
+        return display;
+    }
+    return EGL_NO_DISPLAY;
+}
+
+GLProc egl_proc_address(const char* name)
+{
+    return (GLProc)eglGetProcAddress(name);
+}
+
+#endif // __linux__
+
+} // namespace
+
+bool HeadlessContext::create(int width, int height, int major, int minor)
+{
+    destroy();
+    if (!createContext(major, minor)) return false;
+
+    glewExperimental = GL_TRUE;
+    GLenum status = glewInit();
+#ifdef GLEW_ERROR_NO_GLX_DISPLAY
+    // GLEW built for GLX finds no X display behind an EGL context; the GL
+    // entry points are loaded all the same.
+    if (status == GLEW_ERROR_NO_GLX_DISPLAY) status = GLEW_OK;
+#endif
+    if (status != GLEW_OK) {
+        fprintf(stderr, "Failed to initialize GLEW\n");
+        return false;
+    }
+#ifdef __linux__
+    load_gl_extensions(egl_proc_address);
+#else
+    load_gl_extensions();
+#endif
+    // The state cache describes the previous context, if any.
+    gl_state().invalidate();
+    return createFramebuffer(width, height);
+}
+
+#ifdef __linux__
+
+bool HeadlessContext::createContext(int major, int minor)
+{
+    EGLDisplay display = open_display(mBackend);
+    if (display == EGL_NO_DISPLAY) {
+        fprintf(stderr, "No EGL display (surfaceless, device or default)\n");
+        return false;
+    }
+    mDisplay = display;
+    if (!has_extension(eglQueryString(display, EGL_EXTENSIONS), "EGL_KHR_surfaceless_context")) {
+        fprintf(stderr, "%s has no EGL_KHR_surfaceless_context\n", mBackend);
+        return false;
+    }
+    EGLConfig config = EGL_NO_CONFIG_KHR;
+    if (!has_extension(eglQueryString(display, EGL_EXTENSIONS), "EGL_KHR_no_config_context")) {
+        const EGLint configAttributes[] = { EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE };
+        EGLint count = 0;
+        if (!eglChooseConfig(display, configAttributes, &config, 1, &count) || count == 0) {
+            fprintf(stderr, "No EGL config for desktop GL\n");
+            return false;
+        }
+    }
+    if (!eglBindAPI(EGL_OPENGL_API)) {
+        fprintf(stderr, "EGL has no desktop GL\n");
+        return false;
+    }
+    const EGLint contextAttributes[] = {
+        EGL_CONTEXT_MAJOR_VERSION_KHR, major,
+        EGL_CONTEXT_MINOR_VERSION_KHR, minor,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK_KHR, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT_KHR,
+        EGL_NONE
+    };
+    EGLContext context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttributes);
+    if (context == EGL_NO_CONTEXT) {
+        fprintf(stderr, "Failed to create a GL %d.%d core context (EGL error 0x%x)\n", major, minor,
+            (unsigned int)eglGetError());
+        return false;
+    }
+    mContext = context;
+    if (!eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)) {
+        fprintf(stderr, "eglMakeCurrent failed (EGL error 0x%x)\n", (unsigned int)eglGetError());
+        return false;
+    }
+    return true;
+}
+
+#else
+
+bool HeadlessContext::createContext(int major, int minor)
+{
+    if (!glfwInit()) {
+        fprintf(stderr, "Failed to initialize GLFW\n");
+        return false;
+    }
+    mGlfwInitialized = true;
+    glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, major);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, minor);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+#ifdef __APPLE__
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+#endif
+    // The window only carries the context; drawing goes to the framebuffer.
+    mWindow = glfwCreateWindow(64, 64, "headless", NULL, NULL);
+    if (mWindow == NULL) {
+        fprintf(stderr, "Failed to create GL context\n");
+        return false;
+    }
+    glfwMakeContextCurrent(mWindow);
+    mBackend = "GLFW hidden window";
+    return true;
+}
+
+#endif // __linux__
+
+bool HeadlessContext::createFramebuffer(int width, int height)
+{
+    GLint maxSize = 0;
+    glGetIntegerv(GL_MAX_RENDERBUFFER_SIZE, &maxSize);
+    if (width <= 0 || height <= 0 || width > maxSize || height > maxSize) {
+        fprintf(stderr, "Framebuffer size %dx%d outside 1..%d\n", width, height, maxSize);
+        return false;
+    }
+    glGenFramebuffers(1, &mFramebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, mFramebuffer);
+    glGenRenderbuffers(2, mRenderbuffers);
+    glBindRenderbuffer(GL_RENDERBUFFER, mRenderbuffers[0]);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, mRenderbuffers[0]);
+    glBindRenderbuffer(GL_RENDERBUFFER, mRenderbuffers[1]);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, mRenderbuffers[1]);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        fprintf(stderr, "Headless framebuffer is incomplete\n");
+        return false;
+    }
+    gl_state().viewport(0, 0, width, height);
+    mWidth = width;
+    mHeight = height;
+    return true;
+}
+
+void HeadlessContext::destroy()
+{
+    if (mFramebuffer != 0) {
+        finish();
+        glDeleteFramebuffers(1, &mFramebuffer);
+        glDeleteRenderbuffers(2, mRenderbuffers);
+        mFramebuffer = 0;
+    }
+#ifdef __linux__
+    if (mDisplay != nullptr) {
+        eglMakeCurrent(mDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        if (mContext != nullptr) eglDestroyContext(mDisplay, mContext);
+        eglTerminate(mDisplay);
+    }
+#endif
+    mDisplay = nullptr;
+    mContext = nullptr;
+    if (mWindow != NULL) glfwDestroyWindow(mWindow);
+    mWindow = NULL;
+    if (mGlfwInitialized) glfwTerminate();
+    mGlfwInitialized = false;
+    mBackend = "none";
+}
+
+void HeadlessContext::present()
+{
+    GLsync& fence = mFences[mFrame];
+    if (fence != nullptr) {
+        wait_fence(fence);
+    }
+    fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    glFlush();
+    mFrame = (mFrame + 1) % kFramesInFlight;
+}
+
+void HeadlessContext::finish()
+{
+    glFinish();
+    for (GLsync& fence : mFences) {
+        if (fence != nullptr) glDeleteSync(fence);
+        fence = nullptr;
+    }
+    mFrame = 0;
+}
+
+std::vector<unsigned char> HeadlessContext::readPixels() const
+{
+    std::vector<unsigned char> pixels((size_t)mWidth * mHeight * 4);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, mFramebuffer);
+    glReadPixels(0, 0, mWidth, mHeight, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+    return pixels;
+}
@@ -0,0 +1,66 @@
+#pragma once
+#ifndef HEADLESS_CONTEXT_H
+#define HEADLESS_CONTEXT_H
+
+#include <stddef.h>
+#include <vector>
+#include "gl_extensions.h"
+
+struct GLFWwindow;
+
+// GL core context with no window, drawing into its own color / depth
+// framebuffer object of any size (--headless).
+//
+// On Linux the context comes from EGL without a display server: Mesa's
+// surfaceless platform first (llvmpipe on machines without a GPU, or the
+// render node of one), then an EGL device (the NVIDIA driver), then the
+// default display. Elsewhere it belongs to a hidden GLFW window.
+//
+// create() also initializes GLEW and load_gl_extensions(), and leaves the
+// framebuffer bound with the viewport covering it.
+class HeadlessContext
+{
+public:
+    static const int kFramesInFlight = 2;
+
+    HeadlessContext() = default;
+    ~HeadlessContext() { destroy(); }
+    HeadlessContext(const HeadlessContext&) = delete;
+    HeadlessContext& operator=(const HeadlessContext&) = delete;
+
+    bool create(int width, int height, int major = 3, int minor = 3);
+    void destroy();
+
+    // "EGL surfaceless", "EGL device", "EGL default display" or "GLFW hidden window"
+    const char* backend() const { return mBackend; }
+    int width() const { return mWidth; }
+    int height() const { return mHeight; }
+    unsigned int framebuffer() const { return mFramebuffer; }
+
+    // Stands in for the swap: fences the frame and waits for the one
+    // kFramesInFlight back, so the CPU runs ahead of the GPU no further
+    // than it would with a swap chain.
+    void present();
+    // Waits until every frame presented so far has finished.
+    void finish();
+    // RGBA8 rows of the framebuffer, bottom row first
+    std::vector<unsigned char> readPixels() const;
+
+private:
+    bool createContext(int major, int minor);
+    bool createFramebuffer(int width, int height);
+
+    const char* mBackend = "none";
+    void* mDisplay = nullptr; // EGLDisplay
+    void* mContext = nullptr; // EGLContext
+    GLFWwindow* mWindow = nullptr;
+    bool mGlfwInitialized = false;
+    unsigned int mFramebuffer = 0;
+    unsigned int mRenderbuffers[2] = {};
+    int mWidth = 0;
+    int mHeight = 0;
+    GLsync mFences[kFramesInFlight] = {};
+    int mFrame = 0;
+};
+
+#endif // HEADLESS_CONTEXT_H
@@ -0,0 +1,397 @@
+//
+//  image_encode.cpp
+//  PPM, PNG and OpenEXR writers for captured frames
+//
+
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <algorithm>
+#include <fstream>
+#include <GL/glew.h>
+#include "image_encode.h"
+
+namespace {
+
+void put_u32_be(std::vector<unsigned char>& out, uint32_t v)
+{
+    out.push_back((unsigned char)(v >> 24));
+    out.push_back((unsigned char)(v >> 16));
+    out.push_back((unsigned char)(v >> 8));
+    out.push_back((unsigned char)v);
+}
+
+void put_u32_le(std::vector<unsigned char>& out, uint32_t v)
+{
+    out.push_back((unsigned char)v);
+    out.push_back((unsigned char)(v >> 8));
+    out.push_back((unsigned char)(v >> 16));
+    out.push_back((unsigned char)(v >> 24));
+}
+
+void put_u64_le(std::vector<unsigned char>& out, uint64_t v)
+{
+    put_u32_le(out, (uint32_t)v);
+    put_u32_le(out, (uint32_t)(v >> 32));
+}
+
+void put_string(std::vector<unsigned char>& out, const char* text)
+{
+    out.insert(out.end(), text, text + strlen(text) + 1); // with the terminator
+}
+
+// --- PNG ---
+
+struct CrcTable
+{
+    uint32_t entries[256];
+
+    CrcTable()
+    {
+        for (uint32_t n = 0; n < 256; ++n) {
+            uint32_t c = n;
+            for (int k = 0; k < 8; ++k) c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            entries[n] = c;
+        }
+    }
+};
+
+uint32_t crc32(const unsigned char* data, size_t size)
+{
+    static const CrcTable table; // encoder threads share it
+    uint32_t crc = 0xFFFFFFFFu;
+    for (size_t i = 0; i < size; ++i) crc = table.entries[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+uint32_t adler32(const unsigned char* data, size_t size)
+{
+    uint32_t a = 1, b = 0;
+    while (size > 0) {
+        size_t block = std::min(size, (size_t)5552); // no overflow before the modulo
+        for (size_t i = 0; i < block; ++i) {
+            a += data[i];
+            b += a;
+        }
+        a %= 65521;
+        b %= 65521;
+        data += block;
+        size -= block;
+    }
+    return b << 16 | a;
+}
+
+// Deflate bit stream: values LSB first, Huffman codes MSB first.
+class BitWriter
+{
+public:
+    explicit BitWriter(std::vector<unsigned char>& out) : mOut(out) {}
+
+    void bits(uint32_t value, int count)
+    {
+        mBuffer |= (uint64_t)value << mCount;
+        mCount += count;
+        while (mCount >= 8) {
+            mOut.push_back((unsigned char)mBuffer);
+            mBuffer >>= 8;
+            mCount -= 8;
+        }
+    }
+    void code(uint32_t code, int length)
+    {
+        uint32_t reversed = 0;
+        for (int i = 0; i < length; ++i) reversed |= ((code >> i) & 1) << (length - 1 - i);
+        bits(reversed, length);
+    }
+    void flush()
+    {
+        if (mCount > 0) mOut.push_back((unsigned char)mBuffer);
+        mBuffer = 0;
+        mCount = 0;
+    }
+
+private:
+    std::vector<unsigned char>& mOut;
+    uint64_t mBuffer = 0;
+    int mCount = 0;
+};
+
+const int kLengthBase[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99,
+    115, 131, 163, 195, 227, 258 };
+const int kLengthExtra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+const int kDistanceBase[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025,
+    1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+const int kDistanceExtra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12,
+    12, 13, 13 };
+
+// Fixed literal / length code of symbol 0..287 (RFC 1951, 3.2.6)
+void put_symbol(BitWriter& writer, int symbol)
+{
+    if (symbol < 144) writer.code(0x30 + symbol, 8);
+    else if (symbol < 256) writer.code(0x190 + symbol - 144, 9);
+    else if (symbol < 280) writer.code(symbol - 256, 7);
+    else writer.code(0xC0 + symbol - 280, 8);
+}
+
+void put_match(BitWriter& writer, int length, int distance)
+{
+    int l = 28;
+    while (kLengthBase[l] > length) --l;
+    put_symbol(writer, 257 + l);
+    writer.bits(length - kLengthBase[l], kLengthExtra[l]);
+    int d = 29;
+    while (kDistanceBase[d] > distance) --d;
+    writer.code(d, 5);
+    writer.bits(distance - kDistanceBase[d], kDistanceExtra[d]);
+}
+
+// zlib stream of one fixed-Huffman deflate block
+void zlib_compress(const unsigned char* data, size_t size, std::vector<unsigned char>& out)
+{
+    const int kWindow = 32768;
+    const int kMaxMatch = 258;
+    const int kHashBits = 15;
+    out.push_back(0x78); // deflate, 32 KB window
+    out.push_back(0x01); // fastest
+    BitWriter writer(out);
+    writer.bits(1, 1); // final block
+    writer.bits(1, 2); // fixed codes
+
+    std::vector<int64_t> head((size_t)1 << kHashBits, -kWindow - 1);
+    size_t i = 0;
+    while (i < size) {
+        int length = 0;
+        size_t distance = 0;
+        if (i + 3 <= size) {
+            uint32_t h = ((uint32_t)data[i] << 16 | (uint32_t)data[i + 1] << 8 | data[i + 2]) * 2654435761u >>
+                (32 - kHashBits);
+            int64_t candidate = head[h];
+            head[h] = (int64_t)i;
+            distance = i - (size_t)candidate;
+            if (candidate >= 0 && distance <= (size_t)kWindow) {
+                size_t limit = std::min(size - i, (size_t)kMaxMatch);
+                const unsigned char* a = data + candidate;
+                const unsigned char* b = data + i;
+                while ((size_t)length < limit && a[length] == b[length]) ++length;
+            }
+        }
+        if (length >= 3) {
+            put_match(writer, length, (int)distance);
+            i += length;
+        }
+        else {
+            put_symbol(writer, data[i]);
+            ++i;
+        }
+    }
+    put_symbol(writer, 256); // end of block
+    writer.flush();
+    put_u32_be(out, adler32(data, size));
+}
+
+void put_chunk(std::vector<unsigned char>& out, const char type[4], const unsigned char* data, size_t size)
+{
+    put_u32_be(out, (uint32_t)size);
+    size_t start = out.size();
+    out.insert(out.end(), type, type + 4);
+    if (size > 0) out.insert(out.end(), data, data + size);
+    put_u32_be(out, crc32(&out[start], out.size() - start));
+}
+
+// --- OpenEXR ---
+
+void put_attribute(std::vector<unsigned char>& out, const char* name, const char* type,
+    const std::vector<unsigned char>& value)
+{
+    put_string(out, name);
+    put_string(out, type);
+    put_u32_le(out, (uint32_t)value.size());
+    out.insert(out.end(), value.begin(), value.end());
+}
+
+std::vector<unsigned char> box2i(int width, int height)
+{
+    std::vector<unsigned char> box;
+    put_u32_le(box, 0);
+    put_u32_le(box, 0);
+    put_u32_le(box, (uint32_t)(width - 1));
+    put_u32_le(box, (uint32_t)(height - 1));
+    return box;
+}
+
+std::vector<unsigned char> float_bytes(float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    std::vector<unsigned char> bytes;
+    put_u32_le(bytes, bits);
+    return bytes;
+}
+
+} // namespace
+
+bool image_format_from_path(const std::string& path, ImageFormat& format)
+{
+    size_t dot = path.find_last_of('.');
+    if (dot == std::string::npos) return false;
+    std::string extension = path.substr(dot + 1);
+    for (char& c : extension) c = (char)tolower((unsigned char)c);
+    if (extension == "ppm") format = ImageFormat::Ppm;
+    else if (extension == "png") format = ImageFormat::Png;
+    else if (extension == "exr") format = ImageFormat::Exr;
+    else return false;
+    return true;
+}
+
+const char* image_format_name(ImageFormat format)
+{
+    switch (format) {
+    case ImageFormat::Ppm: return "ppm";
+    case ImageFormat::Png: return "png";
+    case ImageFormat::Exr: return "exr";
+    }
+    return "?";
+}
+
+unsigned int image_pixel_type(ImageFormat format)
+{
+    return format == ImageFormat::Exr ? GL_HALF_FLOAT : GL_UNSIGNED_BYTE;
+}
+
+size_t image_bytes_per_pixel(ImageFormat format)
+{
+    return format == ImageFormat::Exr ? 8 : 4;
+}
+
+void encode_image(ImageFormat format, const void* pixels, int width, int height, std::vector<unsigned char>& out)
+{
+    switch (format) {
+    case ImageFormat::Ppm: encode_ppm((const uint8_t*)pixels, width, height, out); break;
+    case ImageFormat::Png: encode_png((const uint8_t*)pixels, width, height, out); break;
+    case ImageFormat::Exr: encode_exr((const uint16_t*)pixels, width, height, out); break;
+    }
+}
+
+void encode_ppm(const uint8_t* rgba, int width, int height, std::vector<unsigned char>& out)
+{
+    char header[64];
+    int headerSize = snprintf(header, sizeof(header), "P6\n%d %d\n255\n", width, height);
+    out.resize((size_t)headerSize + (size_t)width * height * 3);
+    memcpy(out.data(), header, headerSize);
+    unsigned char* dst = out.data() + headerSize;
+    for (int y = height - 1; y >= 0; --y) {
+        const uint8_t* src = rgba + (size_t)y * width * 4;
+        for (int x = 0; x < width; ++x, src += 4, dst += 3) {
+            dst[0] = src[0];
+            dst[1] = src[1];
+            dst[2] = src[2];
+        }
+    }
+}
+
+void encode_png(const uint8_t* rgba, int width, int height, std::vector<unsigned char>& out)
+{
+    // Filter type 1 (Sub) on every row: each byte minus the one of the
+    // pixel to its left, which turns flat color runs into zeros.
+    const size_t rowBytes = (size_t)width * 3;
+    std::vector<unsigned char> filtered((rowBytes + 1) * height);
+    unsigned char* dst = filtered.data();
+    for (int y = height - 1; y >= 0; --y) {
+        const uint8_t* src = rgba + (size_t)y * width * 4;
+        *dst++ = 1;
+        uint8_t left[3] = { 0, 0, 0 };
+        for (int x = 0; x < width; ++x, src += 4, dst += 3) {
+            for (int c = 0; c < 3; ++c) {
+                dst[c] = (unsigned char)(src[c] - left[c]);
+                left[c] = src[c];
+            }
+        }
+    }
+
+    out.clear();
+    static const unsigned char kSignature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    out.insert(out.end(), kSignature, kSignature + 8);
+    std::vector<unsigned char> header;
+    put_u32_be(header, (uint32_t)width);
+    put_u32_be(header, (uint32_t)height);
+    header.push_back(8); // bits per channel
+    header.push_back(2); // RGB
+    header.push_back(0); // deflate
+    header.push_back(0); // adaptive filtering
+    header.push_back(0); // no interlace
+    put_chunk(out, "IHDR", header.data(), header.size());
+    std::vector<unsigned char> compressed;
+    compressed.reserve(filtered.size() / 4);
+    zlib_compress(filtered.data(), filtered.size(), compressed);
+    put_chunk(out, "IDAT", compressed.data(), compressed.size());
+    put_chunk(out, "IEND", nullptr, 0);
+}
+
+void encode_exr(const uint16_t* rgbaHalf, int width, int height, std::vector<unsigned char>& out)
+{
+    out.clear();
+    put_u32_le(out, 20000630); // magic
+    put_u32_le(out, 2);        // version 2, single-part scanline
+
+    // Channels in alphabetical order, as the line data stores them
+    std::vector<unsigned char> channels;
+    const char* names[3] = { "B", "G", "R" };
+    for (const char* name : names) {
+        put_string(channels, name);
+        put_u32_le(channels, 1); // HALF
+        put_u32_le(channels, 0); // pLinear + reserved
+        put_u32_le(channels, 1); // xSampling
+        put_u32_le(channels, 1); // ySampling
+    }
+    channels.push_back(0);
+    put_attribute(out, "channels", "chlist", channels);
+    put_attribute(out, "compression", "compression", std::vector<unsigned char>(1, 0));
+    put_attribute(out, "dataWindow", "box2i", box2i(width, height));
+    put_attribute(out, "displayWindow", "box2i", box2i(width, height));
+    put_attribute(out, "lineOrder", "lineOrder", std::vector<unsigned char>(1, 0)); // increasing y
+    put_attribute(out, "pixelAspectRatio", "float", float_bytes(1.0f));
+    std::vector<unsigned char> center = float_bytes(0.0f);
+    center.insert(center.end(), center.begin(), center.end());
+    put_attribute(out, "screenWindowCenter", "v2f", center);
+    put_attribute(out, "screenWindowWidth", "float", float_bytes(1.0f));
+    out.push_back(0); // end of header
+
+    // Uncompressed files store one line per chunk: y, size, then B, G and
+    // R of the whole line.
+    const size_t lineBytes = (size_t)width * 3 * 2;
+    const size_t chunkBytes = 8 + lineBytes;
+    size_t offset = out.size() + (size_t)height * 8;
+    for (int y = 0; y < height; ++y, offset += chunkBytes) put_u64_le(out, offset);
+
+    size_t start = out.size();
+    out.resize(start + (size_t)height * chunkBytes);
+    unsigned char* dst = out.data() + start;
+    for (int y = 0; y < height; ++y) {
+        const uint16_t* row = rgbaHalf + (size_t)(height - 1 - y) * width * 4;
+        uint32_t header[2] = { (uint32_t)y, (uint32_t)lineBytes };
+        memcpy(dst, header, 8); // host order, like the halves: little-endian only
+        uint16_t* line = (uint16_t*)(dst + 8);
+        for (int x = 0; x < width; ++x) {
+            line[x] = row[x * 4 + 2];
+            line[width + x] = row[x * 4 + 1];
+            line[2 * width + x] = row[x * 4];
+        }
+        dst += chunkBytes;
+    }
+}
+
+bool write_file(const std::string& path, const std::vector<unsigned char>& bytes)
+{
+    std::ofstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        fprintf(stderr, "Failed to open %s for writing\n", path.c_str());
+        return false;
+    }
+    file.write(reinterpret_cast<const char*>(bytes.data()), (std::streamsize)bytes.size());
+    file.close();
+    if (file.fail()) {
+        fprintf(stderr, "Failed to write %s\n", path.c_str());
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,41 @@
+#pragma once
+#ifndef IMAGE_ENCODE_H
+#define IMAGE_ENCODE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// File formats of captured frames
+enum class ImageFormat
+{
+    Ppm, // binary P6, 8-bit RGB
+    Png, // 8-bit RGB, deflate with fixed Huffman codes
+    Exr, // OpenEXR scanlines, half-float RGB, uncompressed
+};
+
+// The format from a file name's extension (.ppm, .png, .exr, any case).
+// Returns false for anything else.
+bool image_format_from_path(const std::string& path, ImageFormat& format);
+const char* image_format_name(ImageFormat format);
+
+// Pixels the encoder expects, as read back with glReadPixels: GL_RGBA rows
+// bottom first, GL_UNSIGNED_BYTE for PPM / PNG and GL_HALF_FLOAT for EXR.
+unsigned int image_pixel_type(ImageFormat format);
+size_t image_bytes_per_pixel(ImageFormat format);
+
+// Encodes width x height pixels of the layout above into out (replacing its
+// contents); the image is flipped so the top row comes first in the file.
+void encode_image(ImageFormat format, const void* pixels, int width, int height, std::vector<unsigned char>& out);
+
+void encode_ppm(const uint8_t* rgba, int width, int height, std::vector<unsigned char>& out);
+// Sub-filtered rows, greedy LZ77 over a 32 KB window with one hash probe
+// per step and fixed Huffman codes: built for speed over size.
+void encode_png(const uint8_t* rgba, int width, int height, std::vector<unsigned char>& out);
+void encode_exr(const uint16_t* rgbaHalf, int width, int height, std::vector<unsigned char>& out);
+
+// Writes the bytes to path; returns false (after printing why) on failure.
+bool write_file(const std::string& path, const std::vector<unsigned char>& bytes);
+
+#endif // IMAGE_ENCODE_H
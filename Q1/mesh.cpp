@@ -0,0 +1,96 @@
+//
+//  mesh.cpp
+//  Single-allocation storage for indexed triangle meshes
+//
+
+#include <stdlib.h>
+#include <utility>
+#include "mesh.h"
+
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+namespace {
+
+size_t align_up(size_t n, size_t alignment)
+{
+    return (n + alignment - 1) / alignment * alignment;
+}
+
+void* aligned_allocate(size_t bytes, size_t alignment)
+{
+#ifdef _WIN32
+    return _aligned_malloc(bytes, alignment);
+#else
+    void* p = nullptr;
+    return posix_memalign(&p, alignment, bytes) == 0 ? p : nullptr;
+#endif
+}
+
+void aligned_free(void* p)
+{
+#ifdef _WIN32
+    _aligned_free(p);
+#else
+    free(p);
+#endif
+}
+
+} // namespace
+
+Mesh::Mesh(size_t numVertices, size_t numIndices)
+{
+    // [ vertices | padding | indices ], both arrays start on kAlignment.
+    size_t indexOffset = align_up(numVertices * sizeof(glm::vec3), kAlignment);
+    size_t bytes = indexOffset + align_up(numIndices * sizeof(int), kAlignment);
+    if (bytes == 0) return;
+
+    mArena = aligned_allocate(bytes, kAlignment);
+    if (!mArena) return;
+
+    mVertices = static_cast<glm::vec3*>(mArena);
+    mIndices = reinterpret_cast<int*>(static_cast<char*>(mArena) + indexOffset);
+    mVertexCount = numVertices;
+    mIndexCount = numIndices;
+}
+
+Mesh::~Mesh()
+{
+    release();
+}
+
+Mesh::Mesh(Mesh&& other) noexcept
+    : mArena(other.mArena), mVertices(other.mVertices), mIndices(other.mIndices),
+      mVertexCount(other.mVertexCount), mIndexCount(other.mIndexCount)
+{
+    other.mArena = nullptr;
+    other.mVertices = nullptr;
+    other.mIndices = nullptr;
+    other.mVertexCount = 0;
+    other.mIndexCount = 0;
+}
+
+Mesh& Mesh::operator=(Mesh&& other) noexcept
+{
+    if (this != &other) {
+        release();
+        std::swap(mArena, other.mArena);
+        std::swap(mVertices, other.mVertices);
+        std::swap(mIndices, other.mIndices);
+        std::swap(mVertexCount, other.mVertexCount);
+        std::swap(mIndexCount, other.mIndexCount);
+    }
+    return *this;
+}
+
+void Mesh::release()
+{
+    // glm::vec3 and int are trivially destructible; only the arena is freed.
+    if (mArena) aligned_free(mArena);
+    mArena = nullptr;
+    mVertices = nullptr;
+    mIndices = nullptr;
+    mVertexCount = 0;
+    mIndexCount = 0;
+}
@@ -0,0 +1,66 @@
+#pragma once
+#ifndef MESH_H
+#define MESH_H
+
+#include <stddef.h>
+#include <glm/vec3.hpp>
+
+// Non-owning view of a contiguous array. size_bytes() and data() can be
+// passed straight to glBufferData().
+template <typename T>
+struct Span
+{
+    T* ptr = nullptr;
+    size_t count = 0;
+
+    Span() = default;
+    Span(T* p, size_t n) : ptr(p), count(n) {}
+
+    T* data() const { return ptr; }
+    size_t size() const { return count; }
+    size_t size_bytes() const { return count * sizeof(T); }
+    bool empty() const { return count == 0; }
+    T* begin() const { return ptr; }
+    T* end() const { return ptr + count; }
+    T& operator[](size_t i) const { return ptr[i]; }
+};
+
+// Indexed triangle mesh. Vertices (positions, which double as normals for
+// the unit sphere) and indices live in one aligned allocation owned by the
+// mesh, so a mesh can be moved around but never copied implicitly.
+class Mesh
+{
+public:
+    static const size_t kAlignment = 64;
+
+    Mesh() = default;
+    // Allocates uninitialized storage; the mesh is empty() if that fails.
+    Mesh(size_t numVertices, size_t numIndices);
+    ~Mesh();
+
+    Mesh(Mesh&& other) noexcept;
+    Mesh& operator=(Mesh&& other) noexcept;
+    Mesh(const Mesh&) = delete;
+    Mesh& operator=(const Mesh&) = delete;
+
+    bool empty() const { return mArena == nullptr; }
+    size_t vertexCount() const { return mVertexCount; }
+    size_t indexCount() const { return mIndexCount; }
+    size_t triangleCount() const { return mIndexCount / 3; }
+
+    Span<glm::vec3> vertices() { return Span<glm::vec3>(mVertices, mVertexCount); }
+    Span<const glm::vec3> vertices() const { return Span<const glm::vec3>(mVertices, mVertexCount); }
+    Span<int> indices() { return Span<int>(mIndices, mIndexCount); }
+    Span<const int> indices() const { return Span<const int>(mIndices, mIndexCount); }
+
+    void release();
+
+private:
+    void* mArena = nullptr;
+    glm::vec3* mVertices = nullptr;
+    int* mIndices = nullptr;
+    size_t mVertexCount = 0;
+    size_t mIndexCount = 0;
+};
+
+#endif // MESH_H
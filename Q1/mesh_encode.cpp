@@ -0,0 +1,160 @@
+//
+//  mesh_encode.cpp
+//  Vertex quantization: snorm16 positions, packed normals, 16-bit indices
+//
+
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/packing.hpp>
+#include "mesh_encode.h"
+
+namespace {
+
+const float kSnorm16 = 32767.0f;
+const float kSnorm10 = 511.0f;
+
+float sign_not_zero(float v)
+{
+    return v >= 0.0f ? 1.0f : -1.0f;
+}
+
+// Octahedral mapping of a unit vector to [-1, 1]^2
+glm::vec2 oct_wrap(const glm::vec3& n)
+{
+    glm::vec3 p = n / (fabsf(n.x) + fabsf(n.y) + fabsf(n.z));
+    glm::vec2 e(p.x, p.y);
+    if (p.z < 0.0f) {
+        e = glm::vec2((1.0f - fabsf(p.y)) * sign_not_zero(p.x), (1.0f - fabsf(p.x)) * sign_not_zero(p.y));
+    }
+    return e;
+}
+
+// Same as octDecode() in PhongQuantized.vert
+glm::vec3 oct_unwrap(const glm::vec2& e)
+{
+    glm::vec3 n(e.x, e.y, 1.0f - fabsf(e.x) - fabsf(e.y));
+    if (n.z < 0.0f) {
+        float x = (1.0f - fabsf(n.y)) * sign_not_zero(n.x);
+        float y = (1.0f - fabsf(n.x)) * sign_not_zero(n.y);
+        n.x = x;
+        n.y = y;
+    }
+    return glm::normalize(n);
+}
+
+float decode_snorm16(int16_t v)
+{
+    return std::max((float)v / kSnorm16, -1.0f);
+}
+
+// Octahedral snorm16 encoding. Plain rounding is not always the closest
+// representable direction, so the four neighbouring grid points are tried.
+uint32_t encode_oct16(const glm::vec3& n, glm::vec3& decoded)
+{
+    glm::vec2 e = oct_wrap(n) * kSnorm16;
+    float bestDot = -2.0f;
+    uint32_t best = 0;
+    for (int c = 0; c < 4; ++c) {
+        float x = (c & 1) ? ceilf(e.x) : floorf(e.x);
+        float y = (c & 2) ? ceilf(e.y) : floorf(e.y);
+        glm::vec2 q = glm::clamp(glm::vec2(x, y) / kSnorm16, -1.0f, 1.0f);
+        uint32_t packed = glm::packSnorm2x16(q);
+        glm::vec3 d = oct_unwrap(glm::vec2(decode_snorm16((int16_t)(packed & 0xffff)),
+                                           decode_snorm16((int16_t)(packed >> 16))));
+        float dot = glm::dot(d, n);
+        if (dot > bestDot) {
+            bestDot = dot;
+            best = packed;
+            decoded = d;
+        }
+    }
+    return best;
+}
+
+uint32_t encode_1010102(const glm::vec3& n, glm::vec3& decoded)
+{
+    uint32_t packed = glm::packSnorm3x10_1x2(glm::vec4(n, 0.0f));
+    // Sign-extend the three 10-bit fields like GL_INT_2_10_10_10_REV does.
+    int x = (int)(packed << 22) >> 22;
+    int y = (int)(packed << 12) >> 22;
+    int z = (int)(packed << 2) >> 22;
+    decoded = glm::normalize(glm::max(glm::vec3((float)x, (float)y, (float)z) / kSnorm10, glm::vec3(-1.0f)));
+    return packed;
+}
+
+float angle_degrees(const glm::vec3& a, const glm::vec3& b)
+{
+    float c = glm::clamp(glm::dot(a, b), -1.0f, 1.0f);
+    return acosf(c) * (180.0f / 3.14159265358979323846f);
+}
+
+} // namespace
+
+EncodedMesh encode_mesh(const Mesh& mesh, const glm::vec3* normals, const EncodeOptions& options)
+{
+    EncodedMesh out;
+    out.normals = options.normals;
+    out.vertexCount = mesh.vertexCount();
+    out.indexCount = mesh.indexCount();
+    out.vertexStride = 4 * sizeof(int16_t) + sizeof(uint32_t);
+
+    // Attribute layout (locations match Phong.vert / PhongQuantized.vert)
+    out.attributes[0] = { 0, 4, GL_SHORT, 0 };
+    if (options.normals == NormalEncoding::Oct16)
+        out.attributes[1] = { 1, 2, GL_SHORT, 4 * sizeof(int16_t) };
+    else
+        out.attributes[1] = { 1, 4, GL_INT_2_10_10_10_REV, 4 * sizeof(int16_t) };
+
+    Span<const glm::vec3> positions = mesh.vertices();
+    if (positions.empty()) return out;
+
+    // 1. Bounds -> per-axis offset and scale
+    glm::vec3 lo = positions[0], hi = positions[0];
+    for (const glm::vec3& p : positions) {
+        lo = glm::min(lo, p);
+        hi = glm::max(hi, p);
+    }
+    glm::vec3 halfExtent = glm::max((hi - lo) * 0.5f, glm::vec3(1e-20f));
+    out.positionOffset = (lo + hi) * 0.5f;
+    out.positionScale = halfExtent / kSnorm16;
+
+    // 2. Interleaved vertices
+    out.vertexData.resize(out.vertexCount * out.vertexStride);
+    uint8_t* dst = out.vertexData.data();
+    for (size_t v = 0; v < out.vertexCount; ++v, dst += out.vertexStride) {
+        const glm::vec3& p = positions[v];
+        glm::vec3 unit = (p - out.positionOffset) / halfExtent;
+        uint64_t packedPosition = glm::packSnorm4x16(glm::vec4(unit, 0.0f));
+        memcpy(dst, &packedPosition, sizeof(packedPosition));
+
+        const int16_t* q = reinterpret_cast<const int16_t*>(dst);
+        glm::vec3 decodedPosition = out.positionOffset + out.positionScale * glm::vec3(q[0], q[1], q[2]);
+        out.maxPositionError = std::max(out.maxPositionError, glm::length(decodedPosition - p));
+
+        glm::vec3 n = glm::normalize(normals ? normals[v] : p);
+        glm::vec3 decodedNormal;
+        uint32_t packedNormal = options.normals == NormalEncoding::Oct16
+            ? encode_oct16(n, decodedNormal) : encode_1010102(n, decodedNormal);
+        memcpy(dst + 4 * sizeof(int16_t), &packedNormal, sizeof(packedNormal));
+        out.maxNormalErrorDeg = std::max(out.maxNormalErrorDeg, angle_degrees(n, decodedNormal));
+    }
+
+    // 3. Indices
+    Span<const int> indices = mesh.indices();
+    if (options.allowShortIndices && out.vertexCount <= 65536) {
+        out.indexType = GL_UNSIGNED_SHORT;
+        out.indexData.resize(out.indexCount * sizeof(uint16_t));
+        uint16_t* idx = reinterpret_cast<uint16_t*>(out.indexData.data());
+        for (size_t i = 0; i < out.indexCount; ++i) idx[i] = (uint16_t)indices[i];
+    }
+    else {
+        out.indexType = GL_UNSIGNED_INT;
+        out.indexData.resize(indices.size_bytes());
+        memcpy(out.indexData.data(), indices.data(), indices.size_bytes());
+    }
+
+    return out;
+}
@@ -0,0 +1,67 @@
+#pragma once
+#ifndef MESH_ENCODE_H
+#define MESH_ENCODE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+#include <glm/vec3.hpp>
+#include "mesh.h"
+
+// Compact GPU encoding of a Mesh:
+//  - positions as 4 x int16 (w unused), snorm relative to the mesh bounds
+//  - normals as octahedral 2 x int16, or xyz in a 10_10_10_2 word
+//  - 16-bit indices whenever every vertex index fits
+// Attributes are uploaded unnormalized and decoded in PhongQuantized.vert,
+// so the result does not depend on the driver's snorm conversion rule.
+
+enum class NormalEncoding
+{
+    Oct16,        // octahedral, 2 x snorm16 (4 bytes)
+    Snorm1010102, // xyz snorm10 + 2 unused bits (4 bytes)
+};
+
+struct EncodeOptions
+{
+    NormalEncoding normals = NormalEncoding::Oct16;
+    bool allowShortIndices = true;
+};
+
+// One glVertexAttribPointer() call
+struct VertexAttribute
+{
+    unsigned int location;
+    int components;
+    unsigned int type;  // GL_SHORT, GL_INT_2_10_10_10_REV, ...
+    size_t offset;
+};
+
+struct EncodedMesh
+{
+    std::vector<uint8_t> vertexData; // interleaved, vertexStride bytes per vertex
+    std::vector<uint8_t> indexData;
+    size_t vertexCount = 0;
+    size_t vertexStride = 0;
+    size_t indexCount = 0;
+    unsigned int indexType = 0;      // GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+
+    VertexAttribute attributes[2];
+    NormalEncoding normals = NormalEncoding::Oct16;
+
+    // position = positionOffset + positionScale * stored integer
+    glm::vec3 positionOffset;
+    glm::vec3 positionScale;
+
+    // Measured by decoding every vertex exactly like the shader does.
+    float maxPositionError = 0.0f;   // object space units
+    float maxNormalErrorDeg = 0.0f;  // degrees
+};
+
+// normals == nullptr uses the normalized positions as normals, which is what
+// the viewer does for the unit sphere.
+EncodedMesh encode_mesh(const Mesh& mesh, const glm::vec3* normals, const EncodeOptions& options = EncodeOptions());
+
+// Shader value of the normalEncoding uniform in PhongQuantized.vert
+inline int normal_encoding_id(NormalEncoding e) { return e == NormalEncoding::Oct16 ? 0 : 1; }
+
+#endif // MESH_ENCODE_H
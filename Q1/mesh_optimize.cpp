@@ -0,0 +1,436 @@
+//
+//  mesh_optimize.cpp
+//  Index and vertex buffer reordering passes
+//
+
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <vector>
+#include <glm/glm.hpp>
+#include "mesh_optimize.h"
+
+namespace {
+
+// Vertex -> triangle adjacency in compressed (offset, list) form.
+struct Adjacency
+{
+    std::vector<int> offsets;   // vertexCount + 1
+    std::vector<int> triangles; // indexCount
+
+    Adjacency(const int* indices, size_t indexCount, size_t vertexCount)
+        : offsets(vertexCount + 1, 0), triangles(indexCount)
+    {
+        for (size_t i = 0; i < indexCount; ++i) offsets[indices[i] + 1]++;
+        for (size_t v = 0; v < vertexCount; ++v) offsets[v + 1] += offsets[v];
+
+        std::vector<int> fill(offsets.begin(), offsets.end() - 1);
+        for (size_t i = 0; i < indexCount; ++i) triangles[fill[indices[i]]++] = (int)(i / 3);
+    }
+
+    int count(int v) const { return offsets[v + 1] - offsets[v]; }
+    const int* begin(int v) const { return triangles.data() + offsets[v]; }
+    const int* end(int v) const { return triangles.data() + offsets[v + 1]; }
+};
+
+} // namespace
+
+void optimize_vertex_cache(int* indices, size_t indexCount, size_t vertexCount, int cacheSize)
+{
+    size_t triangleCount = indexCount / 3;
+    if (triangleCount == 0 || vertexCount == 0) return;
+
+    Adjacency adjacency(indices, indexCount, vertexCount);
+
+    std::vector<int> live(vertexCount);          // triangles still to emit per vertex
+    for (size_t v = 0; v < vertexCount; ++v) live[v] = adjacency.count((int)v);
+    std::vector<int> cacheTime(vertexCount, 0);  // time stamp of the last cache insertion
+    std::vector<char> emitted(triangleCount, 0);
+    std::vector<int> deadEnd;                    // recently referenced vertices
+    std::vector<int> candidates;
+    std::vector<int> output;
+    output.reserve(indexCount);
+
+    int timeStamp = cacheSize + 1;
+    int cursor = 1;
+    int fanning = 0;
+
+    while (fanning >= 0) {
+        // 1. Emit all remaining triangles around the fanning vertex.
+        candidates.clear();
+        for (const int* t = adjacency.begin(fanning); t != adjacency.end(fanning); ++t) {
+            if (emitted[*t]) continue;
+            for (int k = 0; k < 3; ++k) {
+                int v = indices[*t * 3 + k];
+                output.push_back(v);
+                deadEnd.push_back(v);
+                candidates.push_back(v);
+                live[v]--;
+                if (timeStamp - cacheTime[v] > cacheSize) {
+                    cacheTime[v] = timeStamp++;
+                }
+            }
+            emitted[*t] = 1;
+        }
+
+        // 2. Next fanning vertex: the candidate that is still in the cache
+        //    after its remaining triangles are emitted, and the oldest such.
+        int next = -1;
+        int best = -1;
+        for (int v : candidates) {
+            if (live[v] <= 0) continue;
+            int priority = 0;
+            if (timeStamp - cacheTime[v] + 2 * live[v] <= cacheSize) {
+                priority = timeStamp - cacheTime[v];
+            }
+            if (priority > best) {
+                best = priority;
+                next = v;
+            }
+        }
+
+        // 3. Dead end: fall back to recently used vertices, then scan.
+        while (next < 0 && !deadEnd.empty()) {
+            int v = deadEnd.back();
+            deadEnd.pop_back();
+            if (live[v] > 0) next = v;
+        }
+        while (next < 0 && cursor < (int)vertexCount) {
+            if (live[cursor] > 0) next = cursor;
+            ++cursor;
+        }
+        fanning = next;
+    }
+
+    memcpy(indices, output.data(), output.size() * sizeof(int));
+}
+
+void optimize_vertex_cache(Mesh& mesh, int cacheSize)
+{
+    optimize_vertex_cache(mesh.indices().data(), mesh.indexCount(), mesh.vertexCount(), cacheSize);
+}
+
+CacheStats simulate_vertex_cache(const int* indices, size_t indexCount, size_t vertexCount,
+    int cacheSize, CacheModel model)
+{
+    CacheStats stats;
+    stats.triangles = indexCount / 3;
+    std::vector<char> referenced(vertexCount, 0);
+
+    if (model == CacheModel::Fifo) {
+        // A vertex is resident while fewer than cacheSize misses happened
+        // since it was inserted.
+        std::vector<size_t> insertedAt(vertexCount, 0);
+        std::vector<char> seen(vertexCount, 0);
+        for (size_t i = 0; i < indexCount; ++i) {
+            int v = indices[i];
+            if (!seen[v] || stats.misses - insertedAt[v] > (size_t)cacheSize) {
+                insertedAt[v] = stats.misses++;
+                seen[v] = 1;
+            }
+            referenced[v] = 1;
+        }
+    }
+    else {
+        // Small caches: a move-to-front list is the fastest exact model.
+        std::vector<int> cache;
+        cache.reserve(cacheSize + 1);
+        for (size_t i = 0; i < indexCount; ++i) {
+            int v = indices[i];
+            std::vector<int>::iterator it = std::find(cache.begin(), cache.end(), v);
+            if (it != cache.end()) {
+                cache.erase(it);
+            }
+            else {
+                stats.misses++;
+                if ((int)cache.size() == cacheSize) cache.pop_back();
+            }
+            cache.insert(cache.begin(), v);
+            referenced[v] = 1;
+        }
+    }
+
+    for (char r : referenced) stats.vertices += r;
+    stats.acmr = stats.triangles ? (double)stats.misses / stats.triangles : 0.0;
+    stats.atvr = stats.vertices ? (double)stats.misses / stats.vertices : 0.0;
+    return stats;
+}
+
+namespace {
+
+// FIFO post-transform cache that can be restarted cheaply with reset().
+struct FifoCache
+{
+    std::vector<size_t> insertedAt;
+    std::vector<size_t> generation;
+    size_t misses = 0;
+    size_t current = 1;
+    size_t size;
+
+    FifoCache(size_t vertexCount, int cacheSize)
+        : insertedAt(vertexCount, 0), generation(vertexCount, 0), size((size_t)cacheSize) {}
+
+    void reset() { ++current; }
+
+    // Returns the number of misses for one triangle.
+    int triangle(const int* tri)
+    {
+        int m = 0;
+        for (int k = 0; k < 3; ++k) {
+            int v = tri[k];
+            if (generation[v] != current || misses - insertedAt[v] > size) {
+                generation[v] = current;
+                insertedAt[v] = misses++;
+                ++m;
+            }
+        }
+        return m;
+    }
+};
+
+struct Cluster
+{
+    size_t begin; // first triangle
+    size_t end;
+    float sortKey;
+};
+
+} // namespace
+
+void optimize_overdraw(int* indices, size_t indexCount, const glm::vec3* vertices, size_t vertexCount,
+    int cacheSize, float threshold)
+{
+    size_t triangleCount = indexCount / 3;
+    if (triangleCount == 0) return;
+
+    // 1. Hard boundaries: triangles whose three vertices all miss.
+    FifoCache cache(vertexCount, cacheSize);
+    std::vector<size_t> hard;
+    for (size_t t = 0; t < triangleCount; ++t) {
+        if (cache.triangle(indices + 3 * t) == 3) hard.push_back(t);
+    }
+    const size_t inputMisses = cache.misses;
+    if (hard.empty() || hard[0] != 0) hard.insert(hard.begin(), 0);
+    hard.push_back(triangleCount);
+
+    // 2. Soft boundaries: split a hard cluster as soon as the running ACMR of
+    //    the current piece is within threshold of the whole hard cluster.
+    const size_t minClusterSize = 8;
+    auto coldMisses = [&](size_t begin, size_t end) {
+        cache.reset();
+        size_t misses = 0;
+        for (size_t t = begin; t < end; ++t) misses += cache.triangle(indices + 3 * t);
+        return misses;
+    };
+    std::vector<Cluster> clusters;
+    for (size_t h = 0; h + 1 < hard.size(); ++h) {
+        size_t begin = hard[h], end = hard[h + 1];
+        double limit = (double)coldMisses(begin, end) / (end - begin) * threshold;
+        size_t first = clusters.size();
+
+        size_t start = begin;
+        size_t pieceMisses = 0;
+        cache.reset();
+        for (size_t t = begin; t < end; ++t) {
+            pieceMisses += cache.triangle(indices + 3 * t);
+            size_t count = t + 1 - start;
+            if (count >= minClusterSize && end - (t + 1) >= minClusterSize &&
+                (double)pieceMisses / count <= limit) {
+                clusters.push_back({ start, t + 1, 0.0f });
+                start = t + 1;
+                pieceMisses = 0;
+                cache.reset();
+            }
+        }
+        if (start < end) clusters.push_back({ start, end, 0.0f });
+
+        // The last piece is whatever the splits left over. While it misses
+        // the bound, merge it into the piece before; the whole hard cluster
+        // meets it by definition.
+        while (clusters.size() - first > 1) {
+            Cluster& last = clusters.back();
+            if ((double)coldMisses(last.begin, last.end) / (last.end - last.begin) <= limit) break;
+            clusters[clusters.size() - 2].end = last.end;
+            clusters.pop_back();
+        }
+    }
+
+    // 3. Sort clusters by how far they face away from the mesh centroid.
+    glm::vec3 meshCentroid(0.0f);
+    for (size_t v = 0; v < vertexCount; ++v) meshCentroid += vertices[v];
+    meshCentroid /= (float)vertexCount;
+
+    for (Cluster& c : clusters) {
+        glm::vec3 centroid(0.0f), normal(0.0f);
+        float area = 0.0f;
+        for (size_t t = c.begin; t < c.end; ++t) {
+            const glm::vec3& a = vertices[indices[3 * t]];
+            const glm::vec3& b = vertices[indices[3 * t + 1]];
+            const glm::vec3& d = vertices[indices[3 * t + 2]];
+            glm::vec3 n = glm::cross(b - a, d - a);
+            float w = glm::length(n);
+            centroid += (a + b + d) * (w / 3.0f);
+            normal += n;
+            area += w;
+        }
+        if (area > 0.0f) centroid /= area;
+        float len = glm::length(normal);
+        c.sortKey = len > 0.0f ? glm::dot(centroid - meshCentroid, normal / len) : 0.0f;
+    }
+    std::stable_sort(clusters.begin(), clusters.end(),
+        [](const Cluster& a, const Cluster& b) { return a.sortKey > b.sortKey; });
+
+    std::vector<int> output;
+    output.reserve(indexCount);
+    for (const Cluster& c : clusters) {
+        output.insert(output.end(), indices + 3 * c.begin, indices + 3 * c.end);
+    }
+
+    // The pieces were measured with a cold cache each; the reordered buffer
+    // as a whole must also stay within threshold of the input.
+    FifoCache check(vertexCount, cacheSize);
+    for (size_t t = 0; t < triangleCount; ++t) check.triangle(output.data() + 3 * t);
+    if ((double)check.misses > inputMisses * (double)threshold) return;
+    memcpy(indices, output.data(), output.size() * sizeof(int));
+}
+
+void optimize_overdraw(Mesh& mesh, int cacheSize, float threshold)
+{
+    optimize_overdraw(mesh.indices().data(), mesh.indexCount(), mesh.vertices().data(), mesh.vertexCount(),
+        cacheSize, threshold);
+}
+
+size_t optimize_vertex_fetch(Mesh& mesh)
+{
+    Span<glm::vec3> vertices = mesh.vertices();
+    Span<int> indices = mesh.indices();
+
+    std::vector<int> remap(vertices.size(), -1);
+    int next = 0;
+    for (int& i : indices) {
+        if (remap[i] < 0) remap[i] = next++;
+        i = remap[i];
+    }
+    size_t referenced = (size_t)next;
+    for (int& r : remap) {
+        if (r < 0) r = next++;
+    }
+
+    std::vector<glm::vec3> original(vertices.begin(), vertices.end());
+    for (size_t v = 0; v < original.size(); ++v) vertices[remap[v]] = original[v];
+    return referenced;
+}
+
+OverdrawStats estimate_overdraw(const glm::vec3* vertices, const int* indices, size_t indexCount,
+    int resolution, int viewCount, bool cullBackfaces)
+{
+    OverdrawStats stats;
+    if (indexCount < 3) return stats;
+
+    size_t vertexCount = 0;
+    for (size_t i = 0; i < indexCount; ++i) vertexCount = std::max(vertexCount, (size_t)indices[i] + 1);
+
+    glm::vec3 lo = vertices[0], hi = vertices[0];
+    for (size_t v = 0; v < vertexCount; ++v) {
+        lo = glm::min(lo, vertices[v]);
+        hi = glm::max(hi, vertices[v]);
+    }
+    glm::vec3 center = (lo + hi) * 0.5f;
+    float radius = glm::length(hi - lo) * 0.5f;
+    if (radius <= 0.0f) return stats;
+
+    std::vector<glm::vec3> projected(vertexCount);
+    std::vector<float> depth((size_t)resolution * resolution);
+    std::vector<unsigned char> covered((size_t)resolution * resolution);
+    const float scale = resolution * 0.5f / radius;
+
+    for (int view = 0; view < viewCount; ++view) {
+        // Fibonacci sphere directions
+        float z = 1.0f - (2.0f * view + 1.0f) / viewCount;
+        float r = sqrtf(std::max(0.0f, 1.0f - z * z));
+        float a = view * 2.39996323f;
+        glm::vec3 dir(r * cosf(a), r * sinf(a), z);
+        glm::vec3 up = fabsf(dir.y) < 0.99f ? glm::vec3(0, 1, 0) : glm::vec3(1, 0, 0);
+        glm::vec3 right = glm::normalize(glm::cross(up, dir));
+        up = glm::cross(dir, right);
+
+        for (size_t v = 0; v < vertexCount; ++v) {
+            glm::vec3 p = vertices[v] - center;
+            // The viewer sits on the +dir side; z grows away from it.
+            projected[v] = glm::vec3((glm::dot(p, right) + radius) * scale, (glm::dot(p, up) + radius) * scale,
+                -glm::dot(p, dir));
+        }
+        std::fill(depth.begin(), depth.end(), 1e30f);
+        std::fill(covered.begin(), covered.end(), 0);
+
+        for (size_t t = 0; t + 2 < indexCount; t += 3) {
+            glm::vec3 p0 = projected[indices[t]], p1 = projected[indices[t + 1]], p2 = projected[indices[t + 2]];
+            float area = (p1.x - p0.x) * (p2.y - p0.y) - (p1.y - p0.y) * (p2.x - p0.x);
+            if (area == 0.0f || (cullBackfaces && area < 0.0f)) continue;
+            if (area < 0.0f) {
+                std::swap(p1, p2);
+                area = -area;
+            }
+
+            int x0 = std::max(0, (int)floorf(std::min(p0.x, std::min(p1.x, p2.x))));
+            int x1 = std::min(resolution - 1, (int)ceilf(std::max(p0.x, std::max(p1.x, p2.x))));
+            int y0 = std::max(0, (int)floorf(std::min(p0.y, std::min(p1.y, p2.y))));
+            int y1 = std::min(resolution - 1, (int)ceilf(std::max(p0.y, std::max(p1.y, p2.y))));
+
+            for (int y = y0; y <= y1; ++y) {
+                float py = y + 0.5f;
+                for (int x = x0; x <= x1; ++x) {
+                    float px = x + 0.5f;
+                    float w0 = (p2.x - p1.x) * (py - p1.y) - (p2.y - p1.y) * (px - p1.x);
+                    float w1 = (p0.x - p2.x) * (py - p2.y) - (p0.y - p2.y) * (px - p2.x);
+                    float w2 = (p1.x - p0.x) * (py - p0.y) - (p1.y - p0.y) * (px - p0.x);
+                    if (w0 < 0.0f || w1 < 0.0f || w2 < 0.0f) continue;
+
+                    float d = (w0 * p0.z + w1 * p1.z + w2 * p2.z) / area;
+                    size_t pixel = (size_t)y * resolution + x;
+                    if (d < depth[pixel]) {
+                        depth[pixel] = d;
+                        stats.pixelsShaded++;
+                        if (!covered[pixel]) {
+                            covered[pixel] = 1;
+                            stats.pixelsCovered++;
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    stats.overdraw = stats.pixelsCovered ? (double)stats.pixelsShaded / stats.pixelsCovered : 0.0;
+    return stats;
+}
+
+double simulate_vertex_fetch(const int* indices, size_t indexCount, size_t vertexCount, size_t vertexBytes,
+    size_t lineBytes, int cacheLines)
+{
+    std::vector<char> referenced(vertexCount, 0);
+    std::vector<size_t> cache; // LRU of line numbers, most recent first
+    size_t fetched = 0;
+
+    for (size_t i = 0; i < indexCount; ++i) {
+        size_t v = (size_t)indices[i];
+        referenced[v] = 1;
+        size_t first = v * vertexBytes / lineBytes;
+        size_t last = ((v + 1) * vertexBytes - 1) / lineBytes;
+        for (size_t line = first; line <= last; ++line) {
+            std::vector<size_t>::iterator it = std::find(cache.begin(), cache.end(), line);
+            if (it != cache.end()) {
+                cache.erase(it);
+            }
+            else {
+                fetched += lineBytes;
+                if ((int)cache.size() == cacheLines) cache.pop_back();
+            }
+            cache.insert(cache.begin(), line);
+        }
+    }
+
+    size_t used = 0;
+    for (char r : referenced) used += r;
+    return used ? (double)fetched / (used * vertexBytes) : 0.0;
+}
@@ -0,0 +1,67 @@
+#pragma once
+#ifndef MESH_OPTIMIZE_H
+#define MESH_OPTIMIZE_H
+
+#include <stddef.h>
+#include <glm/vec3.hpp>
+#include "mesh.h"
+
+// Post-transform vertex cache model used by simulate_vertex_cache()
+enum class CacheModel
+{
+    Fifo, // most desktop GPUs: a hit does not refresh the entry
+    Lru,
+};
+
+struct CacheStats
+{
+    size_t misses = 0;    // vertex shader invocations
+    size_t triangles = 0;
+    size_t vertices = 0;  // distinct vertices referenced
+    double acmr = 0.0;    // average cache miss ratio: misses per triangle
+    double atvr = 0.0;    // average transform to vertex ratio: misses per vertex (1.0 is ideal)
+};
+
+// Reorders the triangles of an index buffer for a post-transform cache of
+// cacheSize entries (Tipsify, Sander et al. 2007). Linear in the number of
+// indices; the set of triangles and their winding are unchanged.
+void optimize_vertex_cache(int* indices, size_t indexCount, size_t vertexCount, int cacheSize = 16);
+void optimize_vertex_cache(Mesh& mesh, int cacheSize = 16);
+
+CacheStats simulate_vertex_cache(const int* indices, size_t indexCount, size_t vertexCount,
+    int cacheSize, CacheModel model);
+
+// Reorders clusters of an index buffer that was already passed through
+// optimize_vertex_cache() so that outward-facing clusters are drawn first
+// (Sander et al. 2007). The buffer is cut where the cache was flushed and
+// where a cluster's ACMR stays within `threshold` of its hard cluster. The
+// FIFO ACMR of the result is at most `threshold` times that of the input;
+// a reordering that would exceed it leaves the buffer unchanged.
+void optimize_overdraw(int* indices, size_t indexCount, const glm::vec3* vertices, size_t vertexCount,
+    int cacheSize = 16, float threshold = 1.05f);
+void optimize_overdraw(Mesh& mesh, int cacheSize = 16, float threshold = 1.05f);
+
+// Renumbers vertices in the order the index buffer first references them,
+// so vertex fetches walk memory forward. Unreferenced vertices move to the
+// end. Returns the number of referenced vertices.
+size_t optimize_vertex_fetch(Mesh& mesh);
+
+struct OverdrawStats
+{
+    size_t pixelsCovered = 0;
+    size_t pixelsShaded = 0;  // fragments passing the depth test when drawn (early-Z)
+    double overdraw = 0.0;    // shaded / covered, 1.0 is ideal
+};
+
+// Software depth-buffer rasterization of the mesh, orthographic, from
+// viewCount directions spread over the sphere. Back faces are rasterized
+// unless cullBackfaces is set, matching the viewer which does not cull.
+OverdrawStats estimate_overdraw(const glm::vec3* vertices, const int* indices, size_t indexCount,
+    int resolution = 256, int viewCount = 16, bool cullBackfaces = false);
+
+// Bytes pulled through a cache of cacheLines lines of lineBytes each, for
+// vertices of vertexBytes, divided by the size of the referenced vertices.
+double simulate_vertex_fetch(const int* indices, size_t indexCount, size_t vertexCount, size_t vertexBytes,
+    size_t lineBytes = 64, int cacheLines = 32);
+
+#endif // MESH_OPTIMIZE_H
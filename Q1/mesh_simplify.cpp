@@ -0,0 +1,790 @@
+//
+//  mesh_simplify.cpp
+//  Quadric error metric simplification and LOD chains
+//
+
+#include <string.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <float.h>
+#include <algorithm>
+#include <chrono>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <glm/glm.hpp>
+#include "mesh_simplify.h"
+#include "sphere_scene.h"
+#include "parallel.h"
+
+namespace {
+
+// Sum of squared distances to a set of planes, as a symmetric 4x4 matrix
+// (Garland & Heckbert).
+struct Quadric
+{
+    double m[10] = {}; // aa ab ac ad bb bc bd cc cd dd
+
+    Quadric() = default;
+    Quadric(double a, double b, double c, double d)
+    {
+        m[0] = a * a; m[1] = a * b; m[2] = a * c; m[3] = a * d;
+        m[4] = b * b; m[5] = b * c; m[6] = b * d;
+        m[7] = c * c; m[8] = c * d;
+        m[9] = d * d;
+    }
+
+    Quadric& operator+=(const Quadric& q)
+    {
+        for (int i = 0; i < 10; ++i) m[i] += q.m[i];
+        return *this;
+    }
+
+    double error(const glm::dvec3& p) const
+    {
+        double x = p.x, y = p.y, z = p.z;
+        return m[0] * x * x + 2.0 * m[1] * x * y + 2.0 * m[2] * x * z + 2.0 * m[3] * x
+            + m[4] * y * y + 2.0 * m[5] * y * z + 2.0 * m[6] * y
+            + m[7] * z * z + 2.0 * m[8] * z + m[9];
+    }
+
+    // Position minimizing error(); false when the planes do not pin a point
+    // down (flat or cylindrical neighbourhoods).
+    bool optimum(glm::dvec3& p) const
+    {
+        double det = m[0] * (m[4] * m[7] - m[5] * m[5])
+            - m[1] * (m[1] * m[7] - m[5] * m[2])
+            + m[2] * (m[1] * m[5] - m[4] * m[2]);
+        double trace = m[0] + m[4] + m[7];
+        if (!(fabs(det) > 1e-9 * trace * trace * trace)) return false;
+
+        // Cramer's rule on A p = -b
+        double bx = -m[3], by = -m[6], bz = -m[8];
+        p.x = (bx * (m[4] * m[7] - m[5] * m[5]) - m[1] * (by * m[7] - m[5] * bz) + m[2] * (by * m[5] - m[4] * bz)) / det;
+        p.y = (m[0] * (by * m[7] - m[5] * bz) - bx * (m[1] * m[7] - m[5] * m[2]) + m[2] * (m[1] * bz - by * m[2])) / det;
+        p.z = (m[0] * (m[4] * bz - by * m[5]) - m[1] * (m[1] * bz - by * m[2]) + bx * (m[1] * m[5] - m[4] * m[2])) / det;
+        return true;
+    }
+};
+
+// Iterative edge collapser in the style of "Fast Quadric Mesh Simplification":
+// instead of a priority queue every pass collapses all edges below an error
+// threshold that grows from pass to pass, rebuilding the adjacency every few
+// passes. Locked vertices never move or disappear.
+struct Simplifier
+{
+    struct Triangle
+    {
+        int v[3];
+        double err[4]; // per edge (v[j], v[j + 1]) and their minimum
+        glm::dvec3 n;
+        bool deleted;
+        bool dirty;
+    };
+    struct Vertex
+    {
+        glm::dvec3 p;
+        Quadric q;
+        int tstart = 0; // first entry in refs
+        int tcount = 0;
+        bool locked = false;
+    };
+    struct Ref
+    {
+        int tid;
+        int tvertex;
+    };
+
+    std::vector<Triangle> triangles;
+    std::vector<Vertex> vertices;
+    std::vector<Ref> refs;
+    std::vector<char> deleted0, deleted1;
+    double maxError = 0.0;
+
+    void add_triangle(int a, int b, int c)
+    {
+        Triangle t{};
+        t.v[0] = a; t.v[1] = b; t.v[2] = c;
+        triangles.push_back(t);
+    }
+
+    // Collapses edges until at most target triangles are left or nothing
+    // below the final threshold remains.
+    void run(size_t target, double aggressiveness)
+    {
+        size_t deletedCount = 0;
+        for (int pass = 0; pass < 100; ++pass) {
+            if (triangles.size() - deletedCount <= target) break;
+            if (pass % 5 == 0) {
+                update_mesh(pass);
+                deletedCount = 0;
+            }
+            for (Triangle& t : triangles) t.dirty = false;
+
+            double threshold = 1e-9 * pow((double)(pass + 3), aggressiveness);
+            for (size_t ti = 0; ti < triangles.size(); ++ti) {
+                const Triangle& t = triangles[ti];
+                if (t.err[3] > threshold || t.deleted || t.dirty) continue;
+
+                for (int j = 0; j < 3; ++j) {
+                    if (t.err[j] > threshold) continue;
+                    int i0 = t.v[j];
+                    int i1 = t.v[(j + 1) % 3];
+                    if (vertices[i0].locked && vertices[i1].locked) continue;
+                    if (vertices[i1].locked) std::swap(i0, i1); // keep the locked one
+                    Vertex& v0 = vertices[i0];
+                    Vertex& v1 = vertices[i1];
+
+                    glm::dvec3 p;
+                    double error = edge_error(i0, i1, p);
+                    deleted0.assign(v0.tcount, 0);
+                    deleted1.assign(v1.tcount, 0);
+                    if (flipped(p, i1, v0, deleted0) || flipped(p, i0, v1, deleted1)) continue;
+
+                    v0.p = p;
+                    v0.q += v1.q;
+                    int tstart = (int)refs.size();
+                    update_triangles(i0, v0, deleted0, deletedCount);
+                    update_triangles(i0, v1, deleted1, deletedCount);
+                    int tcount = (int)refs.size() - tstart;
+                    if (tcount <= v0.tcount) {
+                        // Reuse the old slot and drop the entries just appended.
+                        if (tcount > 0) memmove(&refs[v0.tstart], &refs[tstart], tcount * sizeof(Ref));
+                        refs.resize(tstart);
+                    }
+                    else {
+                        v0.tstart = tstart;
+                    }
+                    v0.tcount = tcount;
+                    maxError = std::max(maxError, error);
+                    break;
+                }
+                if (triangles.size() - deletedCount <= target) break;
+            }
+        }
+
+        triangles.erase(std::remove_if(triangles.begin(), triangles.end(),
+            [](const Triangle& t) { return t.deleted; }), triangles.end());
+    }
+
+    // Error of collapsing edge (a, b) and the position of the merged vertex.
+    double edge_error(int a, int b, glm::dvec3& result) const
+    {
+        const Vertex& va = vertices[a];
+        const Vertex& vb = vertices[b];
+        Quadric q = va.q;
+        q += vb.q;
+
+        if (va.locked || vb.locked) {
+            result = va.locked ? va.p : vb.p;
+            return q.error(result);
+        }
+
+        // The optimum of a nearly degenerate quadric can land far away from
+        // the edge; fall back to the endpoints and the midpoint then.
+        glm::dvec3 mid = (va.p + vb.p) * 0.5;
+        double reach = glm::length(vb.p - va.p);
+        if (q.optimum(result) && glm::length(result - mid) <= reach) {
+            return q.error(result);
+        }
+        double ea = q.error(va.p);
+        double eb = q.error(vb.p);
+        double em = q.error(mid);
+        double error = std::min(ea, std::min(eb, em));
+        result = error == ea ? va.p : error == eb ? vb.p : mid;
+        return error;
+    }
+
+    // True when moving vertex v to p would fold one of its triangles over.
+    // Triangles that also contain `other` collapse and are flagged in deleted.
+    bool flipped(const glm::dvec3& p, int other, const Vertex& v, std::vector<char>& deleted) const
+    {
+        for (int k = 0; k < v.tcount; ++k) {
+            const Ref& r = refs[v.tstart + k];
+            const Triangle& t = triangles[r.tid];
+            if (t.deleted) continue;
+
+            int id1 = t.v[(r.tvertex + 1) % 3];
+            int id2 = t.v[(r.tvertex + 2) % 3];
+            if (id1 == other || id2 == other) {
+                deleted[k] = 1;
+                continue;
+            }
+            glm::dvec3 d1 = vertices[id1].p - p;
+            glm::dvec3 d2 = vertices[id2].p - p;
+            double l1 = glm::length(d1);
+            double l2 = glm::length(d2);
+            if (l1 <= 0.0 || l2 <= 0.0) return true;
+            d1 /= l1;
+            d2 /= l2;
+            if (fabs(glm::dot(d1, d2)) > 0.999) return true;
+            glm::dvec3 n = glm::normalize(glm::cross(d1, d2));
+            if (glm::dot(n, t.n) < 0.2) return true;
+        }
+        return false;
+    }
+
+    // Re-points the surviving triangles of v to i0 and appends their refs.
+    void update_triangles(int i0, const Vertex& v, const std::vector<char>& deleted, size_t& deletedCount)
+    {
+        glm::dvec3 p;
+        for (int k = 0; k < v.tcount; ++k) {
+            Ref r = refs[v.tstart + k];
+            Triangle& t = triangles[r.tid];
+            if (t.deleted) continue;
+            if (deleted[k]) {
+                t.deleted = true;
+                deletedCount++;
+                continue;
+            }
+            t.v[r.tvertex] = i0;
+            t.dirty = true;
+            t.err[0] = edge_error(t.v[0], t.v[1], p);
+            t.err[1] = edge_error(t.v[1], t.v[2], p);
+            t.err[2] = edge_error(t.v[2], t.v[0], p);
+            t.err[3] = std::min(t.err[0], std::min(t.err[1], t.err[2]));
+            refs.push_back(r);
+        }
+    }
+
+    // Drops deleted triangles and rebuilds the vertex -> triangle refs. On
+    // the first pass also computes the quadrics and locks open borders.
+    void update_mesh(int pass)
+    {
+        if (pass > 0) {
+            triangles.erase(std::remove_if(triangles.begin(), triangles.end(),
+                [](const Triangle& t) { return t.deleted; }), triangles.end());
+        }
+
+        for (Vertex& v : vertices) v.tcount = 0;
+        for (const Triangle& t : triangles) {
+            for (int j = 0; j < 3; ++j) vertices[t.v[j]].tcount++;
+        }
+        int tstart = 0;
+        for (Vertex& v : vertices) {
+            v.tstart = tstart;
+            tstart += v.tcount;
+            v.tcount = 0;
+        }
+        refs.resize(triangles.size() * 3);
+        for (size_t i = 0; i < triangles.size(); ++i) {
+            for (int j = 0; j < 3; ++j) {
+                Vertex& v = vertices[triangles[i].v[j]];
+                refs[v.tstart + v.tcount].tid = (int)i;
+                refs[v.tstart + v.tcount].tvertex = j;
+                v.tcount++;
+            }
+        }
+
+        if (pass > 0) return;
+
+        for (Vertex& v : vertices) v.q = Quadric();
+        for (Triangle& t : triangles) {
+            const glm::dvec3& p0 = vertices[t.v[0]].p;
+            glm::dvec3 n = glm::cross(vertices[t.v[1]].p - p0, vertices[t.v[2]].p - p0);
+            double length = glm::length(n);
+            t.n = length > 0.0 ? n / length : glm::dvec3(0.0);
+            Quadric q(t.n.x, t.n.y, t.n.z, -glm::dot(t.n, p0));
+            for (int j = 0; j < 3; ++j) vertices[t.v[j]].q += q;
+        }
+
+        // An edge used by a single triangle is an open border: lock both ends.
+        std::vector<int> ids, counts;
+        for (size_t i = 0; i < vertices.size(); ++i) {
+            const Vertex& v = vertices[i];
+            ids.clear();
+            counts.clear();
+            for (int k = 0; k < v.tcount; ++k) {
+                const Triangle& t = triangles[refs[v.tstart + k].tid];
+                for (int j = 0; j < 3; ++j) {
+                    int id = t.v[j];
+                    if (id == (int)i) continue;
+                    size_t c = std::find(ids.begin(), ids.end(), id) - ids.begin();
+                    if (c == ids.size()) {
+                        ids.push_back(id);
+                        counts.push_back(1);
+                    }
+                    else {
+                        counts[c]++;
+                    }
+                }
+            }
+            for (size_t c = 0; c < ids.size(); ++c) {
+                if (counts[c] == 1) {
+                    vertices[i].locked = true;
+                    vertices[ids[c]].locked = true;
+                }
+            }
+        }
+
+        glm::dvec3 p;
+        for (Triangle& t : triangles) {
+            for (int j = 0; j < 3; ++j) t.err[j] = edge_error(t.v[j], t.v[(j + 1) % 3], p);
+            t.err[3] = std::min(t.err[0], std::min(t.err[1], t.err[2]));
+        }
+    }
+};
+
+// Maps every vertex to the first vertex found within `tolerance` of it.
+std::vector<int> weld_vertices(Span<const glm::vec3> vertices, float tolerance)
+{
+    // With cells of 2 * tolerance a match can only be in the 2x2x2 block of
+    // cells nearest to the vertex.
+    float cellSize = tolerance > 0.0f ? 2.0f * tolerance : 1.0f;
+    std::unordered_map<uint64_t, int> heads;
+    heads.reserve(vertices.size());
+    std::vector<int> next(vertices.size(), -1);
+    std::vector<int> remap(vertices.size());
+
+    auto key = [](int64_t x, int64_t y, int64_t z) {
+        return ((uint64_t)(x & 0x1fffff) << 42) | ((uint64_t)(y & 0x1fffff) << 21) | (uint64_t)(z & 0x1fffff);
+    };
+
+    for (size_t i = 0; i < vertices.size(); ++i) {
+        const glm::vec3& p = vertices[i];
+        glm::vec3 g = p / cellSize;
+        int64_t c[3] = { (int64_t)floorf(g.x), (int64_t)floorf(g.y), (int64_t)floorf(g.z) };
+        int64_t d[3] = {
+            g.x - c[0] < 0.5f ? -1 : 1, g.y - c[1] < 0.5f ? -1 : 1, g.z - c[2] < 0.5f ? -1 : 1 };
+
+        int found = -1;
+        for (int n = 0; n < 8 && found < 0; ++n) {
+            auto it = heads.find(key(c[0] + (n & 1) * d[0], c[1] + (n >> 1 & 1) * d[1], c[2] + (n >> 2) * d[2]));
+            if (it == heads.end()) continue;
+            for (int v = it->second; v >= 0; v = next[v]) {
+                if (glm::length(vertices[v] - p) <= tolerance) {
+                    found = v;
+                    break;
+                }
+            }
+        }
+        if (found >= 0) {
+            remap[i] = found;
+            continue;
+        }
+        remap[i] = (int)i;
+        auto inserted = heads.emplace(key(c[0], c[1], c[2]), (int)i);
+        if (!inserted.second) {
+            next[i] = inserted.first->second;
+            inserted.first->second = (int)i;
+        }
+    }
+    return remap;
+}
+
+// 30-bit Morton code of a point inside [lo, lo + extent].
+uint32_t morton_code(const glm::vec3& p, const glm::vec3& lo, const glm::vec3& extent)
+{
+    auto spread = [](uint32_t x) {
+        x = (x | (x << 16)) & 0x030000ff;
+        x = (x | (x << 8)) & 0x0300f00f;
+        x = (x | (x << 4)) & 0x030c30c3;
+        x = (x | (x << 2)) & 0x09249249;
+        return x;
+    };
+    glm::vec3 t = (p - lo) / glm::max(extent, glm::vec3(FLT_MIN));
+    glm::vec3 q = glm::clamp(t * 1024.0f, glm::vec3(0.0f), glm::vec3(1023.0f));
+    return spread((uint32_t)q.x) << 2 | spread((uint32_t)q.y) << 1 | spread((uint32_t)q.z);
+}
+
+Mesh copy_mesh(const Mesh& mesh)
+{
+    Mesh copy(mesh.vertexCount(), mesh.indexCount());
+    if (copy.empty()) return copy;
+    std::copy(mesh.vertices().begin(), mesh.vertices().end(), copy.vertices().begin());
+    std::copy(mesh.indices().begin(), mesh.indices().end(), copy.indices().begin());
+    return copy;
+}
+
+// Squared distance from p to triangle abc (Ericson, Real-Time Collision
+// Detection 5.1.5).
+float point_triangle_distance2(const glm::vec3& p, const glm::vec3& a, const glm::vec3& b, const glm::vec3& c)
+{
+    glm::vec3 ab = b - a, ac = c - a, ap = p - a;
+    float d1 = glm::dot(ab, ap), d2 = glm::dot(ac, ap);
+    if (d1 <= 0.0f && d2 <= 0.0f) return glm::dot(ap, ap);
+
+    glm::vec3 bp = p - b;
+    float d3 = glm::dot(ab, bp), d4 = glm::dot(ac, bp);
+    if (d3 >= 0.0f && d4 <= d3) return glm::dot(bp, bp);
+
+    float vc = d1 * d4 - d3 * d2;
+    if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f) {
+        glm::vec3 q = a + ab * (d1 / (d1 - d3));
+        return glm::dot(p - q, p - q);
+    }
+
+    glm::vec3 cp = p - c;
+    float d5 = glm::dot(ab, cp), d6 = glm::dot(ac, cp);
+    if (d6 >= 0.0f && d5 <= d6) return glm::dot(cp, cp);
+
+    float vb = d5 * d2 - d1 * d6;
+    if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f) {
+        glm::vec3 q = a + ac * (d2 / (d2 - d6));
+        return glm::dot(p - q, p - q);
+    }
+
+    float va = d3 * d6 - d5 * d4;
+    if (va <= 0.0f && d4 - d3 >= 0.0f && d5 - d6 >= 0.0f) {
+        glm::vec3 q = b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+        return glm::dot(p - q, p - q);
+    }
+
+    float denom = 1.0f / (va + vb + vc);
+    glm::vec3 q = a + ab * (vb * denom) + ac * (vc * denom);
+    return glm::dot(p - q, p - q);
+}
+
+const uint64_t kEmptyCell = ~0ull;
+
+// Hashed uniform grid over the triangles of a mesh for nearest-surface
+// queries. Cells are about twice the mean edge length, so a query near the
+// surface usually finishes within its own cell or the first ring around it.
+class TriangleGrid
+{
+public:
+    TriangleGrid(const Mesh& mesh)
+        : mVertices(mesh.vertices().data()), mIndices(mesh.indices().data()), mTriangleCount(mesh.triangleCount())
+    {
+        double edgeSum = 0.0;
+        for (size_t t = 0; t < mTriangleCount; ++t) {
+            const int* tri = mIndices + t * 3;
+            edgeSum += glm::length(mVertices[tri[1]] - mVertices[tri[0]]) + glm::length(mVertices[tri[2]] - mVertices[tri[1]])
+                + glm::length(mVertices[tri[0]] - mVertices[tri[2]]);
+        }
+        mCellSize = std::max(2.0f * (float)(edgeSum / std::max<size_t>(3 * mTriangleCount, 1)), 1e-6f);
+
+        std::vector<std::pair<uint64_t, int>> entries;
+        entries.reserve(mTriangleCount * 4);
+        for (size_t t = 0; t < mTriangleCount; ++t) {
+            const int* tri = mIndices + t * 3;
+            glm::vec3 lo = glm::min(mVertices[tri[0]], glm::min(mVertices[tri[1]], mVertices[tri[2]]));
+            glm::vec3 hi = glm::max(mVertices[tri[0]], glm::max(mVertices[tri[1]], mVertices[tri[2]]));
+            glm::ivec3 c0 = cell(lo), c1 = cell(hi);
+            for (int z = c0.z; z <= c1.z; ++z)
+                for (int y = c0.y; y <= c1.y; ++y)
+                    for (int x = c0.x; x <= c1.x; ++x)
+                        entries.push_back(std::make_pair(key(x, y, z), (int)t));
+        }
+        std::sort(entries.begin(), entries.end());
+
+        size_t cellCount = 0;
+        for (size_t i = 0; i < entries.size(); ++i) {
+            if (i == 0 || entries[i].first != entries[i - 1].first) cellCount++;
+        }
+        size_t tableSize = 16;
+        while (tableSize < cellCount * 2) tableSize *= 2;
+        mKeys.assign(tableSize, kEmptyCell);
+        mRanges.resize(tableSize);
+        mTriangles.resize(entries.size());
+        for (size_t i = 0; i < entries.size(); ++i) {
+            mTriangles[i] = entries[i].second;
+            if (i == 0 || entries[i].first != entries[i - 1].first) {
+                size_t slot = hash(entries[i].first);
+                while (mKeys[slot] != kEmptyCell) slot = (slot + 1) & (mKeys.size() - 1);
+                mKeys[slot] = entries[i].first;
+                mRanges[slot] = std::make_pair((int)i, (int)i);
+                mLastSlot = slot;
+            }
+            mRanges[mLastSlot].second = (int)i + 1;
+        }
+    }
+
+    // Distance from p to the nearest triangle.
+    float distance(const glm::vec3& p) const
+    {
+        const int kMaxRing = 8;
+        glm::ivec3 c = cell(p);
+        // Distance from p to the walls of its own cell
+        glm::vec3 inside = p - glm::vec3(c) * mCellSize;
+        glm::vec3 walls = glm::min(inside, glm::vec3(mCellSize) - inside);
+        float margin = std::max(0.0f, std::min(walls.x, std::min(walls.y, walls.z)));
+        float best2 = FLT_MAX;
+        for (int r = 0; r <= kMaxRing; ++r) {
+            for (int z = -r; z <= r; ++z)
+                for (int y = -r; y <= r; ++y)
+                    for (int x = -r; x <= r; ++x) {
+                        if (std::max(abs(x), std::max(abs(y), abs(z))) != r) continue;
+                        // Skip cells that cannot hold anything closer.
+                        glm::vec3 lo = glm::vec3(c + glm::ivec3(x, y, z)) * mCellSize;
+                        glm::vec3 gap = glm::max(glm::max(lo - p, p - (lo + mCellSize)), glm::vec3(0.0f));
+                        if (glm::dot(gap, gap) >= best2) continue;
+                        const std::pair<int, int>* range = find(key(c.x + x, c.y + y, c.z + z));
+                        if (!range) continue;
+                        for (int i = range->first; i < range->second; ++i) {
+                            best2 = std::min(best2, triangle_distance2(p, mTriangles[i]));
+                        }
+                    }
+            // Triangles not seen yet only touch cells beyond ring r.
+            float reach = r * mCellSize + margin;
+            if (best2 <= reach * reach) return sqrtf(best2);
+        }
+
+        for (size_t t = 0; t < mTriangleCount; ++t) best2 = std::min(best2, triangle_distance2(p, (int)t));
+        return sqrtf(best2);
+    }
+
+private:
+    const glm::vec3* mVertices;
+    const int* mIndices;
+    size_t mTriangleCount;
+    float mCellSize;
+    std::vector<int> mTriangles;
+    // Open addressing table: cell key -> range in mTriangles
+    std::vector<uint64_t> mKeys;
+    std::vector<std::pair<int, int>> mRanges;
+    size_t mLastSlot = 0;
+
+    size_t hash(uint64_t key) const
+    {
+        return (size_t)((key * 0x9E3779B97F4A7C15ull) >> 32) & (mKeys.size() - 1);
+    }
+
+    const std::pair<int, int>* find(uint64_t key) const
+    {
+        for (size_t slot = hash(key); mKeys[slot] != kEmptyCell; slot = (slot + 1) & (mKeys.size() - 1)) {
+            if (mKeys[slot] == key) return &mRanges[slot];
+        }
+        return nullptr;
+    }
+
+    glm::ivec3 cell(const glm::vec3& p) const
+    {
+        return glm::ivec3((int)floorf(p.x / mCellSize), (int)floorf(p.y / mCellSize), (int)floorf(p.z / mCellSize));
+    }
+
+    static uint64_t key(int x, int y, int z)
+    {
+        return ((uint64_t)(x & 0x1fffff) << 42) | ((uint64_t)(y & 0x1fffff) << 21) | (uint64_t)(z & 0x1fffff);
+    }
+
+    float triangle_distance2(const glm::vec3& p, int t) const
+    {
+        const int* tri = mIndices + t * 3;
+        return point_triangle_distance2(p, mVertices[tri[0]], mVertices[tri[1]], mVertices[tri[2]]);
+    }
+};
+
+// Largest distance from the vertices of `points` to the surface in `grid`.
+float max_distance_to_surface(const Mesh& points, const TriangleGrid& grid, int numThreads)
+{
+    Span<const glm::vec3> vertices = points.vertices();
+    if (vertices.empty()) return 0.0f;
+    std::vector<float> distances(vertices.size());
+    parallel_for(0, vertices.size(), 4096, numThreads, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) distances[i] = grid.distance(vertices[i]);
+    });
+    return *std::max_element(distances.begin(), distances.end());
+}
+
+} // namespace
+
+Mesh simplify_mesh(const Mesh& mesh, size_t targetTriangles, float* maxQuadricError, const SimplifyOptions& options)
+{
+    if (maxQuadricError) *maxQuadricError = 0.0f;
+    Span<const glm::vec3> source = mesh.vertices();
+    Span<const int> sourceIndices = mesh.indices();
+    if (mesh.empty() || mesh.triangleCount() == 0) return Mesh();
+
+    glm::vec3 lo = source[0], hi = source[0];
+    for (const glm::vec3& p : source) {
+        lo = glm::min(lo, p);
+        hi = glm::max(hi, p);
+    }
+    glm::vec3 extent = hi - lo;
+
+    // 1. Weld coincident vertices and drop the triangles that degenerate.
+    std::vector<int> remap = weld_vertices(source, 1e-6f * std::max(extent.x, std::max(extent.y, extent.z)));
+    std::vector<int> indices;
+    indices.reserve(sourceIndices.size());
+    for (size_t i = 0; i + 2 < sourceIndices.size(); i += 3) {
+        int a = remap[sourceIndices[i]], b = remap[sourceIndices[i + 1]], c = remap[sourceIndices[i + 2]];
+        if (a == b || b == c || c == a) continue;
+        indices.push_back(a);
+        indices.push_back(b);
+        indices.push_back(c);
+    }
+    size_t triangleCount = indices.size() / 3;
+    std::vector<glm::vec3> positions(source.begin(), source.end());
+    double maxError = 0.0;
+
+    // 2. Simplify spatial chunks in parallel with their shared vertices locked.
+    size_t chunkSize = std::max<size_t>(options.trianglesPerChunk, 1);
+    size_t numChunks = (triangleCount + chunkSize - 1) / chunkSize;
+    if (numChunks > 1 && targetTriangles < triangleCount) {
+        std::vector<std::pair<uint32_t, int>> order(triangleCount);
+        for (size_t t = 0; t < triangleCount; ++t) {
+            glm::vec3 centroid = (positions[indices[t * 3]] + positions[indices[t * 3 + 1]] + positions[indices[t * 3 + 2]]) / 3.0f;
+            order[t] = std::make_pair(morton_code(centroid, lo, extent), (int)t);
+        }
+        std::sort(order.begin(), order.end());
+
+        // Chunk that first used each vertex, or -2 once a second chunk does.
+        std::vector<int> owner(positions.size(), -1);
+        for (size_t i = 0; i < triangleCount; ++i) {
+            int chunk = (int)(i / chunkSize);
+            const int* tri = &indices[order[i].second * 3];
+            for (int j = 0; j < 3; ++j) {
+                int& o = owner[tri[j]];
+                if (o == -1) o = chunk;
+                else if (o != chunk) o = -2;
+            }
+        }
+
+        double ratio = (double)targetTriangles / triangleCount;
+        std::vector<std::vector<int>> chunkIndices(numChunks);
+        std::vector<double> chunkErrors(numChunks, 0.0);
+        parallel_for(0, numChunks, 1, options.numThreads, [&](size_t begin, size_t end) {
+            Simplifier simplifier;
+            std::unordered_map<int, int> local;
+            std::vector<int> global;
+            for (size_t c = begin; c < end; ++c) {
+                size_t first = c * chunkSize;
+                size_t last = std::min(triangleCount, first + chunkSize);
+
+                simplifier.triangles.clear();
+                simplifier.vertices.clear();
+                simplifier.maxError = 0.0;
+                local.clear();
+                global.clear();
+                for (size_t i = first; i < last; ++i) {
+                    const int* tri = &indices[order[i].second * 3];
+                    int v[3];
+                    for (int j = 0; j < 3; ++j) {
+                        auto it = local.emplace(tri[j], (int)global.size());
+                        if (it.second) {
+                            Simplifier::Vertex vertex;
+                            vertex.p = glm::dvec3(positions[tri[j]]);
+                            vertex.locked = owner[tri[j]] == -2;
+                            simplifier.vertices.push_back(vertex);
+                            global.push_back(tri[j]);
+                        }
+                        v[j] = it.first->second;
+                    }
+                    simplifier.add_triangle(v[0], v[1], v[2]);
+                }
+
+                simplifier.run((size_t)ceil((last - first) * ratio), options.aggressiveness);
+
+                // Unlocked vertices belong to this chunk alone, so the
+                // moved positions can be written back without a race.
+                for (size_t v = 0; v < global.size(); ++v) {
+                    if (!simplifier.vertices[v].locked) positions[global[v]] = glm::vec3(simplifier.vertices[v].p);
+                }
+                std::vector<int>& out = chunkIndices[c];
+                out.reserve(simplifier.triangles.size() * 3);
+                for (const Simplifier::Triangle& t : simplifier.triangles) {
+                    for (int j = 0; j < 3; ++j) out.push_back(global[t.v[j]]);
+                }
+                chunkErrors[c] = simplifier.maxError;
+            }
+        });
+
+        indices.clear();
+        for (size_t c = 0; c < numChunks; ++c) {
+            indices.insert(indices.end(), chunkIndices[c].begin(), chunkIndices[c].end());
+            maxError = std::max(maxError, chunkErrors[c]);
+        }
+        triangleCount = indices.size() / 3;
+    }
+
+    // 3. Final pass over the whole mesh, chunk borders included.
+    Simplifier simplifier;
+    std::vector<int> local(positions.size(), -1);
+    std::vector<int> global;
+    simplifier.triangles.reserve(triangleCount);
+    for (size_t t = 0; t < triangleCount; ++t) {
+        int v[3];
+        for (int j = 0; j < 3; ++j) {
+            int g = indices[t * 3 + j];
+            if (local[g] < 0) {
+                local[g] = (int)global.size();
+                Simplifier::Vertex vertex;
+                vertex.p = glm::dvec3(positions[g]);
+                simplifier.vertices.push_back(vertex);
+                global.push_back(g);
+            }
+            v[j] = local[g];
+        }
+        simplifier.add_triangle(v[0], v[1], v[2]);
+    }
+    simplifier.run(targetTriangles, options.aggressiveness);
+    maxError = std::max(maxError, simplifier.maxError);
+
+    // 4. Compact the surviving vertices in order of first use.
+    std::vector<int> compact(simplifier.vertices.size(), -1);
+    size_t vertexCount = 0;
+    for (const Simplifier::Triangle& t : simplifier.triangles) {
+        for (int j = 0; j < 3; ++j) {
+            if (compact[t.v[j]] < 0) compact[t.v[j]] = (int)vertexCount++;
+        }
+    }
+    Mesh result(vertexCount, simplifier.triangles.size() * 3);
+    if (result.empty()) return result;
+    Span<glm::vec3> vertices = result.vertices();
+    Span<int> resultIndices = result.indices();
+    for (size_t v = 0; v < compact.size(); ++v) {
+        if (compact[v] >= 0) vertices[compact[v]] = glm::vec3(simplifier.vertices[v].p);
+    }
+    for (size_t t = 0; t < simplifier.triangles.size(); ++t) {
+        for (int j = 0; j < 3; ++j) resultIndices[t * 3 + j] = compact[simplifier.triangles[t].v[j]];
+    }
+
+    if (maxQuadricError) *maxQuadricError = (float)sqrt(std::max(maxError, 0.0));
+    return result;
+}
+
+float measure_simplification_error(const Mesh& source, const Mesh& simplified, int numThreads)
+{
+    if (source.triangleCount() == 0 || simplified.triangleCount() == 0) return 0.0f;
+    TriangleGrid sourceGrid(source);
+    TriangleGrid simplifiedGrid(simplified);
+    return std::max(max_distance_to_surface(source, simplifiedGrid, numThreads),
+        max_distance_to_surface(simplified, sourceGrid, numThreads));
+}
+
+std::vector<LodLevel> build_lod_chain(const Mesh& mesh, const std::vector<float>& ratios, const SimplifyOptions& options)
+{
+    std::vector<LodLevel> levels;
+    levels.emplace_back();
+    levels[0].mesh = copy_mesh(mesh);
+    if (levels[0].mesh.empty()) return levels;
+    TriangleGrid sourceGrid(levels[0].mesh); // shared by the error measurements
+
+    for (float ratio : ratios) {
+        const Mesh& previous = levels.back().mesh;
+        size_t target = (size_t)(mesh.triangleCount() * ratio);
+        if (target == 0 || target >= previous.triangleCount()) continue;
+
+        LodLevel level;
+        auto start = std::chrono::steady_clock::now();
+        level.mesh = simplify_mesh(previous, target, nullptr, options);
+        level.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (level.mesh.empty()) break;
+        level.ratio = (float)level.mesh.triangleCount() / mesh.triangleCount();
+        TriangleGrid levelGrid(level.mesh);
+        level.error = std::max(max_distance_to_surface(mesh, levelGrid, options.numThreads),
+            max_distance_to_surface(level.mesh, sourceGrid, options.numThreads));
+        levels.push_back(std::move(level));
+    }
+    return levels;
+}
+
+std::vector<LodLevel> build_lod_chain(const Mesh& mesh, const SimplifyOptions& options)
+{
+    std::vector<float> ratios = { 0.5f, 0.25f, 0.125f, 0.0625f };
+    return build_lod_chain(mesh, ratios, options);
+}
+
+size_t select_lod(const std::vector<LodLevel>& levels, float pixelError, const glm::mat4& projection,
+    int viewportHeight, float distance, float scale)
+{
+    // Object-space error that projects to pixelError pixels at this depth.
+    float allowed = sphere_error_from_pixels(pixelError, projection, viewportHeight, std::max(distance, 1e-6f), scale);
+    size_t selected = 0;
+    for (size_t i = 1; i < levels.size(); ++i) {
+        if (levels[i].error <= allowed) selected = i;
+    }
+    return selected;
+}
@@ -0,0 +1,54 @@
+#pragma once
+#ifndef MESH_SIMPLIFY_H
+#define MESH_SIMPLIFY_H
+
+#include <stddef.h>
+#include <vector>
+#include <glm/mat4x4.hpp>
+#include "mesh.h"
+
+// Options for simplify_mesh() / build_lod_chain()
+struct SimplifyOptions
+{
+    int numThreads = 0;                // worker threads, 0 = one per hardware thread
+    size_t trianglesPerChunk = 32768;  // size of the spatial chunks simplified in parallel
+    float aggressiveness = 7.0f;       // growth of the collapse threshold per pass
+};
+
+// Quadric error metric edge-collapse simplification down to (about)
+// targetTriangles. Vertices at the same position are welded first, so seams
+// of the generated spheres do not act as borders; open borders are kept.
+//
+// The mesh is cut into spatially compact chunks that are simplified in
+// parallel with the vertices shared between chunks locked, then a final pass
+// over the whole mesh removes what is left along the chunk borders.
+//
+// maxQuadricError receives the largest quadric error (square root, object
+// units) accepted by a collapse. The result is empty() on allocation failure.
+Mesh simplify_mesh(const Mesh& mesh, size_t targetTriangles, float* maxQuadricError = nullptr,
+    const SimplifyOptions& options = SimplifyOptions());
+
+// Symmetric Hausdorff distance between the two surfaces, sampled at the
+// vertices of both meshes (object units).
+float measure_simplification_error(const Mesh& source, const Mesh& simplified, int numThreads = 0);
+
+struct LodLevel
+{
+    Mesh mesh;
+    float ratio = 1.0f;  // triangles relative to the source mesh
+    float error = 0.0f;  // measure_simplification_error() against the source
+    double seconds = 0.0; // time spent simplifying this level
+};
+
+// levels[0] is a copy of the source, followed by one level per ratio (each
+// simplified from the previous one). The default ratios give 50/25/12/6%.
+std::vector<LodLevel> build_lod_chain(const Mesh& mesh, const std::vector<float>& ratios,
+    const SimplifyOptions& options = SimplifyOptions());
+std::vector<LodLevel> build_lod_chain(const Mesh& mesh, const SimplifyOptions& options = SimplifyOptions());
+
+// Coarsest level whose measured error, projected to the screen for an object
+// scaled by `scale` at view depth `distance`, stays within pixelError pixels.
+size_t select_lod(const std::vector<LodLevel>& levels, float pixelError, const glm::mat4& projection,
+    int viewportHeight, float distance, float scale = 1.0f);
+
+#endif // MESH_SIMPLIFY_H
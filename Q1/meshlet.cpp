@@ -0,0 +1,158 @@
+//
+//  meshlet.cpp
+//  Meshlet building and per-cluster frustum / normal cone culling
+//
+
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <glm/glm.hpp>
+#include "meshlet.h"
+
+namespace {
+
+// Bounding sphere and normal cone of the triangles of one meshlet.
+void compute_bounds(Meshlet& m, const glm::vec3* vertices, const int* indices)
+{
+    const int* tri = indices + m.indexOffset;
+    size_t triangleCount = m.indexCount / 3;
+
+    // Sphere: centroid of the corners, radius to the farthest corner.
+    glm::vec3 center(0.0f);
+    for (size_t i = 0; i < m.indexCount; ++i) center += vertices[tri[i]];
+    center /= (float)m.indexCount;
+    float radius = 0.0f;
+    for (size_t i = 0; i < m.indexCount; ++i) radius = std::max(radius, glm::length(vertices[tri[i]] - center));
+    m.center = center;
+    m.radius = radius;
+
+    // Cone: average of the unit triangle normals, widened to contain all.
+    std::vector<glm::vec3> normals;
+    normals.reserve(triangleCount);
+    glm::vec3 axis(0.0f);
+    for (size_t t = 0; t < triangleCount; ++t) {
+        const glm::vec3& a = vertices[tri[3 * t]];
+        const glm::vec3& b = vertices[tri[3 * t + 1]];
+        const glm::vec3& c = vertices[tri[3 * t + 2]];
+        glm::vec3 n = glm::cross(b - a, c - a);
+        float len = glm::length(n);
+        if (len == 0.0f) continue;
+        normals.push_back(n / len);
+        axis += n / len;
+    }
+
+    float axisLength = glm::length(axis);
+    if (normals.empty() || axisLength == 0.0f) {
+        m.coneAxis = glm::vec3(0.0f, 0.0f, 1.0f);
+        m.coneCutoff = 2.0f;
+        return;
+    }
+    axis /= axisLength;
+
+    float minDot = 1.0f;
+    for (const glm::vec3& n : normals) minDot = std::min(minDot, glm::dot(axis, n));
+
+    m.coneAxis = axis;
+    // Cutoff is the sine of the cone half angle; a cone of 90 degrees or
+    // wider can never be entirely backfacing.
+    m.coneCutoff = minDot <= 0.0f ? 2.0f : sqrtf(1.0f - minDot * minDot);
+}
+
+} // namespace
+
+std::vector<Meshlet> build_meshlets(const Mesh& mesh, int maxVertices, int maxTriangles)
+{
+    std::vector<Meshlet> meshlets;
+    Span<const int> indices = mesh.indices();
+    const glm::vec3* vertices = mesh.vertices().data();
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0) return meshlets;
+
+    // Greedy scan in index order: a meshlet closes when the next triangle
+    // would exceed either limit. Triangles are not moved, so every meshlet is
+    // a contiguous index range. marker[v] == id when v is in meshlet id.
+    std::vector<int> marker(mesh.vertexCount(), 0);
+    int id = 1;
+    auto newVertices = [&](const int* tri) {
+        int n = 0;
+        for (int k = 0; k < 3; ++k) {
+            bool repeated = (k > 0 && tri[k] == tri[0]) || (k > 1 && tri[k] == tri[1]);
+            if (marker[tri[k]] != id && !repeated) ++n;
+        }
+        return n;
+    };
+
+    Meshlet current;
+    for (size_t t = 0; t < triangleCount; ++t) {
+        const int* tri = indices.data() + 3 * t;
+        int added = newVertices(tri);
+        if (current.indexCount > 0 &&
+            (current.vertexCount + added > maxVertices || (int)(current.indexCount / 3) >= maxTriangles)) {
+            meshlets.push_back(current);
+            current = Meshlet();
+            current.indexOffset = 3 * t;
+            ++id;
+            added = newVertices(tri);
+        }
+        for (int k = 0; k < 3; ++k) marker[tri[k]] = id;
+        current.vertexCount += added;
+        current.indexCount += 3;
+    }
+    meshlets.push_back(current);
+
+    for (Meshlet& m : meshlets) compute_bounds(m, vertices, indices.data());
+    return meshlets;
+}
+
+Frustum extract_frustum(const glm::mat4& m)
+{
+    // Gribb / Hartmann: rows of the clip matrix combined pairwise.
+    glm::vec4 row0(m[0][0], m[1][0], m[2][0], m[3][0]);
+    glm::vec4 row1(m[0][1], m[1][1], m[2][1], m[3][1]);
+    glm::vec4 row2(m[0][2], m[1][2], m[2][2], m[3][2]);
+    glm::vec4 row3(m[0][3], m[1][3], m[2][3], m[3][3]);
+
+    Frustum f;
+    f.planes[0] = row3 + row0; // left
+    f.planes[1] = row3 - row0; // right
+    f.planes[2] = row3 + row1; // bottom
+    f.planes[3] = row3 - row1; // top
+    f.planes[4] = row3 + row2; // near
+    f.planes[5] = row3 - row2; // far
+    for (glm::vec4& p : f.planes) p /= glm::length(glm::vec3(p));
+    return f;
+}
+
+CullStats cull_meshlets(const std::vector<Meshlet>& meshlets, const Frustum& frustum,
+    const glm::vec3& cameraPosition, std::vector<DrawRange>& ranges)
+{
+    CullStats stats;
+    stats.total = meshlets.size();
+
+    for (const Meshlet& m : meshlets) {
+        bool outside = false;
+        for (const glm::vec4& p : frustum.planes) {
+            if (glm::dot(glm::vec3(p), m.center) + p.w < -m.radius) {
+                outside = true;
+                break;
+            }
+        }
+        if (outside) {
+            stats.frustumCulled++;
+            continue;
+        }
+
+        glm::vec3 toCenter = m.center - cameraPosition;
+        if (glm::dot(toCenter, m.coneAxis) >= m.coneCutoff * glm::length(toCenter) + m.radius) {
+            stats.backfaceCulled++;
+            continue;
+        }
+
+        stats.trianglesDrawn += m.indexCount / 3;
+        if (!ranges.empty() && ranges.back().indexOffset + ranges.back().indexCount == m.indexOffset)
+            ranges.back().indexCount += m.indexCount;
+        else
+            ranges.push_back({ m.indexOffset, m.indexCount });
+    }
+    return stats;
+}
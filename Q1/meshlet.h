@@ -0,0 +1,65 @@
+#pragma once
+#ifndef MESHLET_H
+#define MESHLET_H
+
+#include <stddef.h>
+#include <vector>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+#include <glm/mat4x4.hpp>
+#include "mesh.h"
+
+// A cluster of triangles occupying a contiguous range of the index buffer
+struct Meshlet
+{
+    size_t indexOffset = 0; // first index in the mesh index buffer
+    size_t indexCount = 0;
+    int vertexCount = 0;    // distinct vertices referenced
+
+    // Bounding sphere (object space)
+    glm::vec3 center;
+    float radius = 0.0f;
+
+    // Backface normal cone: the whole meshlet faces away from a camera at c when
+    // dot(center - c, coneAxis) >= coneCutoff * length(center - c) + radius.
+    // coneCutoff > 1 disables the test (normals spread over 90 degrees or more).
+    glm::vec3 coneAxis;
+    float coneCutoff = 2.0f;
+};
+
+// Contiguous range of the index buffer to draw
+struct DrawRange
+{
+    size_t indexOffset;
+    size_t indexCount;
+};
+
+// Splits the mesh into meshlets of at most maxVertices vertices and
+// maxTriangles triangles, each a contiguous range of the index buffer.
+// Triangles are grouped in index order, so run the vertex cache pass first
+// to get spatially compact meshlets.
+std::vector<Meshlet> build_meshlets(const Mesh& mesh, int maxVertices = 64, int maxTriangles = 124);
+
+// Frustum planes (xyz = normal pointing inside, w = distance) extracted from
+// a clip matrix; with projection * view * model they are in object space.
+struct Frustum
+{
+    glm::vec4 planes[6];
+};
+Frustum extract_frustum(const glm::mat4& clipFromObject);
+
+struct CullStats
+{
+    size_t total = 0;
+    size_t frustumCulled = 0;
+    size_t backfaceCulled = 0;
+    size_t trianglesDrawn = 0;
+};
+
+// Appends the index ranges of the meshlets that intersect the frustum and are
+// not entirely backfacing from cameraPosition (object space). Adjacent
+// surviving meshlets are merged into one range.
+CullStats cull_meshlets(const std::vector<Meshlet>& meshlets, const Frustum& frustum,
+    const glm::vec3& cameraPosition, std::vector<DrawRange>& ranges);
+
+#endif // MESHLET_H
@@ -0,0 +1,166 @@
+//
+//  multi_draw.cpp
+//  Indirect multi-draw batching of heterogeneous meshes
+//
+
+#include <stdio.h>
+#include <algorithm>
+#include "gl_extensions.h"
+#include "gl_state.h"
+#include "multi_draw.h"
+
+MultiDrawBatch::~MultiDrawBatch()
+{
+    destroy();
+}
+
+size_t MultiDrawBatch::addMesh(const Mesh& mesh)
+{
+    BatchMesh entry;
+    entry.firstIndex = (uint32_t)mIndices.size();
+    entry.indexCount = (uint32_t)mesh.indexCount();
+    entry.baseVertex = (int32_t)mVertices.size();
+    mVertices.insert(mVertices.end(), mesh.vertices().begin(), mesh.vertices().end());
+    mIndices.insert(mIndices.end(), mesh.indices().begin(), mesh.indices().end());
+    mMeshes.push_back(entry);
+    return mMeshes.size() - 1;
+}
+
+bool MultiDrawBatch::create(size_t maxDraws)
+{
+    destroy();
+    const GLExtensions& ext = gl_extensions();
+    if (!ext.baseInstance || mMeshes.empty()) {
+        fprintf(stderr, "Multi-draw batching needs GL 4.2 (ARB_base_instance)\n");
+        return false;
+    }
+    mMultiDraw = ext.multiDrawElementsIndirect != nullptr;
+    // gl_DrawIDARB counts the draws of one multi-draw call, so it only
+    // replaces the attribute when the commands go out together.
+    mDrawIdBuiltin = mMultiDraw && ext.shaderDrawParameters;
+    mMaxDraws = maxDraws;
+
+    glGenVertexArrays(1, &mVAO);
+    glBindVertexArray(mVAO);
+
+    glGenBuffers(1, &mVertexBuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, mVertexBuffer);
+    glBufferData(GL_ARRAY_BUFFER, mVertices.size() * sizeof(glm::vec3), mVertices.data(), GL_STATIC_DRAW);
+    // Unit spheres: the position doubles as the normal.
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)0);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)0);
+    glEnableVertexAttribArray(1);
+
+    glGenBuffers(1, &mIndexBuffer);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mIndexBuffer);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, mIndices.size() * sizeof(int), mIndices.data(), GL_STATIC_DRAW);
+
+    // Draw id attribute: element i holds i, and each command selects its
+    // element through baseInstance with a divisor of 1.
+    std::vector<uint32_t> drawIds(maxDraws);
+    for (size_t i = 0; i < maxDraws; ++i) drawIds[i] = (uint32_t)i;
+    glGenBuffers(1, &mDrawIdBuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, mDrawIdBuffer);
+    glBufferData(GL_ARRAY_BUFFER, drawIds.size() * sizeof(uint32_t), drawIds.data(), GL_STATIC_DRAW);
+    glVertexAttribIPointer(2, 1, GL_UNSIGNED_INT, sizeof(uint32_t), (void*)0);
+    glEnableVertexAttribArray(2);
+    glVertexAttribDivisor(2, 1);
+    glBindVertexArray(0);
+
+    glGenBuffers(1, &mCommandBuffer);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, mCommandBuffer);
+    glBufferData(GL_DRAW_INDIRECT_BUFFER, maxDraws * sizeof(DrawElementsIndirectCommand), nullptr, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+    glGenBuffers(1, &mDrawDataBuffer);
+    glBindBuffer(GL_TEXTURE_BUFFER, mDrawDataBuffer);
+    glBufferData(GL_TEXTURE_BUFFER, maxDraws * sizeof(BatchDrawData), nullptr, GL_DYNAMIC_DRAW);
+    glGenTextures(1, &mDrawDataTexture);
+    glBindTexture(GL_TEXTURE_BUFFER, mDrawDataTexture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, mDrawDataBuffer);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+    mCommands.reserve(maxDraws);
+    mDrawData.reserve(maxDraws);
+    mDirty = true;
+    return true;
+}
+
+void MultiDrawBatch::destroy()
+{
+    GLStateCache& state = gl_state();
+    if (mVAO != 0) state.deleteVertexArrays(1, &mVAO);
+    unsigned int buffers[] = { mVertexBuffer, mIndexBuffer, mDrawIdBuffer, mCommandBuffer, mDrawDataBuffer };
+    for (unsigned int buffer : buffers) {
+        if (buffer != 0) state.deleteBuffers(1, &buffer);
+    }
+    if (mDrawDataTexture != 0) state.deleteTextures(1, &mDrawDataTexture);
+    mVAO = mVertexBuffer = mIndexBuffer = mDrawIdBuffer = mCommandBuffer = mDrawDataBuffer = mDrawDataTexture = 0;
+    mMaxDraws = 0;
+}
+
+std::string MultiDrawBatch::shaderDefines() const
+{
+    return std::string("#define USE_DRAW_ID ") + (mDrawIdBuiltin ? "1" : "0") + "\n";
+}
+
+void MultiDrawBatch::clear()
+{
+    mCommands.clear();
+    mDrawData.clear();
+    mDirty = true;
+}
+
+bool MultiDrawBatch::add(size_t mesh, const glm::vec3& position, float scale, uint32_t material)
+{
+    if (mCommands.size() >= mMaxDraws || mesh >= mMeshes.size()) return false;
+    const BatchMesh& source = mMeshes[mesh];
+    DrawElementsIndirectCommand command;
+    command.count = source.indexCount;
+    command.instanceCount = 1;
+    command.firstIndex = source.firstIndex;
+    command.baseVertex = source.baseVertex;
+    command.baseInstance = (uint32_t)mCommands.size();
+    mCommands.push_back(command);
+
+    BatchDrawData data;
+    data.positionScale = glm::vec4(position, scale);
+    data.material = glm::vec4((float)material, 0.0f, 0.0f, 0.0f);
+    mDrawData.push_back(data);
+    mDirty = true;
+    return true;
+}
+
+size_t MultiDrawBatch::submit()
+{
+    if (mVAO == 0 || mCommands.empty()) return 0;
+    // Bindings are left in place; from the second frame on the cache skips them.
+    GLStateCache& state = gl_state();
+    state.bindBuffer(GL_DRAW_INDIRECT_BUFFER, mCommandBuffer);
+    if (mDirty) {
+        glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, mCommands.size() * sizeof(DrawElementsIndirectCommand),
+            mCommands.data());
+        state.bindBuffer(GL_TEXTURE_BUFFER, mDrawDataBuffer);
+        glBufferSubData(GL_TEXTURE_BUFFER, 0, mDrawData.size() * sizeof(BatchDrawData), mDrawData.data());
+        mDirty = false;
+    }
+
+    state.bindVertexArray(mVAO);
+    state.bindTexture(0, GL_TEXTURE_BUFFER, mDrawDataTexture);
+    size_t drawCalls = 0;
+    if (mMultiDraw) {
+        gl_extensions().multiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (const void*)0,
+            (GLsizei)mCommands.size(), 0);
+        drawCalls = 1;
+    }
+    else {
+        for (size_t i = 0; i < mCommands.size(); ++i) {
+            glDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT,
+                (const void*)(i * sizeof(DrawElementsIndirectCommand)));
+        }
+        drawCalls = mCommands.size();
+    }
+    return drawCalls;
+}
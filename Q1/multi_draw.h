@@ -0,0 +1,102 @@
+#pragma once
+#ifndef MULTI_DRAW_H
+#define MULTI_DRAW_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+#include "mesh.h"
+
+// Command layout read by glDrawElementsIndirect / glMultiDrawElementsIndirect
+struct DrawElementsIndirectCommand
+{
+    uint32_t count;
+    uint32_t instanceCount;
+    uint32_t firstIndex;
+    int32_t baseVertex;
+    uint32_t baseInstance; // the draw id for PhongMultiDraw.vert
+};
+
+// Per-draw data fetched by draw id in PhongMultiDraw.vert: two RGBA32F texels
+struct BatchDrawData
+{
+    glm::vec4 positionScale; // position (xyz), scale (w)
+    glm::vec4 material;      // material index (x)
+};
+
+// Where one mesh lives in the shared vertex / index buffers
+struct BatchMesh
+{
+    uint32_t firstIndex = 0;
+    uint32_t indexCount = 0;
+    int32_t baseVertex = 0;
+};
+
+// Draws many objects of different meshes with one glMultiDrawElementsIndirect.
+// All meshes share one VAO; each draw is an indirect command plus a
+// BatchDrawData record reached through the draw id. Without
+// glMultiDrawElementsIndirect the same commands go out one
+// glDrawElementsIndirect at a time.
+class MultiDrawBatch
+{
+public:
+    MultiDrawBatch() = default;
+    ~MultiDrawBatch();
+    MultiDrawBatch(const MultiDrawBatch&) = delete;
+    MultiDrawBatch& operator=(const MultiDrawBatch&) = delete;
+
+    // Meshes are added before create(); returns the mesh index.
+    size_t addMesh(const Mesh& mesh);
+    const BatchMesh& mesh(size_t index) const { return mMeshes[index]; }
+    size_t meshCount() const { return mMeshes.size(); }
+
+    // Uploads the meshes and sizes the command / draw data buffers for up
+    // to maxDraws draws. Needs GL 4.2 (baseInstance of indirect commands);
+    // load_gl_extensions() must have run. Returns false when unsupported.
+    bool create(size_t maxDraws);
+    void destroy();
+
+    // Defines for PhongMultiDraw.vert matching what submit() will use
+    std::string shaderDefines() const;
+    bool usesMultiDraw() const { return mMultiDraw; }
+    bool usesDrawIdBuiltin() const { return mDrawIdBuiltin; }
+
+    // Rebuilds the draw list; add() returns false once maxDraws is reached.
+    void clear();
+    bool add(size_t mesh, const glm::vec3& position, float scale, uint32_t material);
+    size_t drawCount() const { return mCommands.size(); }
+
+    // Uploads the draw list if it changed and draws it with the batch's VAO
+    // and draw data texture bound (program already in use). Returns the
+    // number of GL draw calls issued.
+    size_t submit();
+
+    // VAO holding every mesh, for drawing them one by one with
+    // glDrawElementsBaseVertex and mesh()
+    unsigned int vertexArray() const { return mVAO; }
+
+private:
+    std::vector<glm::vec3> mVertices;
+    std::vector<int> mIndices;
+    std::vector<BatchMesh> mMeshes;
+
+    std::vector<DrawElementsIndirectCommand> mCommands;
+    std::vector<BatchDrawData> mDrawData;
+    size_t mMaxDraws = 0;
+    bool mDirty = true;
+    bool mMultiDraw = false;
+    bool mDrawIdBuiltin = false;
+
+    unsigned int mVAO = 0;
+    unsigned int mVertexBuffer = 0;
+    unsigned int mIndexBuffer = 0;
+    unsigned int mDrawIdBuffer = 0;
+    unsigned int mCommandBuffer = 0;
+    unsigned int mDrawDataBuffer = 0;
+    unsigned int mDrawDataTexture = 0;
+};
+
+#endif // MULTI_DRAW_H
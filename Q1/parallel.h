@@ -0,0 +1,48 @@
+#pragma once
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+// Number of worker threads to use when the caller passes 0 (= automatic).
+inline int resolve_thread_count(int requested)
+{
+    if (requested > 0) return requested;
+    unsigned int hw = std::thread::hardware_concurrency();
+    return hw > 0 ? (int)hw : 1;
+}
+
+// Splits [begin, end) into contiguous chunks of at least `grain` items and
+// runs fn(chunkBegin, chunkEnd) on up to `numThreads` threads.
+// The calling thread processes the first chunk itself.
+template <typename Fn>
+void parallel_for(size_t begin, size_t end, size_t grain, int numThreads, Fn fn)
+{
+    if (end <= begin) return;
+    size_t count = end - begin;
+    if (grain == 0) grain = 1;
+
+    size_t maxChunks = (count + grain - 1) / grain;
+    size_t numChunks = std::min((size_t)resolve_thread_count(numThreads), maxChunks);
+    if (numChunks <= 1) {
+        fn(begin, end);
+        return;
+    }
+
+    size_t chunkSize = (count + numChunks - 1) / numChunks;
+    std::vector<std::thread> workers;
+    workers.reserve(numChunks - 1);
+    for (size_t c = 1; c < numChunks; ++c) {
+        size_t b = begin + c * chunkSize;
+        size_t e = std::min(end, b + chunkSize);
+        if (b >= e) break;
+        workers.emplace_back([=]() { fn(b, e); });
+    }
+    fn(begin, std::min(end, begin + chunkSize));
+
+    for (std::thread& w : workers) w.join();
+}
+
+#endif // PARALLEL_H
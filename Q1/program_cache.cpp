@@ -0,0 +1,211 @@
+//
+//  program_cache.cpp
+//  On-disk cache of linked program binaries
+//
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <fstream>
+#include "program_cache.h"
+#include "frame_timing.h"
+#include "fnv_hash.h"
+
+#ifdef _WIN32
+#include <direct.h>
+#endif
+
+namespace {
+
+const char kMagic[8] = { 'P', 'R', 'O', 'G', 'B', 'I', 'N', '1' };
+
+// Fixed-size header in front of every binary
+struct BinaryHeader
+{
+    char magic[8];
+    uint64_t key;
+    uint64_t checksum; // FNV-1a of the binary
+    uint32_t format;   // binaryFormat of glGetProgramBinary
+    uint32_t length;
+};
+
+uint64_t fnv1a_string(uint64_t hash, const char* text)
+{
+    if (text == nullptr) text = "";
+    // The terminator too, so "ab" + "c" and "a" + "bc" differ.
+    return fnv1a(hash, text, strlen(text) + 1);
+}
+
+bool make_directory(const std::string& directory)
+{
+#ifdef _WIN32
+    int result = _mkdir(directory.c_str());
+#else
+    int result = mkdir(directory.c_str(), 0755);
+#endif
+    return result == 0 || errno == EEXIST;
+}
+
+} // namespace
+
+ProgramBinaryCache& program_cache()
+{
+    static ProgramBinaryCache cache;
+    return cache;
+}
+
+bool ProgramBinaryCache::open(const std::string& directory)
+{
+    close();
+    GLint formats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    if (formats <= 0) {
+        fprintf(stderr, "Program cache disabled: the driver offers no program binary format\n");
+        return false;
+    }
+    if (directory.empty() || !make_directory(directory)) {
+        fprintf(stderr, "Program cache disabled: cannot create %s\n", directory.c_str());
+        return false;
+    }
+
+    uint64_t hash = kFnvOffset;
+    hash = fnv1a_string(hash, reinterpret_cast<const char*>(glGetString(GL_VENDOR)));
+    hash = fnv1a_string(hash, reinterpret_cast<const char*>(glGetString(GL_RENDERER)));
+    hash = fnv1a_string(hash, reinterpret_cast<const char*>(glGetString(GL_VERSION)));
+    hash = fnv1a_string(hash, reinterpret_cast<const char*>(glGetString(GL_SHADING_LANGUAGE_VERSION)));
+    std::vector<GLint> formatList((size_t)formats);
+    glGetIntegerv(GL_PROGRAM_BINARY_FORMATS, formatList.data());
+    hash = fnv1a(hash, formatList.data(), formatList.size() * sizeof(GLint));
+
+    mDirectory = directory;
+    mDriverHash = hash;
+    mEnabled = true;
+    return true;
+}
+
+void ProgramBinaryCache::close()
+{
+    mEnabled = false;
+    mDirectory.clear();
+    mDriverHash = 0;
+}
+
+uint64_t ProgramBinaryCache::key(const std::vector<ProgramStage>& stages) const
+{
+    uint64_t hash = mDriverHash;
+    for (const ProgramStage& stage : stages) {
+        hash = fnv1a(hash, &stage.type, sizeof(stage.type));
+        hash = fnv1a_string(hash, stage.source != nullptr ? stage.source->c_str() : "");
+    }
+    return hash;
+}
+
+std::string ProgramBinaryCache::path(uint64_t key) const
+{
+    char name[32];
+    snprintf(name, sizeof(name), "/%016llx.bin", (unsigned long long)key);
+    return mDirectory + name;
+}
+
+GLuint ProgramBinaryCache::load(uint64_t key)
+{
+    if (!mEnabled) return 0;
+    double start = steady_seconds();
+    std::string file = path(key);
+    std::ifstream in(file, std::ios::binary);
+    if (!in.is_open()) {
+        mStats.misses++;
+        return 0;
+    }
+    BinaryHeader header;
+    std::vector<unsigned char> binary;
+    bool ok = in.read(reinterpret_cast<char*>(&header), sizeof(header)) &&
+        memcmp(header.magic, kMagic, sizeof(kMagic)) == 0 && header.key == key && header.length > 0;
+    if (ok) {
+        binary.resize(header.length);
+        ok = in.read(reinterpret_cast<char*>(binary.data()), (std::streamsize)binary.size()) &&
+            fnv1a(kFnvOffset, binary.data(), binary.size()) == header.checksum;
+    }
+    in.close();
+
+    GLuint program = 0;
+    if (ok) {
+        program = glCreateProgram();
+        glProgramBinary(program, (GLenum)header.format, binary.data(), (GLsizei)binary.size());
+        GLint linked = GL_FALSE;
+        glGetProgramiv(program, GL_LINK_STATUS, &linked);
+        if (linked == GL_FALSE) {
+            glDeleteProgram(program);
+            program = 0;
+        }
+    }
+    if (program == 0) {
+        // Truncated, corrupt or no longer accepted by the driver
+        remove(key);
+        mStats.rejected++;
+        return 0;
+    }
+    mStats.hits++;
+    mStats.bytes += binary.size();
+    mStats.loadMs += (steady_seconds() - start) * 1e3;
+    return program;
+}
+
+void ProgramBinaryCache::prepare(GLuint program) const
+{
+    if (mEnabled) glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+}
+
+bool ProgramBinaryCache::store(uint64_t key, GLuint program)
+{
+    if (!mEnabled || program == 0) return false;
+    double start = steady_seconds();
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) return false;
+    std::vector<unsigned char> binary((size_t)length);
+    GLenum format = 0;
+    GLsizei written = 0;
+    glGetProgramBinary(program, length, &written, &format, binary.data());
+    if (written <= 0) return false;
+    binary.resize((size_t)written);
+
+    BinaryHeader header;
+    memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.key = key;
+    header.checksum = fnv1a(kFnvOffset, binary.data(), binary.size());
+    header.format = (uint32_t)format;
+    header.length = (uint32_t)binary.size();
+
+    std::string file = path(key);
+    std::string temporary = file + ".tmp";
+    std::ofstream out(temporary, std::ios::binary);
+    if (!out.is_open()) {
+        fprintf(stderr, "Failed to open %s for writing\n", temporary.c_str());
+        return false;
+    }
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(binary.data()), (std::streamsize)binary.size());
+    out.close();
+    bool ok = !out.fail();
+#ifdef _WIN32
+    // rename() does not replace an existing file on Windows.
+    if (ok) ::remove(file.c_str());
+#endif
+    ok = ok && rename(temporary.c_str(), file.c_str()) == 0;
+    if (!ok) {
+        fprintf(stderr, "Failed to write %s\n", file.c_str());
+        ::remove(temporary.c_str());
+        return false;
+    }
+    mStats.stores++;
+    mStats.bytes += binary.size();
+    mStats.storeMs += (steady_seconds() - start) * 1e3;
+    return true;
+}
+
+void ProgramBinaryCache::remove(uint64_t key) const
+{
+    if (!mDirectory.empty()) ::remove(path(key).c_str());
+}
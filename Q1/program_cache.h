@@ -0,0 +1,79 @@
+#pragma once
+#ifndef PROGRAM_CACHE_H
+#define PROGRAM_CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <GL/glew.h>
+
+// One shader stage of a program, with its #defines already injected
+struct ProgramStage
+{
+    GLenum type = 0; // GL_VERTEX_SHADER, ...
+    const std::string* source = nullptr;
+};
+
+struct ProgramCacheStats
+{
+    size_t hits = 0;     // programs created from a cached binary
+    size_t misses = 0;   // no binary on disk for the key
+    size_t rejected = 0; // binaries the driver refused (deleted, then rebuilt)
+    size_t stores = 0;   // binaries written
+    double loadMs = 0.0; // file read + glProgramBinary of the hits
+    double storeMs = 0.0;
+    size_t bytes = 0;    // binary bytes loaded and stored
+};
+
+// Linked program binaries on disk (glGetProgramBinary / glProgramBinary),
+// so a second start skips compiling and linking. A program's key is an
+// FNV-1a hash of its stage types and sources and of the driver identity
+// (GL_VENDOR, GL_RENDERER, GL_VERSION, GL_SHADING_LANGUAGE_VERSION and the
+// binary formats offered), so a driver update or an edited shader simply
+// misses. The driver may still refuse a binary (it is free to invalidate
+// them at any time); load() then deletes the file and the caller compiles
+// as usual.
+//
+// Each program is one file "<key>.bin" in the directory: a header with the
+// key, binary format, length and an FNV-1a checksum, then the binary.
+// Files are written to a temporary name and renamed, so a crash leaves no
+// half-written entry behind.
+class ProgramBinaryCache
+{
+public:
+    // Needs a current context. Creates the directory if needed. Returns
+    // false and stays disabled when the driver offers no binary format.
+    bool open(const std::string& directory);
+    void close();
+    bool enabled() const { return mEnabled; }
+    const std::string& directory() const { return mDirectory; }
+
+    uint64_t key(const std::vector<ProgramStage>& stages) const;
+
+    // A linked program from the cached binary; 0 on a miss or a refused
+    // binary.
+    GLuint load(uint64_t key);
+    // Call between glCreateProgram and glLinkProgram of a program that will
+    // be stored, so the driver keeps its binary retrievable.
+    void prepare(GLuint program) const;
+    bool store(uint64_t key, GLuint program);
+    // Deletes the binary of key, if any (cold starts in the report).
+    void remove(uint64_t key) const;
+
+    ProgramCacheStats stats() const { return mStats; }
+    void resetStats() { mStats = ProgramCacheStats(); }
+
+private:
+    std::string path(uint64_t key) const;
+
+    bool mEnabled = false;
+    std::string mDirectory;
+    uint64_t mDriverHash = 0;
+    ProgramCacheStats mStats;
+};
+
+// The viewer's cache; disabled until open()ed.
+ProgramBinaryCache& program_cache();
+
+#endif // PROGRAM_CACHE_H
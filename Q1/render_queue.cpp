@@ -0,0 +1,146 @@
+//
+//  render_queue.cpp
+//  Sort-key render queue with an LSD radix sort
+//
+
+#include <string.h>
+#include <algorithm>
+#include "render_queue.h"
+#include "gl_state.h"
+
+namespace {
+
+uint64_t field(uint32_t value, int bits)
+{
+    return (uint64_t)value & ((1ull << bits) - 1);
+}
+
+// Counts the packets whose state differs from the one before; the first
+// packet binds everything.
+void count_change(const DrawPacket& packet, const DrawPacket* previous, RenderQueueStats& stats)
+{
+    if (previous == nullptr || packet.program != previous->program) stats.programChanges++;
+    if (previous == nullptr || packet.vertexArray != previous->vertexArray) stats.vertexArrayChanges++;
+    if (previous == nullptr || packet.material != previous->material) stats.materialChanges++;
+}
+
+} // namespace
+
+uint64_t make_sort_key(uint32_t layer, uint32_t program, uint32_t material, uint32_t mesh, float depth)
+{
+    const uint32_t maxDepth = (1u << kSortKeyDepthBits) - 1;
+    // In double: 1.0f * maxDepth + 0.5f rounds up to 1 << kSortKeyDepthBits
+    // in float and would carry into the mesh field.
+    double clamped = std::min(std::max((double)depth, 0.0), 1.0);
+    uint64_t key = field(layer, kSortKeyLayerBits);
+    key = key << kSortKeyProgramBits | field(program, kSortKeyProgramBits);
+    key = key << kSortKeyMaterialBits | field(material, kSortKeyMaterialBits);
+    key = key << kSortKeyMeshBits | field(mesh, kSortKeyMeshBits);
+    key = key << kSortKeyDepthBits | field((uint32_t)(clamped * maxDepth + 0.5), kSortKeyDepthBits);
+    return key;
+}
+
+void RenderQueue::reserve(size_t packets)
+{
+    mPackets.reserve(packets);
+    mOrder.reserve(packets);
+    mScratch.reserve(packets);
+}
+
+void RenderQueue::clear()
+{
+    mPackets.clear();
+    mOrder.clear();
+}
+
+void RenderQueue::submit(const DrawPacket& packet)
+{
+    mOrder.push_back({ packet.key, (uint64_t)mPackets.size() });
+    mPackets.push_back(packet);
+}
+
+void RenderQueue::sort()
+{
+    const size_t n = mOrder.size();
+    if (n < 2) return;
+
+    // All eight byte histograms in one pass over the keys.
+    size_t counts[8][256];
+    memset(counts, 0, sizeof(counts));
+    for (const SortEntry& entry : mOrder) {
+        for (int pass = 0; pass < 8; ++pass) {
+            counts[pass][(entry.key >> (pass * 8)) & 0xFF]++;
+        }
+    }
+
+    mScratch.resize(n);
+    SortEntry* source = mOrder.data();
+    SortEntry* target = mScratch.data();
+    for (int pass = 0; pass < 8; ++pass) {
+        size_t* count = counts[pass];
+        const int shift = pass * 8;
+        if (count[(source[0].key >> shift) & 0xFF] == n) continue;
+
+        size_t offset = 0;
+        for (int digit = 0; digit < 256; ++digit) {
+            size_t c = count[digit];
+            count[digit] = offset;
+            offset += c;
+        }
+        for (size_t i = 0; i < n; ++i) {
+            target[count[(source[i].key >> shift) & 0xFF]++] = source[i];
+        }
+        std::swap(source, target);
+    }
+    if (source != mOrder.data()) mOrder.swap(mScratch);
+}
+
+RenderQueueStats RenderQueue::stateChanges() const
+{
+    RenderQueueStats stats;
+    stats.packets = mOrder.size();
+    const DrawPacket* previous = nullptr;
+    for (size_t i = 0; i < mOrder.size(); ++i) {
+        const DrawPacket& current = packet(i);
+        count_change(current, previous, stats);
+        previous = &current;
+    }
+    return stats;
+}
+
+RenderQueueStats RenderQueue::execute(MaterialCallback setMaterial, void* user)
+{
+    GLStateCache& state = gl_state();
+    RenderQueueStats stats;
+    stats.packets = mOrder.size();
+    const DrawPacket* previous = nullptr;
+    for (size_t i = 0; i < mOrder.size(); ++i) {
+        const DrawPacket& p = packet(i);
+        count_change(p, previous, stats);
+        state.useProgram(p.program);
+        state.bindVertexArray(p.vertexArray);
+        if (setMaterial != nullptr && (previous == nullptr || p.material != previous->material)) {
+            setMaterial(p.material, user);
+        }
+        previous = &p;
+
+        if (p.draw != nullptr) {
+            stats.drawCalls += p.draw(p, p.user);
+        }
+        else if (p.indexType == 0) {
+            if (p.instances > 0) glDrawArraysInstanced(p.mode, (GLint)p.first, p.count, p.instances);
+            else glDrawArrays(p.mode, (GLint)p.first, p.count);
+            stats.drawCalls++;
+        }
+        else {
+            if (p.instances > 0) {
+                glDrawElementsInstanced(p.mode, p.count, p.indexType, (const void*)p.first, p.instances);
+            }
+            else {
+                glDrawElements(p.mode, p.count, p.indexType, (const void*)p.first);
+            }
+            stats.drawCalls++;
+        }
+    }
+    return stats;
+}
@@ -0,0 +1,93 @@
+#pragma once
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+#include <GL/glew.h>
+
+// 64-bit sort key, most significant field first:
+//
+//     layer 4 | program 10 | material 12 | mesh 14 | depth 24
+//
+// so sorting groups packets by layer, then by the most expensive state to
+// switch, and orders each group front to back for early-Z. Ids wider than
+// their field are masked; a collision only costs an extra bind. depth is
+// the view depth scaled to [0, 1]; translucent layers pass 1 - depth to
+// draw back to front.
+const int kSortKeyLayerBits = 4;
+const int kSortKeyProgramBits = 10;
+const int kSortKeyMaterialBits = 12;
+const int kSortKeyMeshBits = 14;
+const int kSortKeyDepthBits = 24;
+
+uint64_t make_sort_key(uint32_t layer, uint32_t program, uint32_t material, uint32_t mesh, float depth);
+
+// One draw with the state it needs. The queue binds program and VAO through
+// gl_state(), tells the material callback about material changes and then
+// issues the draw, or calls draw when the packet needs something else.
+struct DrawPacket
+{
+    uint64_t key = 0;
+    GLuint program = 0;
+    GLuint vertexArray = 0;
+    GLenum mode = GL_TRIANGLES;
+    GLenum indexType = 0;   // 0 = glDrawArrays
+    GLsizei count = 0;      // indices, or vertices without an index type
+    size_t first = 0;       // byte offset of the first index, or first vertex
+    GLsizei instances = 0;  // > 0 = instanced draw
+    uint32_t material = 0;
+
+    // Custom draw after the state is bound; returns the draw calls it made.
+    size_t (*draw)(const DrawPacket& packet, void* user) = nullptr;
+    void* user = nullptr;
+};
+
+struct RenderQueueStats
+{
+    size_t packets = 0;
+    size_t programChanges = 0;
+    size_t vertexArrayChanges = 0;
+    size_t materialChanges = 0;
+    size_t drawCalls = 0;
+};
+
+// Packets are submitted in any order, radix-sorted by key once per frame
+// and executed in key order. Sorting moves 16-byte (key, index) pairs, not
+// the packets.
+class RenderQueue
+{
+public:
+    using MaterialCallback = void (*)(uint32_t material, void* user);
+
+    void reserve(size_t packets);
+    void clear();
+    void submit(const DrawPacket& packet);
+    size_t size() const { return mPackets.size(); }
+
+    // LSD radix sort, 8 bits per pass; passes whose byte is the same in
+    // every key are skipped. Stable, so equal keys keep submission order.
+    void sort();
+    // The i-th packet in the current order (submission order until sort())
+    const DrawPacket& packet(size_t i) const { return mPackets[mOrder[i].index]; }
+
+    // Binds and changes the current order would cost, without touching GL
+    RenderQueueStats stateChanges() const;
+    // Needs a current context. setMaterial runs before the first packet and
+    // whenever the material changes.
+    RenderQueueStats execute(MaterialCallback setMaterial = nullptr, void* user = nullptr);
+
+private:
+    struct SortEntry
+    {
+        uint64_t key;
+        uint64_t index;
+    };
+
+    std::vector<DrawPacket> mPackets;
+    std::vector<SortEntry> mOrder;
+    std::vector<SortEntry> mScratch;
+};
+
+#endif // RENDER_QUEUE_H
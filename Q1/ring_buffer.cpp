@@ -0,0 +1,155 @@
+//
+//  ring_buffer.cpp
+//  Fenced per-frame ring allocator on a persistently mapped buffer
+//
+
+#include <stdio.h>
+#include <algorithm>
+#include "gl_extensions.h"
+#include "gl_state.h"
+#include "ring_buffer.h"
+#include "frame_timing.h"
+
+namespace {
+
+size_t align_up(size_t value, size_t alignment)
+{
+    return alignment > 1 ? (value + alignment - 1) / alignment * alignment : value;
+}
+
+} // namespace
+
+double wait_fence(GLsync& fence)
+{
+    // Poll first; only a fence that is still pending counts as a stall.
+    double stallMs = 0.0;
+    GLenum status = glClientWaitSync(fence, 0, 0);
+    if (status == GL_TIMEOUT_EXPIRED) {
+        double waitStart = steady_seconds();
+        do {
+            status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000ull);
+        } while (status == GL_TIMEOUT_EXPIRED);
+        stallMs = (steady_seconds() - waitStart) * 1e3;
+    }
+    glDeleteSync(fence);
+    fence = nullptr;
+    return stallMs;
+}
+
+FrameRingBuffer::~FrameRingBuffer()
+{
+    destroy();
+}
+
+bool FrameRingBuffer::create(size_t frameSize, int frames)
+{
+    destroy();
+    if (frameSize == 0 || frames <= 0) return false;
+
+    GLint uniformAlignment = 256;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &uniformAlignment);
+    mUniformAlignment = (size_t)std::max(uniformAlignment, 16);
+    // Every segment starts on a uniform-aligned offset.
+    mFrameSize = align_up(frameSize, mUniformAlignment);
+    const size_t totalSize = mFrameSize * frames;
+    mFences.assign((size_t)frames, nullptr);
+
+    glGenBuffers(1, &mBuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, mBuffer);
+    const GLExtensions& ext = gl_extensions();
+    if (ext.bufferStorage != nullptr) {
+        const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        ext.bufferStorage(GL_ARRAY_BUFFER, (GLsizeiptr)totalSize, nullptr, flags);
+        mMapped = (unsigned char*)glMapBufferRange(GL_ARRAY_BUFFER, 0, (GLsizeiptr)totalSize, flags);
+    }
+    else {
+        glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)totalSize, nullptr, GL_STREAM_DRAW);
+        mShadow.resize(totalSize);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    if (ext.bufferStorage != nullptr && mMapped == nullptr) {
+        fprintf(stderr, "Failed to map the ring buffer persistently\n");
+        destroy();
+        return false;
+    }
+    return true;
+}
+
+void FrameRingBuffer::destroy()
+{
+    for (GLsync& fence : mFences) {
+        if (fence != nullptr) glDeleteSync(fence);
+    }
+    mFences.clear();
+    if (mBuffer != 0) {
+        if (mMapped != nullptr) {
+            glBindBuffer(GL_ARRAY_BUFFER, mBuffer);
+            glUnmapBuffer(GL_ARRAY_BUFFER);
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+        }
+        gl_state().deleteBuffers(1, &mBuffer);
+    }
+    mBuffer = 0;
+    mMapped = nullptr;
+    mShadow.clear();
+    mFrameSize = 0;
+    mSegment = -1;
+    mHead = mFlushed = 0;
+}
+
+void FrameRingBuffer::beginFrame()
+{
+    if (mFences.empty()) return;
+    mSegment = (mSegment + 1) % (int)mFences.size();
+    GLsync& fence = mFences[mSegment];
+    if (fence != nullptr) {
+        double stallMs = wait_fence(fence);
+        if (stallMs > 0.0) {
+            mStats.stalls++;
+            mStats.stallMs += stallMs;
+        }
+    }
+    mHead = mFlushed = (size_t)mSegment * mFrameSize;
+    mStats.frames++;
+}
+
+RingAllocation FrameRingBuffer::allocate(size_t size, size_t alignment)
+{
+    RingAllocation allocation;
+    if (mSegment < 0) return allocation;
+    size_t offset = align_up(mHead, alignment);
+    if (offset + size > (size_t)(mSegment + 1) * mFrameSize) {
+        mStats.overflows++;
+        return allocation;
+    }
+    allocation.data = (mMapped != nullptr ? mMapped : mShadow.data()) + offset;
+    allocation.offset = offset;
+    allocation.size = size;
+    mHead = offset + size;
+    mStats.allocations++;
+    mStats.bytes += size;
+    return allocation;
+}
+
+RingAllocation FrameRingBuffer::allocateUniform(size_t size)
+{
+    return allocate(size, mUniformAlignment);
+}
+
+void FrameRingBuffer::flush()
+{
+    if (mMapped != nullptr || mHead <= mFlushed) return;
+    // The fence of this segment has passed, so the GPU is not reading it.
+    gl_state().bindBuffer(GL_COPY_WRITE_BUFFER, mBuffer);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, (GLintptr)mFlushed, (GLsizeiptr)(mHead - mFlushed),
+        mShadow.data() + mFlushed);
+    mFlushed = mHead;
+}
+
+void FrameRingBuffer::endFrame()
+{
+    if (mSegment < 0) return;
+    flush();
+    mFences[mSegment] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
@@ -0,0 +1,91 @@
+#pragma once
+#ifndef RING_BUFFER_H
+#define RING_BUFFER_H
+
+#include <stddef.h>
+#include <vector>
+#include <GL/glew.h>
+
+// A slice of the current frame's segment. data stays writable until
+// endFrame(); offset is the byte offset in FrameRingBuffer::buffer(), for
+// glBindBufferRange, attribute pointers or indirect command offsets.
+struct RingAllocation
+{
+    void* data = nullptr;
+    size_t offset = 0;
+    size_t size = 0;
+
+    bool valid() const { return data != nullptr; }
+};
+
+struct RingStats
+{
+    size_t frames = 0;
+    size_t stalls = 0;     // beginFrame() calls that had to wait on a fence
+    double stallMs = 0.0;  // CPU time spent in those waits
+    size_t allocations = 0;
+    size_t bytes = 0;
+    size_t overflows = 0;  // allocations that did not fit the segment
+};
+
+// One buffer object split into frames segments of frameSize bytes, used
+// round robin for data rewritten every frame (uniform blocks, instance
+// attributes, indirect commands). A fence placed by endFrame() guards each
+// segment; beginFrame() only waits when the GPU still reads the segment it
+// is about to reuse, so with three segments the CPU normally never blocks.
+//
+// With GL 4.4 / ARB_buffer_storage the buffer is mapped once, persistent
+// and coherent, and allocations are written in place. Without it they go
+// to a CPU copy that flush() sends with glBufferSubData.
+class FrameRingBuffer
+{
+public:
+    static const int kDefaultFrames = 3;
+
+    FrameRingBuffer() = default;
+    ~FrameRingBuffer();
+    FrameRingBuffer(const FrameRingBuffer&) = delete;
+    FrameRingBuffer& operator=(const FrameRingBuffer&) = delete;
+
+    // load_gl_extensions() must have run. Returns false on GL errors.
+    bool create(size_t frameSize, int frames = kDefaultFrames);
+    void destroy();
+
+    unsigned int buffer() const { return mBuffer; }
+    bool persistent() const { return mMapped != nullptr; }
+    size_t frameSize() const { return mFrameSize; }
+
+    // Starts the next segment, waiting for its fence if needed.
+    void beginFrame();
+    // Returns an invalid allocation when the segment is full.
+    RingAllocation allocate(size_t size, size_t alignment = 16);
+    // Aligned to GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT for glBindBufferRange
+    RingAllocation allocateUniform(size_t size);
+    // Makes the allocations so far visible to the GPU; call before the
+    // draws that read them. Free for persistent buffers.
+    void flush();
+    // Fences the segment after the frame's last draw that reads it.
+    void endFrame();
+
+    const RingStats& stats() const { return mStats; }
+    void resetStats() { mStats = RingStats(); }
+
+private:
+    unsigned int mBuffer = 0;
+    unsigned char* mMapped = nullptr;
+    std::vector<unsigned char> mShadow; // without buffer storage
+    std::vector<GLsync> mFences;
+    size_t mFrameSize = 0;
+    size_t mUniformAlignment = 256;
+    int mSegment = -1;
+    size_t mHead = 0;    // next free byte of the segment
+    size_t mFlushed = 0; // start of the part flush() has not sent yet
+    RingStats mStats;
+};
+
+// Waits until fence has signaled, then deletes it and clears the handle.
+// Polls first: returns 0 for a fence that had already signaled, otherwise
+// the milliseconds spent blocked (a stall).
+double wait_fence(GLsync& fence);
+
+#endif // RING_BUFFER_H
@@ -0,0 +1,132 @@
+//
+//  shader_compiler.cpp
+//  Program creation with deferred status checks
+//
+
+#include <stdio.h>
+#include "shader_compiler.h"
+#include "gl_extensions.h"
+
+namespace {
+
+const char* stage_name(GLenum type)
+{
+    switch (type) {
+    case GL_VERTEX_SHADER: return "vertex";
+    case GL_TESS_CONTROL_SHADER: return "tessellation control";
+    case GL_TESS_EVALUATION_SHADER: return "tessellation evaluation";
+    case GL_GEOMETRY_SHADER: return "geometry";
+    case GL_FRAGMENT_SHADER: return "fragment";
+    default: return "unknown";
+    }
+}
+
+void print_shader_log(GLuint shader, GLenum type)
+{
+    GLint length = 0;
+    glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &length);
+    std::vector<char> log((size_t)length + 1, '\0');
+    if (length > 0) glGetShaderInfoLog(shader, length, nullptr, log.data());
+    fprintf(stderr, "Failed to compile %s shader!\n%s\n", stage_name(type), log.data());
+}
+
+void print_program_log(GLuint program)
+{
+    GLint length = 0;
+    glGetProgramiv(program, GL_INFO_LOG_LENGTH, &length);
+    std::vector<char> log((size_t)length + 1, '\0');
+    if (length > 0) glGetProgramInfoLog(program, length, nullptr, log.data());
+    fprintf(stderr, "Failed to link shader program!\n%s\n", log.data());
+}
+
+} // namespace
+
+PendingProgram submit_program(const std::vector<ProgramStage>& stages)
+{
+    PendingProgram pending;
+    ProgramBinaryCache& cache = program_cache();
+    if (cache.enabled()) {
+        pending.cacheKey = cache.key(stages);
+        pending.program = cache.load(pending.cacheKey);
+        if (pending.program != 0) {
+            pending.finished = true;
+            return pending;
+        }
+    }
+
+    for (const ProgramStage& stage : stages) {
+        GLuint shader = glCreateShader(stage.type);
+        const char* source = stage.source->c_str();
+        glShaderSource(shader, 1, &source, nullptr);
+        glCompileShader(shader);
+        pending.shaders.push_back(shader);
+        pending.types.push_back(stage.type);
+    }
+    // Linking does not need the compile status: a stage that failed makes
+    // the link fail, and finish_program() looks for the culprit then.
+    pending.program = glCreateProgram();
+    for (GLuint shader : pending.shaders) {
+        glAttachShader(pending.program, shader);
+    }
+    cache.prepare(pending.program);
+    glLinkProgram(pending.program);
+    return pending;
+}
+
+PendingProgram finished_program(GLuint program)
+{
+    PendingProgram pending;
+    pending.program = program;
+    pending.finished = true;
+    return pending;
+}
+
+bool program_ready(const PendingProgram& pending)
+{
+    if (pending.finished || !gl_extensions().parallelShaderCompile) return true;
+    GLint complete = GL_TRUE;
+    glGetProgramiv(pending.program, GL_COMPLETION_STATUS_KHR, &complete);
+    return complete != GL_FALSE;
+}
+
+GLuint finish_program(PendingProgram& pending)
+{
+    if (pending.finished) return pending.program;
+    pending.finished = true;
+
+    GLint linked = GL_FALSE;
+    glGetProgramiv(pending.program, GL_LINK_STATUS, &linked);
+    if (linked == GL_FALSE) {
+        bool compiled = true;
+        for (size_t i = 0; i < pending.shaders.size(); ++i) {
+            GLint status = GL_FALSE;
+            glGetShaderiv(pending.shaders[i], GL_COMPILE_STATUS, &status);
+            if (status == GL_FALSE) {
+                print_shader_log(pending.shaders[i], pending.types[i]);
+                compiled = false;
+            }
+        }
+        if (compiled) print_program_log(pending.program);
+        glDeleteProgram(pending.program);
+        pending.program = 0;
+    }
+    else {
+        glValidateProgram(pending.program);
+        if (program_cache().enabled()) program_cache().store(pending.cacheKey, pending.program);
+    }
+
+    for (GLuint shader : pending.shaders) {
+        glDeleteShader(shader);
+    }
+    pending.shaders.clear();
+    pending.types.clear();
+    return pending.program;
+}
+
+bool set_shader_compiler_threads(GLuint count)
+{
+    const GLExtensions& extensions = gl_extensions();
+    if (!extensions.parallelShaderCompile) return false;
+    extensions.maxShaderCompilerThreads(count);
+    return true;
+}
@@ -0,0 +1,47 @@
+#pragma once
+#ifndef SHADER_COMPILER_H
+#define SHADER_COMPILER_H
+
+#include <stdint.h>
+#include <vector>
+#include <GL/glew.h>
+#include "program_cache.h"
+
+// A program whose compile and link were issued but whose status nobody has
+// asked for yet. Asking (GL_COMPILE_STATUS, GL_LINK_STATUS) makes the driver
+// finish the work on the spot, so programs created one after another with a
+// check after every call compile serially even on drivers that could run
+// them on their own threads. Submitting all of them first and checking
+// later lets those drivers overlap them, and with KHR_parallel_shader_compile
+// program_ready() tells when a check would no longer block.
+struct PendingProgram
+{
+    GLuint program = 0;
+    std::vector<GLuint> shaders; // deleted by finish_program()
+    std::vector<GLenum> types;
+    uint64_t cacheKey = 0;       // program_cache() key, if the cache is on
+    bool finished = false;       // program is the final result (0 = failed)
+};
+
+// Issues glCompileShader for every stage and glLinkProgram without querying
+// anything. With program_cache() enabled, a cached binary is loaded instead
+// and the result is already finished.
+PendingProgram submit_program(const std::vector<ProgramStage>& stages);
+// A result that needs no compiling (e.g. a program built elsewhere)
+PendingProgram finished_program(GLuint program);
+
+// True when finish_program() will not wait: GL_COMPLETION_STATUS_KHR with
+// parallel shader compile, always true without it (the driver then compiles
+// during the first status query anyway).
+bool program_ready(const PendingProgram& pending);
+// Checks the link (and on failure every stage's compile) status, prints the
+// logs, stores the binary in program_cache() and deletes the shaders.
+// Returns the linked program or 0; calling it again returns the same.
+GLuint finish_program(PendingProgram& pending);
+
+// glMaxShaderCompilerThreadsKHR if the driver has it: 0 compiles on the
+// calling thread, 0xFFFFFFFF lets the driver pick. Returns false without
+// parallel shader compile.
+bool set_shader_compiler_threads(GLuint count);
+
+#endif // SHADER_COMPILER_H
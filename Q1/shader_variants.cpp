@@ -0,0 +1,263 @@
+//
+//  shader_variants.cpp
+//  Phong.frag permutations with folded constants and a program cache
+//
+
+#include <stdio.h>
+#include <string.h>
+#include <GL/glew.h>
+#include "shader_variants.h"
+#include "uniforms.h"
+#include "fnv_hash.h"
+
+namespace
+{
+
+// GLSL float literal that round-trips the value exactly
+std::string glsl_float(float value)
+{
+    char text[32];
+    snprintf(text, sizeof(text), "%.9g", value);
+    std::string result(text);
+    if (result.find_first_of(".eEn") == std::string::npos) result += ".0";
+    return result;
+}
+
+std::string glsl_vec3(const glm::vec3& v)
+{
+    return "vec3(" + glsl_float(v.x) + ", " + glsl_float(v.y) + ", " + glsl_float(v.z) + ")";
+}
+
+bool same(const glm::vec3& a, const glm::vec3& b)
+{
+    return memcmp(&a, &b, sizeof(a)) == 0;
+}
+
+bool same(float a, float b)
+{
+    return memcmp(&a, &b, sizeof(a)) == 0;
+}
+
+struct FeatureName
+{
+    const char* name;
+    unsigned int feature;
+    bool set; // false: the name clears the feature
+};
+
+const FeatureName kFeatureNames[] = {
+    { "const", kPhongConstAll, true },
+    { "const-material", kPhongConstMaterial, true },
+    { "const-light", kPhongConstLight, true },
+    { "const-gamma", kPhongConstGamma, true },
+    { "blinn", kPhongBlinn, true },
+    { "no-specular", kPhongSpecular, false },
+    { "no-gamma", kPhongGamma, false },
+};
+
+} // namespace
+
+bool ShaderVariantKey::operator==(const ShaderVariantKey& other) const
+{
+    if (features != other.features) return false;
+    const PhongConstants& a = constants;
+    const PhongConstants& b = other.constants;
+    if ((features & kPhongConstMaterial) && !(same(a.matKa, b.matKa) && same(a.matKd, b.matKd) &&
+        same(a.matKs, b.matKs) && same(a.matShininess, b.matShininess))) return false;
+    if ((features & kPhongConstLight) && !(same(a.lightPosWorld, b.lightPosWorld) &&
+        same(a.lightIa, b.lightIa) && same(a.lightIl, b.lightIl))) return false;
+    if ((features & kPhongConstGamma) && !same(a.gamma, b.gamma)) return false;
+    return true;
+}
+
+uint64_t shader_variant_hash(const ShaderVariantKey& key)
+{
+    const PhongConstants& c = key.constants;
+    uint64_t hash = fnv1a(kFnvOffset, &key.features, sizeof(key.features));
+    if (key.features & kPhongConstMaterial) {
+        hash = fnv1a(hash, &c.matKa, sizeof(c.matKa));
+        hash = fnv1a(hash, &c.matKd, sizeof(c.matKd));
+        hash = fnv1a(hash, &c.matKs, sizeof(c.matKs));
+        hash = fnv1a(hash, &c.matShininess, sizeof(c.matShininess));
+    }
+    if (key.features & kPhongConstLight) {
+        hash = fnv1a(hash, &c.lightPosWorld, sizeof(c.lightPosWorld));
+        hash = fnv1a(hash, &c.lightIa, sizeof(c.lightIa));
+        hash = fnv1a(hash, &c.lightIl, sizeof(c.lightIl));
+    }
+    if (key.features & kPhongConstGamma) {
+        hash = fnv1a(hash, &c.gamma, sizeof(c.gamma));
+    }
+    return hash;
+}
+
+std::string build_shader_variant(const std::string& source, const ShaderVariantKey& key)
+{
+    const unsigned int f = key.features;
+    const PhongConstants& c = key.constants;
+    std::string defines;
+    defines += "#define SPECULAR " + std::string((f & kPhongSpecular) ? "1" : "0") + "\n";
+    defines += "#define BLINN " + std::string((f & kPhongBlinn) ? "1" : "0") + "\n";
+    defines += "#define GAMMA_CORRECT " + std::string((f & kPhongGamma) ? "1" : "0") + "\n";
+    if (f & kPhongMaterialPalette) {
+        defines += "#define MATERIAL_PALETTE " + std::to_string(kMaterialPaletteSize) + "\n";
+    }
+    else if (f & kPhongConstMaterial) {
+        defines += "#define MAT_KA " + glsl_vec3(c.matKa) + "\n";
+        defines += "#define MAT_KD " + glsl_vec3(c.matKd) + "\n";
+        defines += "#define MAT_KS " + glsl_vec3(c.matKs) + "\n";
+        defines += "#define MAT_SHININESS " + glsl_float(c.matShininess) + "\n";
+    }
+    if (f & kPhongConstLight) {
+        defines += "#define LIGHT_POS " + glsl_vec3(c.lightPosWorld) + "\n";
+        defines += "#define LIGHT_IA " + glsl_float(c.lightIa) + "\n";
+        defines += "#define LIGHT_IL " + glsl_vec3(c.lightIl) + "\n";
+    }
+    if (f & kPhongConstGamma) {
+        defines += "#define GAMMA " + glsl_float(c.gamma) + "\n";
+    }
+
+    return inject_defines(source, defines);
+}
+
+std::string inject_defines(const std::string& source, const std::string& defines)
+{
+    // #version has to stay the first statement.
+    size_t versionLine = source.find("#version");
+    if (versionLine == std::string::npos) return defines + "#line 1\n" + source;
+    size_t end = source.find('\n', versionLine);
+    if (end == std::string::npos) return source + "\n" + defines;
+    int nextLine = 2;
+    for (size_t i = 0; i < versionLine; ++i) {
+        if (source[i] == '\n') nextLine++;
+    }
+    return source.substr(0, end + 1) + defines + "#line " + std::to_string(nextLine) + "\n" + source.substr(end + 1);
+}
+
+bool parse_shader_features(const char* list, unsigned int& features)
+{
+    features = kPhongDefault;
+    std::string names(list);
+    size_t begin = 0;
+    while (begin <= names.size()) {
+        size_t end = names.find(',', begin);
+        if (end == std::string::npos) end = names.size();
+        std::string name = names.substr(begin, end - begin);
+        bool known = false;
+        for (const FeatureName& entry : kFeatureNames) {
+            if (name == entry.name) {
+                features = entry.set ? (features | entry.feature) : (features & ~entry.feature);
+                known = true;
+            }
+        }
+        if (!known) return false;
+        begin = end + 1;
+    }
+    return true;
+}
+
+std::string shader_features_name(unsigned int features)
+{
+    std::string name = (features & kPhongSpecular) ? ((features & kPhongBlinn) ? "blinn" : "phong") : "diffuse";
+    if (!(features & kPhongGamma)) name += "+linear";
+    if (features & kPhongMaterialPalette) name += "+palette";
+    if ((features & kPhongConstAll) == kPhongConstAll) {
+        name += "+const";
+    }
+    else {
+        if (features & kPhongConstMaterial) name += "+const-material";
+        if (features & kPhongConstLight) name += "+const-light";
+        if (features & kPhongConstGamma) name += "+const-gamma";
+    }
+    return name;
+}
+
+ShaderVariantCache::ShaderVariantCache(const std::string& fragmentSource, ProgramBuilder builder)
+    : mFragmentSource(fragmentSource)
+{
+    mSubmitter = [builder](const std::string& fragment) { return finished_program(builder(fragment)); };
+}
+
+ShaderVariantCache::ShaderVariantCache(const std::string& fragmentSource, ProgramSubmitter submitter)
+    : mFragmentSource(fragmentSource), mSubmitter(std::move(submitter))
+{
+}
+
+unsigned int ShaderVariantCache::program(const ShaderVariantKey& key)
+{
+    auto it = mPrograms.find(key);
+    if (it != mPrograms.end()) {
+        mHits++;
+        return it->second;
+    }
+    auto pending = mPending.find(key);
+    if (pending == mPending.end()) {
+        mBuilds++;
+        PendingProgram submitted = mSubmitter(build_shader_variant(mFragmentSource, key));
+        return finish(key, submitted);
+    }
+    PendingProgram submitted = std::move(pending->second);
+    mPending.erase(pending);
+    return finish(key, submitted);
+}
+
+void ShaderVariantCache::request(const ShaderVariantKey& key)
+{
+    if (mPrograms.count(key) != 0 || mPending.count(key) != 0) return;
+    mBuilds++;
+    mPending.emplace(key, mSubmitter(build_shader_variant(mFragmentSource, key)));
+}
+
+unsigned int ShaderVariantCache::ready(const ShaderVariantKey& key, unsigned int fallback)
+{
+    auto it = mPrograms.find(key);
+    if (it != mPrograms.end()) {
+        mHits++;
+        return it->second != 0 ? it->second : fallback;
+    }
+    request(key);
+    auto pending = mPending.find(key);
+    if (!program_ready(pending->second)) return fallback;
+    PendingProgram submitted = std::move(pending->second);
+    mPending.erase(pending);
+    unsigned int program = finish(key, submitted);
+    return program != 0 ? program : fallback;
+}
+
+size_t ShaderVariantCache::poll()
+{
+    size_t finished = 0;
+    for (auto it = mPending.begin(); it != mPending.end();) {
+        if (!program_ready(it->second)) {
+            ++it;
+            continue;
+        }
+        finish(it->first, it->second);
+        it = mPending.erase(it);
+        finished++;
+    }
+    return finished;
+}
+
+unsigned int ShaderVariantCache::finish(const ShaderVariantKey& key, PendingProgram& pending)
+{
+    unsigned int program = finish_program(pending);
+    if (program == 0) {
+        fprintf(stderr, "Failed to build shader variant %s\n", shader_features_name(key.features).c_str());
+    }
+    mPrograms.emplace(key, program);
+    return program;
+}
+
+void ShaderVariantCache::clear()
+{
+    for (auto& entry : mPrograms) {
+        if (entry.second != 0) glDeleteProgram(entry.second);
+    }
+    mPrograms.clear();
+    for (auto& entry : mPending) {
+        for (GLuint shader : entry.second.shaders) glDeleteShader(shader);
+        glDeleteProgram(entry.second.program);
+    }
+    mPending.clear();
+}
@@ -0,0 +1,123 @@
+#pragma once
+#ifndef SHADER_VARIANTS_H
+#define SHADER_VARIANTS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <glm/vec3.hpp>
+#include "shader_compiler.h"
+
+// Feature bits of a Phong.frag permutation
+enum PhongFeature : unsigned int
+{
+    kPhongSpecular = 1u << 0,        // specular term
+    kPhongBlinn = 1u << 1,           // Blinn-Phong half vector instead of reflect()
+    kPhongGamma = 1u << 2,           // gamma correction of the output
+    kPhongConstMaterial = 1u << 3,   // material folded into the shader
+    kPhongConstLight = 1u << 4,      // light folded into the shader
+    kPhongConstGamma = 1u << 5,      // gamma value folded into the shader
+    kPhongMaterialPalette = 1u << 6, // per-instance material from PhongInstanced.vert
+                                     // (takes precedence over kPhongConstMaterial)
+
+    kPhongDefault = kPhongSpecular | kPhongGamma,
+    kPhongConstAll = kPhongConstMaterial | kPhongConstLight | kPhongConstGamma,
+};
+
+// Values baked in by the kPhongConst* features
+struct PhongConstants
+{
+    glm::vec3 matKa = glm::vec3(0.0f);
+    glm::vec3 matKd = glm::vec3(0.0f);
+    glm::vec3 matKs = glm::vec3(0.0f);
+    float matShininess = 1.0f;
+    glm::vec3 lightPosWorld = glm::vec3(0.0f);
+    float lightIa = 0.0f;
+    glm::vec3 lightIl = glm::vec3(0.0f);
+    float gamma = 1.0f;
+};
+
+struct ShaderVariantKey
+{
+    unsigned int features = kPhongDefault;
+    PhongConstants constants; // only the groups selected by kPhongConst* count
+
+    bool operator==(const ShaderVariantKey& other) const;
+};
+
+// FNV-1a over the features and the constants they select; constants that
+// are not folded do not change the hash.
+uint64_t shader_variant_hash(const ShaderVariantKey& key);
+
+struct ShaderVariantHash
+{
+    size_t operator()(const ShaderVariantKey& key) const { return (size_t)shader_variant_hash(key); }
+};
+
+// Inserts the #defines of the key right after the #version line of source
+// (followed by #line so compiler messages keep their line numbers).
+std::string build_shader_variant(const std::string& source, const ShaderVariantKey& key);
+// The same insertion for any shader; defines holds complete "#define" lines.
+std::string inject_defines(const std::string& source, const std::string& defines);
+
+// Parses a comma separated feature list ("const,blinn,no-specular,no-gamma")
+// on top of kPhongDefault. Returns false on an unknown name.
+bool parse_shader_features(const char* list, unsigned int& features);
+// Short readable name of a feature set, e.g. "blinn+const"
+std::string shader_features_name(unsigned int features);
+
+// Programs built on demand, one per distinct key. The builder receives the
+// specialized fragment source and returns a linked program (0 on failure);
+// it runs with the GL context current.
+//
+// A submitter instead only issues the compile and link (submit_program()),
+// so request() can queue variants that finish in the background while
+// ready() hands out a fallback program; program() still waits.
+class ShaderVariantCache
+{
+public:
+    using ProgramBuilder = std::function<unsigned int(const std::string& fragmentSource)>;
+    using ProgramSubmitter = std::function<PendingProgram(const std::string& fragmentSource)>;
+
+    ShaderVariantCache(const std::string& fragmentSource, ProgramBuilder builder);
+    ShaderVariantCache(const std::string& fragmentSource, ProgramSubmitter submitter);
+    ShaderVariantCache(const ShaderVariantCache&) = delete;
+    ShaderVariantCache& operator=(const ShaderVariantCache&) = delete;
+
+    // Cached program of the key, built on first use (waiting for it if it
+    // was requested). Failures are cached too.
+    unsigned int program(const ShaderVariantKey& key);
+
+    // Submits the key's program unless it is known already.
+    void request(const ShaderVariantKey& key);
+    // The key's program once it has finished linking, otherwise fallback
+    // (also for a variant that failed). Requests unknown keys; never waits.
+    unsigned int ready(const ShaderVariantKey& key, unsigned int fallback);
+    // Finishes every requested program whose check would not block;
+    // returns how many.
+    size_t poll();
+
+    size_t size() const { return mPrograms.size(); }
+    size_t pending() const { return mPending.size(); }
+    size_t builds() const { return mBuilds; }
+    size_t hits() const { return mHits; }
+
+    // Deletes every program, pending ones too; call before the context goes
+    // away.
+    void clear();
+
+private:
+    unsigned int finish(const ShaderVariantKey& key, PendingProgram& pending);
+
+    std::string mFragmentSource;
+    ProgramSubmitter mSubmitter;
+    std::unordered_map<ShaderVariantKey, unsigned int, ShaderVariantHash> mPrograms;
+    std::unordered_map<ShaderVariantKey, PendingProgram, ShaderVariantHash> mPending;
+    size_t mBuilds = 0;
+    size_t mHits = 0;
+};
+
+#endif // SHADER_VARIANTS_H
@@ -6,122 +6,479 @@
 
 #include <stdio.h>
 #include <math.h>
-#include <glm/vec3.hpp> // Include GLM for vec3 type
+#include <stdint.h>
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
+#include <glm/glm.hpp> // Include GLM for vec3 type
 #include "sphere_scene.h"
+#include "parallel.h"
+#include "cpu_profiler.h"
 
-// Global variables
-int         gNumVertices = 0;        // Number of 3D vertices.
-int         gNumTriangles = 0;        // Number of triangles.
-int* gIndexBuffer = nullptr;  // Vertex indices for the triangles.
-glm::vec3* gVertexBuffer = nullptr;  // Vertex coordinates array (using glm::vec3)
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
 
-// Function to create the sphere geometry
-void create_scene()
+// Function to create the sphere geometry at an arbitrary resolution.
+//
+// The angles are evaluated exactly like the original per-vertex loop, but
+// because sin/cos(theta) only depend on the row and sin/cos(phi) only on the
+// column, they are tabulated once (height + width trig calls instead of
+// 3 * width * height). The per-vertex work is then two multiplies, which the
+// compiler vectorizes, and the output stays bit-identical to the scalar path.
+Mesh create_sphere(int width, int height, const SphereOptions& options)
 {
-    // Define sphere parameters (resolution)
-    int width = 32; // Number of divisions around the equator
-    int height = 16; // Number of divisions from pole to pole
-
-    float theta, phi;
-    int t; // Vertex counter
+    PROFILE_ZONE("create_sphere");
+    if (width < 2 || height < 3) {
+        fprintf(stderr, "Invalid sphere resolution %dx%d\n", width, height);
+        return Mesh();
+    }
 
     // Calculate total number of vertices and triangles
-    gNumVertices = (height - 2) * width + 2; // vertices in the middle + 2 poles
+    int numVertices = (height - 2) * width + 2; // vertices in the middle + 2 poles
     // : ﰢ    (HW6  Ͱ ġϵ)
-    gNumTriangles = (height - 3) * (width - 1) * 2 + (width - 1) * 2;
+    int numTriangles = (height - 3) * (width - 1) * 2 + (width - 1) * 2;
 
-    // 1. Allocate the vertex buffer array
-    gVertexBuffer = new glm::vec3[gNumVertices];
-    if (!gVertexBuffer) {
-        fprintf(stderr, "Error allocating memory for vertex buffer\n");
-        return;
+    // 1. Allocate the vertex and index buffers
+    Mesh mesh(numVertices, 3 * (size_t)numTriangles);
+    if (mesh.empty()) {
+        fprintf(stderr, "Error allocating memory for sphere mesh\n");
+        return Mesh();
     }
 
-    // Allocate the index buffer array
-    gIndexBuffer = new int[3 * gNumTriangles];
-    if (!gIndexBuffer) {
-        fprintf(stderr, "Error allocating memory for index buffer\n");
-        delete[] gVertexBuffer;
-        gVertexBuffer = nullptr;
-        return;
+    // 2. Trig tables (row 0 and row height-1 are the poles and never used)
+    std::vector<float> sinTheta(height), cosTheta(height);
+    for (int j = 1; j < height - 1; ++j)
+    {
+        float theta = (float)((float)j / (height - 1) * M_PI);
+        sinTheta[j] = sinf(theta);
+        cosTheta[j] = cosf(theta);
     }
 
+    std::vector<float> sinPhi(width), cosPhi(width);
+    for (int i = 0; i < width; ++i)
+    {
+        float phi = (float)((float)i / (width - 1) * M_PI * 2);
+        sinPhi[i] = sinf(phi);
+        cosPhi[i] = cosf(phi);
+    }
 
-    t = 0;
+    glm::vec3* vertices = mesh.vertices().data();
+    int* indices = mesh.indices().data();
+    size_t grain = options.rowsPerTask > 0 ? (size_t)options.rowsPerTask : 1;
 
-    for (int j = 1; j < height - 1; ++j)
-    {
-        for (int i = 0; i < width; ++i)
+    // 3. Ring vertices, one task per block of rows
+    parallel_for(1, (size_t)height - 1, grain, options.numThreads,
+        [&](size_t rowBegin, size_t rowEnd)
         {
-#ifndef M_PI
-#define M_PI 3.14159265358979323846
-#endif
-            theta = (float)j / (height - 1) * M_PI;
-            phi = (float)i / (width - 1) * M_PI * 2;
+            PROFILE_ZONE("create_sphere vertices");
+            for (size_t j = rowBegin; j < rowEnd; ++j)
+            {
+                const float st = sinTheta[j];
+                const float ct = cosTheta[j];
+                glm::vec3* row = vertices + (j - 1) * width;
+                for (int i = 0; i < width; ++i)
+                {
+                    row[i] = glm::vec3(st * cosPhi[i], ct, -st * sinPhi[i]);
+                }
+            }
+        });
 
-            float   x = sinf(theta) * cosf(phi);
-            float   y = cosf(theta);
-            float   z = -sinf(theta) * sinf(phi);
+    int t = (height - 2) * width;
 
-            gVertexBuffer[t] = glm::vec3(x, y, z);
-            t++;
-        }
-    }
-
-    gVertexBuffer[t] = glm::vec3(0.0f, 1.0f, 0.0f);
+    vertices[t] = glm::vec3(0.0f, 1.0f, 0.0f);
     t++;
 
-    gVertexBuffer[t] = glm::vec3(0.0f, -1.0f, 0.0f);
+    vertices[t] = glm::vec3(0.0f, -1.0f, 0.0f);
     t++;
 
-    t = 0;
-
     // ε    (HW6  Ͱ ġϵ)
-    for (int j = 0; j < height - 3; ++j)
-    {
-        for (int i = 0; i < width - 1; ++i)
+    // Each band of quads writes to its own fixed slice of the index buffer.
+    const size_t indicesPerBand = 6 * (size_t)(width - 1);
+    parallel_for(0, (size_t)height - 3, grain, options.numThreads,
+        [&](size_t bandBegin, size_t bandEnd)
         {
-            gIndexBuffer[t++] = j * width + i;
-            gIndexBuffer[t++] = (j + 1) * width + (i + 1);
-            gIndexBuffer[t++] = j * width + (i + 1);
+            PROFILE_ZONE("create_sphere indices");
+            for (size_t band = bandBegin; band < bandEnd; ++band)
+            {
+                int j = (int)band;
+                int* out = indices + band * indicesPerBand;
+                for (int i = 0; i < width - 1; ++i)
+                {
+                    *out++ = j * width + i;
+                    *out++ = (j + 1) * width + (i + 1);
+                    *out++ = j * width + (i + 1);
 
-            gIndexBuffer[t++] = j * width + i;
-            gIndexBuffer[t++] = (j + 1) * width + i;
-            gIndexBuffer[t++] = (j + 1) * width + (i + 1);
-        }
-    }
+                    *out++ = j * width + i;
+                    *out++ = (j + 1) * width + i;
+                    *out++ = (j + 1) * width + (i + 1);
+                }
+            }
+        });
+
+    size_t k = (size_t)(height - 3) * indicesPerBand;
 
     int northPoleIndex = (height - 2) * width;
     int southPoleIndex = northPoleIndex + 1;
 
     for (int i = 0; i < width - 1; ++i)
     {
-        gIndexBuffer[t++] = northPoleIndex;
-        gIndexBuffer[t++] = i;
-        gIndexBuffer[t++] = i + 1;
+        indices[k++] = northPoleIndex;
+        indices[k++] = i;
+        indices[k++] = i + 1;
     }
 
     int bottomStripStart = (height - 3) * width;
     for (int i = 0; i < width - 1; ++i)
     {
-        gIndexBuffer[t++] = southPoleIndex;
-        gIndexBuffer[t++] = bottomStripStart + (i + 1);
-        gIndexBuffer[t++] = bottomStripStart + i;
+        indices[k++] = southPoleIndex;
+        indices[k++] = bottomStripStart + (i + 1);
+        indices[k++] = bottomStripStart + i;
+    }
+
+    return mesh;
+}
+
+// Function to create the default sphere used by the viewer
+Mesh create_scene()
+{
+    PROFILE_ZONE("create_scene");
+    return create_sphere(32, 16);
+}
+
+std::vector<SphereInstance> create_sphere_instances(size_t count, int materialCount, uint32_t seed)
+{
+    std::vector<SphereInstance> instances;
+    if (count == 0 || materialCount <= 0) return instances;
+    instances.resize(count);
+
+    size_t side = 1;
+    while (side * side * side < count) side++;
+    const float cell = 2.0f / side;
+
+    // xorshift32, good enough for jitter and reproducible across platforms
+    uint32_t state = seed != 0 ? seed : 1;
+    auto next = [&state]() {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return (state >> 8) * (1.0f / 16777216.0f);
+    };
+
+    for (size_t i = 0; i < count; ++i) {
+        size_t x = i % side, y = (i / side) % side, z = i / (side * side);
+        glm::vec3 center = glm::vec3(-1.0f) + cell * (glm::vec3((float)x, (float)y, (float)z) + 0.5f);
+        SphereInstance& instance = instances[i];
+        instance.scale = cell * (0.25f + 0.1f * next());
+        float jitter = 0.5f * cell - instance.scale;
+        instance.position = center + jitter * (2.0f * glm::vec3(next(), next(), next()) - 1.0f);
+        instance.material = (uint32_t)(i % (size_t)materialCount);
+    }
+    return instances;
+}
+
+void animate_sphere_instances(const std::vector<SphereInstance>& rest, float time, SphereInstance* out)
+{
+    for (size_t i = 0; i < rest.size(); ++i) {
+        SphereInstance instance = rest[i];
+        instance.position.y += 0.5f * instance.scale * sinf(2.0f * time + 0.37f * (float)i);
+        out[i] = instance;
+    }
+}
+
+size_t sphere_triangle_count(int width, int height)
+{
+    if (width < 2 || height < 3) return 0;
+    return (size_t)(height - 3) * (width - 1) * 2 + (size_t)(width - 1) * 2;
+}
+
+// ---------------------------------------------------------------------------
+// Error-targeted icosphere and cube-sphere generators
+// ---------------------------------------------------------------------------
+
+namespace {
+
+// Copies generated geometry into a single-allocation mesh.
+Mesh make_mesh(const std::vector<glm::vec3>& vertices, const std::vector<int>& indices)
+{
+    Mesh mesh(vertices.size(), indices.size());
+    if (mesh.empty()) {
+        fprintf(stderr, "Error allocating memory for sphere mesh\n");
+        return mesh;
+    }
+    std::copy(vertices.begin(), vertices.end(), mesh.vertices().data());
+    std::copy(indices.begin(), indices.end(), mesh.indices().data());
+    return mesh;
+}
+
+// Distance from the origin to the closest point of triangle abc.
+float origin_distance_to_triangle(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c)
+{
+    glm::vec3 ab = b - a, ac = c - a;
+    glm::vec3 n = glm::cross(ab, ac);
+    float nn = glm::dot(n, n);
+    if (nn > 0.0f) {
+        // Project the origin onto the plane and test its barycentrics.
+        glm::vec3 p = n * (glm::dot(n, a) / nn);
+        glm::vec3 ap = p - a;
+        float d00 = glm::dot(ab, ab), d01 = glm::dot(ab, ac), d11 = glm::dot(ac, ac);
+        float d20 = glm::dot(ap, ab), d21 = glm::dot(ap, ac);
+        float v = (d11 * d20 - d01 * d21) / nn;
+        float w = (d00 * d21 - d01 * d20) / nn;
+        if (v >= 0.0f && w >= 0.0f && v + w <= 1.0f) {
+            return glm::length(p);
+        }
+    }
+
+    // Otherwise the closest point lies on an edge.
+    const glm::vec3* corners[3] = { &a, &b, &c };
+    float best = 1e30f;
+    for (int e = 0; e < 3; ++e) {
+        const glm::vec3& p0 = *corners[e];
+        const glm::vec3& p1 = *corners[(e + 1) % 3];
+        glm::vec3 d = p1 - p0;
+        float dd = glm::dot(d, d);
+        float s = dd > 0.0f ? glm::clamp(-glm::dot(p0, d) / dd, 0.0f, 1.0f) : 0.0f;
+        best = std::min(best, glm::length(p0 + d * s));
+    }
+    return best;
+}
+
+void icosahedron(std::vector<glm::vec3>& vertices, std::vector<int>& indices)
+{
+    const float g = (1.0f + sqrtf(5.0f)) * 0.5f; // golden ratio
+    const glm::vec3 corners[12] = {
+        glm::vec3(-1,  g,  0), glm::vec3( 1,  g,  0), glm::vec3(-1, -g,  0), glm::vec3( 1, -g,  0),
+        glm::vec3( 0, -1,  g), glm::vec3( 0,  1,  g), glm::vec3( 0, -1, -g), glm::vec3( 0,  1, -g),
+        glm::vec3( g,  0, -1), glm::vec3( g,  0,  1), glm::vec3(-g,  0, -1), glm::vec3(-g,  0,  1),
+    };
+    const int faces[60] = {
+        0, 11, 5,   0, 5, 1,    0, 1, 7,    0, 7, 10,   0, 10, 11,
+        1, 5, 9,    5, 11, 4,   11, 10, 2,  10, 7, 6,   7, 1, 8,
+        3, 9, 4,    3, 4, 2,    3, 2, 6,    3, 6, 8,    3, 8, 9,
+        4, 9, 5,    2, 4, 11,   6, 2, 10,   8, 6, 7,    9, 8, 1,
+    };
+
+    vertices.clear();
+    for (const glm::vec3& c : corners) vertices.push_back(glm::normalize(c));
+    indices.assign(faces, faces + 60);
+}
+
+// Geodesic icosphere of frequency n: every icosahedron edge is split into n
+// pieces and every face into the n * n triangles of its barycentric lattice,
+// projected onto the sphere. Unlike repeated 1:4 splits this reaches any
+// triangle count 20 * n * n, not only powers of 4. Lattice points on an
+// icosahedron edge are keyed by the edge and their weight on its lower
+// corner, so that neighbouring faces share them.
+void build_icosphere(int n, std::vector<glm::vec3>& vertices, std::vector<int>& indices)
+{
+    std::vector<glm::vec3> corners;
+    std::vector<int> faces;
+    icosahedron(corners, faces);
+    vertices = corners;
+    indices.clear();
+    indices.reserve((size_t)20 * n * n * 3);
+
+    std::unordered_map<uint64_t, int> edgePoints;
+    edgePoints.reserve((size_t)30 * n);
+    // Index of the lattice point with the given corner weights (summing to n).
+    auto latticePoint = [&](const int corner[3], const int weight[3]) {
+        int nonzero[3], count = 0;
+        for (int k = 0; k < 3; ++k) {
+            if (weight[k] != 0) nonzero[count++] = k;
+        }
+        if (count == 1) return corner[nonzero[0]];
+        if (count == 2) {
+            int p = nonzero[0], q = nonzero[1];
+            if (corner[p] > corner[q]) std::swap(p, q);
+            uint64_t key = ((uint64_t)corner[p] * 12 + corner[q]) * (n + 1) + weight[p];
+            auto it = edgePoints.find(key);
+            if (it != edgePoints.end()) return it->second;
+            edgePoints.emplace(key, (int)vertices.size());
+        }
+        glm::vec3 p = corners[corner[0]] * (float)weight[0] + corners[corner[1]] * (float)weight[1] +
+            corners[corner[2]] * (float)weight[2];
+        vertices.push_back(glm::normalize(p));
+        return (int)vertices.size() - 1;
+    };
+
+    // Row i of a face steps from corner a towards c, column j from a towards b.
+    std::vector<int> lattice;
+    std::vector<size_t> rowStart(n + 2);
+    for (size_t f = 0; f < faces.size(); f += 3) {
+        const int corner[3] = { faces[f], faces[f + 1], faces[f + 2] };
+        lattice.clear();
+        for (int i = 0; i <= n; ++i) {
+            rowStart[i] = lattice.size();
+            for (int j = 0; j <= n - i; ++j) {
+                const int weight[3] = { n - i - j, j, i };
+                lattice.push_back(latticePoint(corner, weight));
+            }
+        }
+        for (int i = 0; i < n; ++i) {
+            const int* row = &lattice[rowStart[i]];
+            const int* next = &lattice[rowStart[i + 1]];
+            for (int j = 0; j < n - i; ++j) {
+                int tri[3] = { row[j], row[j + 1], next[j] };
+                indices.insert(indices.end(), tri, tri + 3);
+                if (j + 1 < n - i) {
+                    int flipped[3] = { row[j + 1], next[j + 1], next[j] };
+                    indices.insert(indices.end(), flipped, flipped + 3);
+                }
+            }
+        }
     }
 }
 
-// Function to delete the sphere geometry and free memory
-void delete_scene()
+// Cube with `n` x `n` quads per face, projected onto the sphere. The face
+// coordinates are warped with tan() (equal-angle cube map) so that the quads
+// are close to uniform in size. Vertices are keyed by their cube lattice
+// point so that face edges are welded. Each quad is split along its shorter
+// diagonal: the deepest point of a triangle lies on its longest edge, and
+// the warped quads near the face corners are skewed.
+void build_cube_sphere(int n, std::vector<glm::vec3>& vertices, std::vector<int>& indices)
 {
-    if (gIndexBuffer) {
-        delete[] gIndexBuffer;
-        gIndexBuffer = nullptr;
-        gNumTriangles = 0;
+    const float quarterPi = (float)(M_PI * 0.25);
+    std::vector<float> warp(n + 1);
+    for (int i = 0; i <= n; ++i) {
+        float s = 2.0f * i / n - 1.0f;
+        warp[i] = (i == 0 || i == n) ? s : tanf(s * quarterPi);
     }
 
-    if (gVertexBuffer) {
-        delete[] gVertexBuffer;
-        gVertexBuffer = nullptr;
-        gNumVertices = 0;
+    // Face normal axis, and the (u, v) axes with cross(u, v) pointing outwards.
+    struct Face { int axis, u, v; int sign; };
+    const Face faces[6] = {
+        { 0, 1, 2, +1 }, { 0, 2, 1, -1 },
+        { 1, 2, 0, +1 }, { 1, 0, 2, -1 },
+        { 2, 0, 1, +1 }, { 2, 1, 0, -1 },
+    };
+
+    const uint64_t side = (uint64_t)n + 1;
+    std::unordered_map<uint64_t, int> lattice;
+    lattice.reserve((size_t)(6 * side * side));
+    vertices.clear();
+    indices.clear();
+    indices.reserve((size_t)6 * n * n * 6);
+
+    std::vector<int> grid(side * side);
+    for (const Face& f : faces) {
+        for (int j = 0; j <= n; ++j) {
+            for (int i = 0; i <= n; ++i) {
+                int p[3];
+                p[f.axis] = f.sign > 0 ? n : 0;
+                p[f.u] = i;
+                p[f.v] = j;
+                uint64_t key = ((uint64_t)p[0] * side + p[1]) * side + p[2];
+                auto it = lattice.find(key);
+                int index;
+                if (it != lattice.end()) {
+                    index = it->second;
+                }
+                else {
+                    index = (int)vertices.size();
+                    vertices.push_back(glm::normalize(glm::vec3(warp[p[0]], warp[p[1]], warp[p[2]])));
+                    lattice.emplace(key, index);
+                }
+                grid[j * side + i] = index;
+            }
+        }
+
+        for (int j = 0; j < n; ++j) {
+            for (int i = 0; i < n; ++i) {
+                int a = grid[j * side + i], b = grid[j * side + i + 1];
+                int c = grid[(j + 1) * side + i + 1], d = grid[(j + 1) * side + i];
+                glm::vec3 ac = vertices[c] - vertices[a], bd = vertices[d] - vertices[b];
+                if (glm::dot(bd, bd) < glm::dot(ac, ac)) {
+                    int quad[6] = { a, b, d,  b, c, d };
+                    indices.insert(indices.end(), quad, quad + 6);
+                }
+                else {
+                    int quad[6] = { a, b, c,  a, c, d };
+                    indices.insert(indices.end(), quad, quad + 6);
+                }
+            }
+        }
+    }
+}
+
+// Smallest resolution in [1, maxResolution] whose mesh from build() deviates
+// at most maxError from the sphere. The deviation decreases monotonically
+// with the resolution: double until the target is met, then bisect the last
+// interval. maxError <= 0 asks for maxResolution itself.
+template <typename Build>
+int smallest_resolution(float maxError, int maxResolution, Build build)
+{
+    if (!(maxError > 0.0f)) return maxResolution;
+    std::vector<glm::vec3> vertices;
+    std::vector<int> indices;
+    auto meets = [&](int resolution) {
+        build(resolution, vertices, indices);
+        return measure_sphere_error(vertices.data(), indices.data(), indices.size() / 3) <= maxError;
+    };
+    int lo = 1, hi = 1;
+    while (hi < maxResolution && !meets(hi)) {
+        lo = hi + 1;
+        hi = std::min(hi * 2, maxResolution);
     }
-}
\ No newline at end of file
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (meets(mid))
+            hi = mid;
+        else
+            lo = mid + 1;
+    }
+    return lo;
+}
+
+} // namespace
+
+float measure_sphere_error(const glm::vec3* vertices, const int* indices, size_t numTriangles)
+{
+    float worst = 0.0f;
+    for (size_t t = 0; t < numTriangles; ++t) {
+        const glm::vec3& a = vertices[indices[3 * t]];
+        const glm::vec3& b = vertices[indices[3 * t + 1]];
+        const glm::vec3& c = vertices[indices[3 * t + 2]];
+        worst = std::max(worst, 1.0f - origin_distance_to_triangle(a, b, c));
+    }
+    return worst;
+}
+
+float measure_sphere_error(const Mesh& mesh)
+{
+    return measure_sphere_error(mesh.vertices().data(), mesh.indices().data(), mesh.triangleCount());
+}
+
+float sphere_error_from_pixels(float pixelError, const glm::mat4& projection, int viewportHeight,
+    float distance, float radius)
+{
+    // Height in world units covered by one pixel at the given view depth.
+    float pixelSize = 2.0f * distance / (projection[1][1] * (float)viewportHeight);
+    return pixelError * pixelSize / radius;
+}
+
+int icosphere_frequency_for_error(float maxError, int maxFrequency)
+{
+    return smallest_resolution(maxError, maxFrequency, build_icosphere);
+}
+
+int cube_sphere_resolution_for_error(float maxError, int maxResolution)
+{
+    return smallest_resolution(maxError, maxResolution, build_cube_sphere);
+}
+
+Mesh create_icosphere(float maxError, int maxFrequency)
+{
+    std::vector<glm::vec3> vertices;
+    std::vector<int> indices;
+    build_icosphere(icosphere_frequency_for_error(maxError, maxFrequency), vertices, indices);
+    return make_mesh(vertices, indices);
+}
+
+Mesh create_cube_sphere(float maxError, int maxResolution)
+{
+    std::vector<glm::vec3> vertices;
+    std::vector<int> indices;
+    build_cube_sphere(cube_sphere_resolution_for_error(maxError, maxResolution), vertices, indices);
+    return make_mesh(vertices, indices);
+}
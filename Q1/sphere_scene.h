@@ -2,16 +2,62 @@
 #ifndef SPHERE_SCENE_H
 #define SPHERE_SCENE_H
 
-#include <glm/vec3.hpp> 
+#include <stdint.h>
+#include <vector>
+#include <glm/vec3.hpp>
+#include <glm/mat4x4.hpp>
+#include "mesh.h"
 
+// Options for create_sphere()
+struct SphereOptions
+{
+    int numThreads = 0;   // worker threads, 0 = one per hardware thread
+    int rowsPerTask = 64; // minimum number of rows handed to one thread
+};
 
-extern int gNumVertices;
-extern int gNumTriangles;
-extern int* gIndexBuffer;
-extern glm::vec3* gVertexBuffer;
+// The returned mesh is empty() on invalid parameters or allocation failure.
+Mesh create_sphere(int width, int height, const SphereOptions& options = SphereOptions());
+Mesh create_scene();
 
+// Triangles in create_sphere(width, height), 0 for an invalid resolution.
+// PhongProcedural.vert generates the same triangles from gl_VertexID.
+size_t sphere_triangle_count(int width, int height);
 
-void create_scene();
-void delete_scene();
+// One sphere of the instanced draw path; the vertex layout of
+// PhongInstanced.vert's per-instance attributes.
+struct SphereInstance
+{
+    glm::vec3 position; // center, in the space of the group's modelMatrix
+    float scale;        // radius
+    uint32_t material;  // index into the material palette
+};
+
+// count spheres on a cubic grid filling [-1, 1]^3, with a little jitter in
+// position and size so they never touch, cycling over materialCount
+// materials. The result is deterministic for a given seed.
+std::vector<SphereInstance> create_sphere_instances(size_t count, int materialCount, uint32_t seed = 1);
+// Writes the instances at time t (seconds) to out: each bobs up and down by
+// its radius with its own phase, so neighbours still never touch.
+void animate_sphere_instances(const std::vector<SphereInstance>& rest, float time, SphereInstance* out);
+
+// Icosphere / cube-sphere generators for the unit sphere. The subdivision is
+// chosen automatically as the coarsest one whose measured deviation from the
+// true sphere (relative to the radius) does not exceed maxError; maxError 0
+// gives the maximum. The icosphere is geodesic with 20 * f * f triangles for
+// frequency f (1 is the icosahedron), the cube sphere has 6 * n * n quads.
+Mesh create_icosphere(float maxError, int maxFrequency = 512);
+Mesh create_cube_sphere(float maxError, int maxResolution = 1024);
+int icosphere_frequency_for_error(float maxError, int maxFrequency = 512);
+int cube_sphere_resolution_for_error(float maxError, int maxResolution = 1024);
+
+// Largest distance between the unit sphere and a triangle of the mesh.
+float measure_sphere_error(const glm::vec3* vertices, const int* indices, size_t numTriangles);
+float measure_sphere_error(const Mesh& mesh);
+
+// Converts a screen-space error in pixels into the relative geometric error
+// accepted by the generators, for a sphere of the given radius at the given
+// view depth.
+float sphere_error_from_pixels(float pixelError, const glm::mat4& projection, int viewportHeight,
+    float distance, float radius);
 
 #endif // SPHERE_SCENE_H
\ No newline at end of file
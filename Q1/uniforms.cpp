@@ -0,0 +1,278 @@
+//
+//  uniforms.cpp
+//  Reflected uniform locations, uniform buffers and traffic counters
+//
+
+#include <stdio.h>
+#include <string.h>
+#include <stddef.h>
+#include <algorithm>
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include "uniforms.h"
+#include "gl_state.h"
+
+UniformStats& uniform_stats()
+{
+    static UniformStats stats;
+    return stats;
+}
+
+ProgramUniforms::ProgramUniforms(unsigned int program)
+    : mProgram(program)
+{
+    if (program == 0) return;
+    UniformStats& stats = uniform_stats();
+
+    int count = 0, maxLength = 0;
+    glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &count);
+    glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+    std::vector<char> name(std::max(maxLength, 1));
+    for (int i = 0; i < count; ++i) {
+        GLint size = 0;
+        GLenum type = 0;
+        glGetActiveUniform(program, (GLuint)i, (GLsizei)name.size(), nullptr, &size, &type, name.data());
+        GLuint index = (GLuint)i;
+        GLint block = -1, offset = -1;
+        glGetActiveUniformsiv(program, 1, &index, GL_UNIFORM_BLOCK_INDEX, &block);
+        glGetActiveUniformsiv(program, 1, &index, GL_UNIFORM_OFFSET, &offset);
+
+        // Arrays are reported as "name[0]"; store them under "name". Members
+        // of arrays of structs ("materials[1].kd") keep their full name.
+        std::string key(name.data());
+        if (key.size() > 3 && key.compare(key.size() - 3, 3, "[0]") == 0) key.resize(key.size() - 3);
+
+        Uniform& uniform = mUniforms[key];
+        uniform.block = block;
+        uniform.offset = block >= 0 ? offset : -1;
+        uniform.location = block >= 0 ? -1 : glGetUniformLocation(program, name.data());
+        stats.locationLookups++;
+    }
+
+    int blockCount = 0;
+    glGetProgramiv(program, GL_ACTIVE_UNIFORM_BLOCKS, &blockCount);
+    for (int b = 0; b < blockCount; ++b) {
+        char blockName[128];
+        GLint size = 0;
+        glGetActiveUniformBlockName(program, (GLuint)b, sizeof(blockName), nullptr, blockName);
+        glGetActiveUniformBlockiv(program, (GLuint)b, GL_UNIFORM_BLOCK_DATA_SIZE, &size);
+        Block block;
+        block.index = (unsigned int)b;
+        block.size = (size_t)size;
+        mBlocks[blockName] = block;
+    }
+}
+
+int ProgramUniforms::location(const char* name) const
+{
+    auto it = mUniforms.find(name);
+    return it == mUniforms.end() ? -1 : it->second.location;
+}
+
+int ProgramUniforms::blockOffset(const char* name) const
+{
+    auto it = mUniforms.find(name);
+    return it == mUniforms.end() ? -1 : it->second.offset;
+}
+
+size_t ProgramUniforms::blockSize(const char* block) const
+{
+    auto it = mBlocks.find(block);
+    return it == mBlocks.end() ? 0 : it->second.size;
+}
+
+bool ProgramUniforms::bindBlock(const char* block, unsigned int binding) const
+{
+    auto it = mBlocks.find(block);
+    if (it == mBlocks.end()) return false;
+    glUniformBlockBinding(mProgram, it->second.index, binding);
+    return true;
+}
+
+bool ProgramUniforms::matchesLayout(const char* block, size_t size,
+    const std::vector<std::pair<const char*, size_t>>& members) const
+{
+    auto it = mBlocks.find(block);
+    if (it == mBlocks.end()) return true;
+
+    bool ok = true;
+    if (it->second.size != size) {
+        fprintf(stderr, "%s: %zu bytes in GLSL, %zu in C++\n", block, it->second.size, size);
+        ok = false;
+    }
+    for (const auto& member : members) {
+        int offset = blockOffset(member.first);
+        // Members the compiler optimized away report no offset.
+        if (offset >= 0 && (size_t)offset != member.second) {
+            fprintf(stderr, "%s.%s: offset %d in GLSL, %zu in C++\n", block, member.first, offset, member.second);
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+ProgramUniforms::Uniform* ProgramUniforms::changed(const char* name, const void* value, size_t size)
+{
+    auto it = mUniforms.find(name);
+    if (it == mUniforms.end() || it->second.location < 0) return nullptr;
+    Uniform& uniform = it->second;
+    if (uniform.value.size() == size && memcmp(uniform.value.data(), value, size) == 0) return nullptr;
+
+    uniform.value.assign((const unsigned char*)value, (const unsigned char*)value + size);
+    UniformStats& stats = uniform_stats();
+    stats.uniformCalls++;
+    stats.bytes += size;
+    return &uniform;
+}
+
+// The set() overloads expect the program to be bound.
+void ProgramUniforms::set(const char* name, int value)
+{
+    if (Uniform* u = changed(name, &value, sizeof(value))) glUniform1i(u->location, value);
+}
+
+void ProgramUniforms::set(const char* name, float value)
+{
+    if (Uniform* u = changed(name, &value, sizeof(value))) glUniform1f(u->location, value);
+}
+
+void ProgramUniforms::set(const char* name, const glm::ivec2& value)
+{
+    if (Uniform* u = changed(name, &value, sizeof(value))) glUniform2iv(u->location, 1, glm::value_ptr(value));
+}
+
+void ProgramUniforms::set(const char* name, const glm::vec2& value)
+{
+    if (Uniform* u = changed(name, &value, sizeof(value))) glUniform2fv(u->location, 1, glm::value_ptr(value));
+}
+
+void ProgramUniforms::set(const char* name, const glm::vec3& value)
+{
+    if (Uniform* u = changed(name, &value, sizeof(value))) glUniform3fv(u->location, 1, glm::value_ptr(value));
+}
+
+UniformBuffer::~UniformBuffer()
+{
+    destroy();
+}
+
+bool UniformBuffer::create(size_t size, unsigned int binding)
+{
+    destroy();
+    glGenBuffers(1, &mBuffer);
+    if (mBuffer == 0) return false;
+    glBindBuffer(GL_UNIFORM_BUFFER, mBuffer);
+    glBufferData(GL_UNIFORM_BUFFER, (GLsizeiptr)size, nullptr, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    glBindBufferBase(GL_UNIFORM_BUFFER, binding, mBuffer);
+
+    // Everything is dirty until the first upload.
+    mShadow.assign(size, 0);
+    mDirtyBegin = 0;
+    mDirtyEnd = size;
+    return true;
+}
+
+void UniformBuffer::destroy()
+{
+    if (mBuffer != 0) gl_state().deleteBuffers(1, &mBuffer);
+    mBuffer = 0;
+    mShadow.clear();
+    mDirtyBegin = mDirtyEnd = 0;
+}
+
+void UniformBuffer::write(size_t offset, const void* data, size_t size)
+{
+    if (offset + size > mShadow.size()) return;
+    const unsigned char* bytes = (const unsigned char*)data;
+    unsigned char* shadow = mShadow.data() + offset;
+
+    // Narrow the change down to the bytes that actually differ.
+    size_t first = 0;
+    while (first < size && shadow[first] == bytes[first]) ++first;
+    if (first == size) return;
+    size_t last = size;
+    while (shadow[last - 1] == bytes[last - 1]) --last;
+
+    memcpy(shadow + first, bytes + first, last - first);
+    if (mDirtyBegin == mDirtyEnd) {
+        mDirtyBegin = offset + first;
+        mDirtyEnd = offset + last;
+    }
+    else {
+        mDirtyBegin = std::min(mDirtyBegin, offset + first);
+        mDirtyEnd = std::max(mDirtyEnd, offset + last);
+    }
+}
+
+bool UniformBuffer::upload()
+{
+    if (mDirtyBegin == mDirtyEnd || mBuffer == 0) return false;
+    gl_state().bindBuffer(GL_UNIFORM_BUFFER, mBuffer);
+    glBufferSubData(GL_UNIFORM_BUFFER, (GLintptr)mDirtyBegin, (GLsizeiptr)(mDirtyEnd - mDirtyBegin),
+        mShadow.data() + mDirtyBegin);
+
+    UniformStats& stats = uniform_stats();
+    stats.bufferUploads++;
+    stats.bytes += mDirtyEnd - mDirtyBegin;
+    mDirtyBegin = mDirtyEnd = 0;
+    return true;
+}
+
+bool bind_phong_blocks(const ProgramUniforms& uniforms)
+{
+    uniforms.bindBlock("CameraBlock", kCameraBinding);
+    uniforms.bindBlock("LightBlock", kLightBinding);
+    uniforms.bindBlock("MaterialBlock", kMaterialBinding);
+    uniforms.bindBlock("ObjectBlock", kObjectBinding);
+
+    bool ok = uniforms.matchesLayout("CameraBlock", sizeof(CameraBlock), {
+        { "viewMatrix", offsetof(CameraBlock, viewMatrix) },
+        { "projectionMatrix", offsetof(CameraBlock, projectionMatrix) },
+        { "eyePosWorld", offsetof(CameraBlock, eyePosWorld) },
+        { "gamma", offsetof(CameraBlock, gamma) } });
+    ok &= uniforms.matchesLayout("LightBlock", sizeof(LightBlock), {
+        { "lightPosWorld", offsetof(LightBlock, lightPosWorld) },
+        { "lightIa", offsetof(LightBlock, lightIa) },
+        { "lightIl", offsetof(LightBlock, lightIl) } });
+    ok &= uniforms.matchesLayout("MaterialBlock", sizeof(MaterialBlock), {
+        { "matKa", offsetof(MaterialBlock, matKa) },
+        { "matKd", offsetof(MaterialBlock, matKd) },
+        { "matKs", offsetof(MaterialBlock, matKs) },
+        { "matShininess", offsetof(MaterialBlock, matShininess) } });
+    uniforms.bindBlock("MaterialPaletteBlock", kPaletteBinding);
+    ok &= uniforms.matchesLayout("MaterialPaletteBlock", sizeof(MaterialPaletteBlock), {
+        { "materials[0].ka", offsetof(MaterialBlock, matKa) },
+        { "materials[0].kd", offsetof(MaterialBlock, matKd) },
+        { "materials[0].ks", offsetof(MaterialBlock, matKs) },
+        { "materials[0].shininess", offsetof(MaterialBlock, matShininess) },
+        { "materials[1].ka", sizeof(MaterialBlock) + offsetof(MaterialBlock, matKa) } });
+    ok &= uniforms.matchesLayout("ObjectBlock", sizeof(ObjectBlock), {
+        { "modelMatrix", offsetof(ObjectBlock, modelMatrix) },
+        { "normalMatrix", offsetof(ObjectBlock, normalMatrix) } });
+    return ok;
+}
+
+void fill_material_palette(const MaterialBlock& base, MaterialPaletteBlock& palette)
+{
+    // Rotating the RGB channels plus mixes of two channels gives six hues;
+    // the last two entries are the base color darker and lighter.
+    for (int i = 0; i < kMaterialPaletteSize; ++i) {
+        MaterialBlock& m = palette.materials[i];
+        m = base;
+        glm::vec3 ka = base.matKa, kd = base.matKd;
+        switch (i) {
+        case 0: break;
+        case 1: ka = glm::vec3(ka.y, ka.z, ka.x); kd = glm::vec3(kd.y, kd.z, kd.x); break;
+        case 2: ka = glm::vec3(ka.z, ka.x, ka.y); kd = glm::vec3(kd.z, kd.x, kd.y); break;
+        case 3: ka = glm::vec3(ka.y, ka.y, ka.x); kd = glm::vec3(kd.y, kd.y, kd.x); break;
+        case 4: ka = glm::vec3(ka.x, ka.y, ka.y); kd = glm::vec3(kd.x, kd.y, kd.y); break;
+        case 5: ka = glm::vec3(ka.y, ka.x, ka.y); kd = glm::vec3(kd.y, kd.x, kd.y); break;
+        case 6: ka *= 0.5f; kd *= 0.5f; break;
+        case 7: ka = glm::mix(ka, glm::vec3(1.0f), 0.5f); kd = glm::mix(kd, glm::vec3(0.5f), 0.5f); break;
+        }
+        m.matKa = ka;
+        m.matKd = kd;
+    }
+}
@@ -0,0 +1,172 @@
+#pragma once
+#ifndef UNIFORMS_H
+#define UNIFORMS_H
+
+#include <stddef.h>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+#include <glm/mat3x3.hpp>
+#include <glm/mat4x4.hpp>
+
+// GL uniform traffic since the last reset; the viewer resets it every frame.
+struct UniformStats
+{
+    size_t locationLookups = 0; // glGetUniformLocation / reflection queries
+    size_t uniformCalls = 0;    // glUniform*
+    size_t bufferUploads = 0;   // glBufferSubData on uniform buffers
+    size_t bytes = 0;           // payload of both
+};
+UniformStats& uniform_stats();
+
+// Uniforms of a linked program, reflected once with glGetActiveUniform.
+// Plain (default block) uniforms are set by name through a cached location
+// and a shadow copy of the last value, so unchanged values cost no GL call.
+class ProgramUniforms
+{
+public:
+    ProgramUniforms() = default;
+    explicit ProgramUniforms(unsigned int program);
+
+    // -1 for unknown uniforms and for members of a uniform block
+    int location(const char* name) const;
+    // Byte offset of a block member, -1 if unknown or not in a block
+    int blockOffset(const char* name) const;
+    // GL_UNIFORM_BLOCK_DATA_SIZE, 0 if the program has no such block
+    size_t blockSize(const char* block) const;
+
+    // Points a block at a binding; returns false if the program lacks it.
+    bool bindBlock(const char* block, unsigned int binding) const;
+
+    // True when the block is absent or its size and member offsets match
+    // the C++ mirror; mismatches are printed.
+    bool matchesLayout(const char* block, size_t size,
+        const std::vector<std::pair<const char*, size_t>>& members) const;
+
+    void set(const char* name, int value);
+    void set(const char* name, float value);
+    void set(const char* name, const glm::ivec2& value);
+    void set(const char* name, const glm::vec2& value);
+    void set(const char* name, const glm::vec3& value);
+
+private:
+    struct Uniform
+    {
+        int location = -1;
+        int block = -1;
+        int offset = -1;
+        std::vector<unsigned char> value; // last value set, empty = never
+    };
+    struct Block
+    {
+        unsigned int index;
+        size_t size;
+    };
+
+    unsigned int mProgram = 0;
+    std::unordered_map<std::string, Uniform> mUniforms;
+    std::unordered_map<std::string, Block> mBlocks;
+
+    // Uniform to update, or nullptr if absent or already holding the value
+    Uniform* changed(const char* name, const void* value, size_t size);
+};
+
+// A std140 uniform buffer with a CPU shadow copy. write() compares against
+// the shadow and only widens the dirty range on real changes; upload()
+// sends that range with a single glBufferSubData.
+class UniformBuffer
+{
+public:
+    UniformBuffer() = default;
+    ~UniformBuffer();
+    UniformBuffer(const UniformBuffer&) = delete;
+    UniformBuffer& operator=(const UniformBuffer&) = delete;
+
+    // Allocates the buffer and attaches it to the binding point.
+    bool create(size_t size, unsigned int binding);
+    void destroy();
+
+    void write(size_t offset, const void* data, size_t size);
+    template <typename T>
+    void update(const T& block) { write(0, &block, sizeof(T)); }
+
+    // Returns true when something was uploaded.
+    bool upload();
+
+private:
+    unsigned int mBuffer = 0;
+    std::vector<unsigned char> mShadow;
+    size_t mDirtyBegin = 0;
+    size_t mDirtyEnd = 0;
+};
+
+// ---------------------------------------------------------------------------
+// std140 blocks shared by the Phong shaders, split by update frequency.
+// The field order and padding mirror the GLSL declarations exactly.
+
+enum UniformBinding
+{
+    kCameraBinding = 0,   // CameraBlock, per frame
+    kLightBinding = 1,    // LightBlock, per light
+    kMaterialBinding = 2, // MaterialBlock, per material
+    kObjectBinding = 3,   // ObjectBlock, per object
+    kPaletteBinding = 4,  // MaterialPaletteBlock, instanced drawing
+};
+
+struct CameraBlock
+{
+    glm::mat4 viewMatrix;
+    glm::mat4 projectionMatrix;
+    glm::vec3 eyePosWorld;
+    float gamma;
+};
+
+struct LightBlock
+{
+    glm::vec3 lightPosWorld;
+    float lightIa;
+    glm::vec3 lightIl;
+    float pad0;
+};
+
+struct MaterialBlock
+{
+    glm::vec3 matKa;
+    float pad0;
+    glm::vec3 matKd;
+    float pad1;
+    glm::vec3 matKs;
+    float matShininess;
+};
+
+// Materials selected per instance (Phong.frag with MATERIAL_PALETTE); each
+// entry has the std140 layout of MaterialBlock.
+const int kMaterialPaletteSize = 8;
+struct MaterialPaletteBlock
+{
+    MaterialBlock materials[kMaterialPaletteSize];
+};
+
+// Entry 0 is base; the others keep its brightness, specular and shininess
+// with the ambient / diffuse color rotated to other hues.
+void fill_material_palette(const MaterialBlock& base, MaterialPaletteBlock& palette);
+
+struct ObjectBlock
+{
+    glm::mat4 modelMatrix;
+    glm::vec4 normalMatrix[3]; // std140 mat3: three vec4-aligned columns
+
+    void setNormalMatrix(const glm::mat3& m)
+    {
+        for (int c = 0; c < 3; ++c) normalMatrix[c] = glm::vec4(m[c], 0.0f);
+    }
+};
+
+// Binds the blocks of a Phong program and checks their layouts.
+bool bind_phong_blocks(const ProgramUniforms& uniforms);
+
+#endif // UNIFORMS_H
@@ -0,0 +1,341 @@
+//
+//  viewer_options.cpp
+//  Command line parsing for the viewer
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "viewer_options.h"
+
+namespace {
+
+void print_usage(const char* program)
+{
+    fprintf(stderr,
+        "usage: %s [options]\n"
+        "  --bench-sphere [W H]   benchmark create_sphere() (default 2048 1024)\n"
+        "  --sphere-error-report [E]\n"
+        "                         compare sphere layouts for a max error E\n"
+        "  --quantize-report [W H]\n"
+        "                         size and error of the quantized vertex formats\n"
+        "  --vcache-report [N] [fifo|lru]\n"
+        "                         vertex cache ACMR/ATVR for an N-entry cache (default 16 fifo)\n"
+        "  --overdraw-report [W H]\n"
+        "                         CPU overdraw estimate through the mesh optimization passes\n"
+        "  --meshlet-report [W H] meshlet sizes and frustum / normal cone culling rates\n"
+        "  --lod-report [W H]     LOD chain sizes, measured errors and simplification times\n"
+        "  --variant-report       offscreen fragment cost of generic vs specialized Phong.frag\n"
+        "  --instance-report      offscreen frame time of instanced drawing, 1 to 1M spheres\n"
+        "  --multi-draw-report    offscreen draw calls and submit time, 10k objects naive vs indirect\n"
+        "  --ring-report          offscreen per-frame upload cost, glBufferSubData vs fenced ring\n"
+        "  --headless [N]         no window: N frames (300) into an offscreen framebuffer, then the\n"
+        "                         throughput; EGL without a display server on Linux\n"
+        "  --size W H             framebuffer size of the window or headless target (default 512 512)\n"
+        "  --sphere W H           resolution of the viewer's sphere (default 32 16)\n"
+        "  --lod [PX]             pick the LOD level by projected error (default 1 pixel);\n"
+        "                         Up/Down move the sphere\n"
+        "  --tessellation [PX]    refine a coarse icosphere on the GPU to PX-pixel edges (default 8)\n"
+        "  --procedural           build the sphere in the vertex shader, no vertex/index buffers\n"
+        "  --instances N          draw N spheres with glDrawElementsInstanced\n"
+        "  --animate              with --instances, stream moving spheres through a ring buffer\n"
+        "  --multi-draw N         draw N spheres of four meshes with glMultiDrawElementsIndirect\n"
+        "  --shader-variant LIST  Phong.frag permutation: const, const-material, const-light,\n"
+        "                         const-gamma, blinn, no-specular, no-gamma (comma separated)\n"
+        "  --draw-stats           print triangles and GPU / frame time per frame at exit\n"
+        "  --gl-state-check       verify the GL state cache against glGet* every frame\n"
+        "  --meshlets             draw only the meshlets that survive CPU culling\n"
+        "  --quantized [oct16|1010102]\n"
+        "                         render with quantized positions and normals\n"
+        "  --vsync off|on|adaptive\n"
+        "                         swap interval (default on; adaptive needs swap_control_tear)\n"
+        "  --fps-limit FPS        cap the frame rate\n"
+        "  --frame-stats          print p50/p95/p99/max frame, CPU and GPU times at exit\n"
+        "  --frame-json FILE      write the frame statistics to FILE as JSON at exit\n"
+        "  --bench-frames N       run N frames with vsync off and no limit, then print the statistics\n"
+        "  --capture PATTERN      save every frame, e.g. frame_%%05d.png (.png, .ppm or .exr), read back\n"
+        "                         asynchronously and encoded on worker threads\n"
+        "  --capture-report       headless capture throughput at 512x512 and 4K, PPM / PNG / EXR\n"
+        "  --program-cache [DIR]  keep linked program binaries in DIR (program_cache) for fast startup\n"
+        "  --program-cache-report shader build time of startup without the cache, cold and warm\n"
+        "  --async-shaders        draw with the generic shader until the --shader-variant has compiled\n"
+        "  --compile-report       compile wall time of 100 variants, serial vs deferred status checks\n"
+        "  --render-thread        draw on a render thread; events and simulation stay on the main thread\n"
+        "  --sim-ms MS            busy-wait MS per simulation step (stand-in for game logic)\n"
+        "  --latency-report [N]   input-to-present latency and frame interval of N frames, single\n"
+        "                         threaded and with the render thread (300)\n"
+        "  --gpu-profile [FILE.csv]\n"
+        "                         GPU time and pipeline statistics per pass (clear, sphere, swap)\n"
+        "  --gpu-overlay          draw the GPU pass times as bars and show them in the title bar\n"
+        "  --cpu-trace FILE.json  record CPU zones (startup, per frame) as a Chrome / Perfetto trace\n"
+        "  --profiler-report      overhead of a CPU profiler zone, disabled and enabled\n"
+        "  --queue-report [N]     radix sort time and state changes of N render queue packets (100000)\n",
+        program);
+}
+
+// Reads an optional positive integer at argv[i + 1]; advances i when present.
+bool optional_int(int argc, char** argv, int& i, int& value)
+{
+    if (i + 1 >= argc) return false;
+    char* end = nullptr;
+    long v = strtol(argv[i + 1], &end, 10);
+    if (end == argv[i + 1] || *end != '\0' || v <= 0) return false;
+    value = (int)v;
+    ++i;
+    return true;
+}
+
+// Reads an optional positive number at argv[i + 1]; advances i when present.
+bool optional_float(int argc, char** argv, int& i, float& value)
+{
+    if (i + 1 >= argc) return false;
+    char* end = nullptr;
+    float v = strtof(argv[i + 1], &end);
+    if (end == argv[i + 1] || *end != '\0' || !(v > 0.0f)) return false;
+    value = v;
+    ++i;
+    return true;
+}
+
+// Optional "W H" sphere resolution; a width without a height is an error.
+bool optional_resolution(int argc, char** argv, int& i, ViewerOptions& options)
+{
+    if (!optional_int(argc, argv, i, options.sphereWidth)) return true;
+    return optional_int(argc, argv, i, options.sphereHeight);
+}
+
+} // namespace
+
+bool parse_options(int argc, char** argv, ViewerOptions& options)
+{
+    for (int i = 1; i < argc; ++i) {
+        const char* arg = argv[i];
+        if (strcmp(arg, "--bench-sphere") == 0) {
+            options.benchSphere = true;
+            if (!optional_resolution(argc, argv, i, options)) {
+                print_usage(argv[0]);
+                return false;
+            }
+        }
+        else if (strcmp(arg, "--sphere-error-report") == 0) {
+            options.sphereErrorReport = true;
+            optional_float(argc, argv, i, options.sphereMaxError);
+        }
+        else if (strcmp(arg, "--quantize-report") == 0) {
+            options.quantizeReport = true;
+            if (!optional_resolution(argc, argv, i, options)) {
+                print_usage(argv[0]);
+                return false;
+            }
+        }
+        else if (strcmp(arg, "--vcache-report") == 0) {
+            options.vertexCacheReport = true;
+            optional_int(argc, argv, i, options.cacheSize);
+            if (i + 1 < argc && (strcmp(argv[i + 1], "fifo") == 0 || strcmp(argv[i + 1], "lru") == 0)) {
+                options.lruCache = strcmp(argv[++i], "lru") == 0;
+            }
+        }
+        else if (strcmp(arg, "--overdraw-report") == 0) {
+            options.overdrawReport = true;
+            if (!optional_resolution(argc, argv, i, options)) {
+                print_usage(argv[0]);
+                return false;
+            }
+        }
+        else if (strcmp(arg, "--meshlet-report") == 0) {
+            options.meshletReport = true;
+            if (!optional_resolution(argc, argv, i, options)) {
+                print_usage(argv[0]);
+                return false;
+            }
+        }
+        else if (strcmp(arg, "--lod-report") == 0) {
+            options.lodReport = true;
+            if (!optional_resolution(argc, argv, i, options)) {
+                print_usage(argv[0]);
+                return false;
+            }
+        }
+        else if (strcmp(arg, "--variant-report") == 0) {
+            options.variantReport = true;
+        }
+        else if (strcmp(arg, "--instance-report") == 0) {
+            options.instanceReport = true;
+        }
+        else if (strcmp(arg, "--multi-draw-report") == 0) {
+            options.multiDrawReport = true;
+        }
+        else if (strcmp(arg, "--ring-report") == 0) {
+            options.ringReport = true;
+        }
+        else if (strcmp(arg, "--headless") == 0) {
+            options.headless = true;
+            optional_int(argc, argv, i, options.headlessFrames);
+        }
+        else if (strcmp(arg, "--size") == 0) {
+            if (!optional_int(argc, argv, i, options.frameWidth) ||
+                !optional_int(argc, argv, i, options.frameHeight)) {
+                print_usage(argv[0]);
+                return false;
+            }
+        }
+        else if (strcmp(arg, "--sphere") == 0) {
+            if (!optional_int(argc, argv, i, options.viewerWidth) ||
+                !optional_int(argc, argv, i, options.viewerHeight)) {
+                print_usage(argv[0]);
+                return false;
+            }
+        }
+        else if (strcmp(arg, "--lod") == 0) {
+            options.lod = true;
+            optional_float(argc, argv, i, options.lodPixelError);
+        }
+        else if (strcmp(arg, "--tessellation") == 0) {
+            options.tessellation = true;
+            optional_float(argc, argv, i, options.tessPixelsPerEdge);
+        }
+        else if (strcmp(arg, "--procedural") == 0) {
+            options.procedural = true;
+        }
+        else if (strcmp(arg, "--instances") == 0) {
+            if (!optional_int(argc, argv, i, options.instances)) {
+                print_usage(argv[0]);
+                return false;
+            }
+        }
+        else if (strcmp(arg, "--animate") == 0) {
+            options.animate = true;
+        }
+        else if (strcmp(arg, "--multi-draw") == 0) {
+            if (!optional_int(argc, argv, i, options.multiDraw)) {
+                print_usage(argv[0]);
+                return false;
+            }
+        }
+        else if (strcmp(arg, "--shader-variant") == 0) {
+            if (i + 1 >= argc || !parse_shader_features(argv[++i], options.shaderFeatures)) {
+                print_usage(argv[0]);
+                return false;
+            }
+        }
+        else if (strcmp(arg, "--draw-stats") == 0) {
+            options.drawStats = true;
+        }
+        else if (strcmp(arg, "--gl-state-check") == 0) {
+            options.glStateCheck = true;
+        }
+        else if (strcmp(arg, "--meshlets") == 0) {
+            options.meshlets = true;
+        }
+        else if (strcmp(arg, "--quantized") == 0) {
+            options.quantized = true;
+            if (i + 1 < argc && strcmp(argv[i + 1], "oct16") == 0) {
+                options.normalEncoding = NormalEncoding::Oct16;
+                ++i;
+            }
+            else if (i + 1 < argc && strcmp(argv[i + 1], "1010102") == 0) {
+                options.normalEncoding = NormalEncoding::Snorm1010102;
+                ++i;
+            }
+        }
+        else if (strcmp(arg, "--vsync") == 0) {
+            if (i + 1 >= argc || !parse_vsync_mode(argv[++i], options.vsync)) {
+                print_usage(argv[0]);
+                return false;
+            }
+        }
+        else if (strcmp(arg, "--fps-limit") == 0) {
+            if (!optional_float(argc, argv, i, options.fpsLimit)) {
+                print_usage(argv[0]);
+                return false;
+            }
+        }
+        else if (strcmp(arg, "--frame-stats") == 0) {
+            options.frameStats = true;
+        }
+        else if (strcmp(arg, "--frame-json") == 0) {
+            if (i + 1 >= argc) {
+                print_usage(argv[0]);
+                return false;
+            }
+            options.frameJson = argv[++i];
+        }
+        else if (strcmp(arg, "--bench-frames") == 0) {
+            if (!optional_int(argc, argv, i, options.benchFrames)) {
+                print_usage(argv[0]);
+                return false;
+            }
+        }
+        else if (strcmp(arg, "--capture") == 0) {
+            if (i + 1 >= argc || !image_format_from_path(argv[i + 1], options.captureFormat)) {
+                print_usage(argv[0]);
+                return false;
+            }
+            options.capturePath = argv[++i];
+        }
+        else if (strcmp(arg, "--capture-report") == 0) {
+            options.captureReport = true;
+        }
+        else if (strcmp(arg, "--program-cache") == 0) {
+            options.programCache = "program_cache";
+            if (i + 1 < argc && strncmp(argv[i + 1], "--", 2) != 0) {
+                options.programCache = argv[++i];
+            }
+        }
+        else if (strcmp(arg, "--program-cache-report") == 0) {
+            options.programCacheReport = true;
+        }
+        else if (strcmp(arg, "--async-shaders") == 0) {
+            options.asyncShaders = true;
+        }
+        else if (strcmp(arg, "--compile-report") == 0) {
+            options.compileReport = true;
+        }
+        else if (strcmp(arg, "--render-thread") == 0) {
+            options.renderThread = true;
+        }
+        else if (strcmp(arg, "--sim-ms") == 0) {
+            if (!optional_float(argc, argv, i, options.simulationMs)) {
+                print_usage(argv[0]);
+                return false;
+            }
+        }
+        else if (strcmp(arg, "--latency-report") == 0) {
+            options.latencyReport = true;
+            optional_int(argc, argv, i, options.latencyFrames);
+        }
+        else if (strcmp(arg, "--gpu-profile") == 0) {
+            options.gpuProfile = true;
+            if (i + 1 < argc && strncmp(argv[i + 1], "--", 2) != 0) {
+                options.gpuCsv = argv[++i];
+            }
+        }
+        else if (strcmp(arg, "--gpu-overlay") == 0) {
+            options.gpuOverlay = true;
+        }
+        else if (strcmp(arg, "--cpu-trace") == 0) {
+            if (i + 1 >= argc) {
+                print_usage(argv[0]);
+                return false;
+            }
+            options.cpuTrace = argv[++i];
+        }
+        else if (strcmp(arg, "--profiler-report") == 0) {
+            options.profilerReport = true;
+        }
+        else if (strcmp(arg, "--queue-report") == 0) {
+            options.queueReport = true;
+            optional_int(argc, argv, i, options.queuePackets);
+        }
+        else if (strcmp(arg, "--help") == 0 || strcmp(arg, "-h") == 0) {
+            print_usage(argv[0]);
+            return false;
+        }
+        else {
+            fprintf(stderr, "Unknown option: %s\n", arg);
+            print_usage(argv[0]);
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,184 @@
+#pragma once
+#ifndef VIEWER_OPTIONS_H
+#define VIEWER_OPTIONS_H
+
+#include <string>
+#include "mesh_encode.h"
+#include "shader_variants.h"
+#include "frame_timing.h"
+#include "image_encode.h"
+
+// Command line options of the viewer
+struct ViewerOptions
+{
+    // --bench-sphere [W H] : create_sphere() throughput by thread count
+    bool benchSphere = false;
+    int sphereWidth = 2048;
+    int sphereHeight = 1024;
+
+    // --sphere-error-report [E] : UV vs icosphere vs cube-sphere at error E
+    bool sphereErrorReport = false;
+    float sphereMaxError = 0.0f; // 0 = default set of targets
+
+    // --quantize-report [W H] : encoded size and error for a WxH sphere
+    bool quantizeReport = false;
+
+    // --vcache-report [N] [fifo|lru] : ACMR/ATVR before and after optimization
+    bool vertexCacheReport = false;
+    int cacheSize = 16;
+    bool lruCache = false;
+
+    // --overdraw-report [W H] : overdraw, ACMR and overfetch through the passes
+    bool overdrawReport = false;
+
+    // --meshlet-report [W H] : meshlet statistics and culling rates
+    bool meshletReport = false;
+
+    // --lod-report [W H] : LOD chain triangle counts, errors and timings
+    bool lodReport = false;
+
+    // --variant-report : offscreen fragment cost of the Phong.frag permutations
+    bool variantReport = false;
+
+    // --instance-report : offscreen frame time of instanced drawing for 1 to
+    // 1M instances
+    bool instanceReport = false;
+
+    // --multi-draw-report : offscreen draw calls and submit time of 10k
+    // objects, one draw each against one multi-draw indirect call
+    bool multiDrawReport = false;
+
+    // --ring-report : offscreen per-frame upload cost of animated instances,
+    // glBufferSubData / orphaning against the persistent ring buffer
+    bool ringReport = false;
+
+    // --headless [N] : no window; draw N frames into an offscreen framebuffer
+    // as fast as possible and print the throughput
+    bool headless = false;
+    int headlessFrames = 300;
+
+    // --size W H : framebuffer size of the window or the headless target
+    int frameWidth = 512;
+    int frameHeight = 512;
+
+    // --sphere W H : resolution of the sphere drawn by the viewer
+    int viewerWidth = 32;
+    int viewerHeight = 16;
+
+    // --lod [PX] : draw the LOD level whose error stays within PX pixels
+    bool lod = false;
+    float lodPixelError = 1.0f;
+
+    // --tessellation [PX] : refine a coarse icosphere on the GPU to edges of
+    // about PX pixels (GL 4.0)
+    bool tessellation = false;
+    float tessPixelsPerEdge = 8.0f;
+
+    // --procedural : generate the --sphere W H sphere from gl_VertexID, with
+    // no vertex or index buffer
+    bool procedural = false;
+
+    // --instances N : draw N spheres with one instanced draw call
+    int instances = 0;
+
+    // --animate : with --instances, move the spheres every frame, streamed
+    // through a fenced persistent ring buffer
+    bool animate = false;
+
+    // --multi-draw N : draw N spheres of four meshes with one
+    // glMultiDrawElementsIndirect (GL 4.3)
+    int multiDraw = 0;
+
+    // --shader-variant LIST : Phong.frag permutation, e.g. "const,blinn"
+    // (see parse_shader_features)
+    unsigned int shaderFeatures = kPhongDefault;
+
+    // --draw-stats : triangles and GPU/CPU time per frame, printed at exit
+    bool drawStats = false;
+
+    // --gl-state-check : cross-check the GL state cache against glGet*
+    // every frame and report state changed behind its back
+    bool glStateCheck = false;
+
+    // --meshlets : cull meshlets on the CPU and draw the surviving ranges
+    bool meshlets = false;
+
+    // --quantized [oct16|1010102] : draw the snorm16 / packed-normal mesh
+    bool quantized = false;
+    NormalEncoding normalEncoding = NormalEncoding::Oct16;
+
+    // --vsync off|on|adaptive : swap interval of the window
+    VsyncMode vsync = VsyncMode::On;
+
+    // --fps-limit FPS : cap the frame rate with the sleep-and-spin limiter
+    float fpsLimit = 0.0f;
+
+    // --frame-stats : p50/p95/p99/max frame, CPU and GPU times at exit
+    bool frameStats = false;
+
+    // --frame-json FILE : the same numbers written as JSON at exit
+    std::string frameJson;
+
+    // --bench-frames N : unthrottled run (vsync off, no limit) that exits
+    // after N frames and prints the frame statistics
+    int benchFrames = 0;
+
+    // --capture PATTERN : write every frame to PATTERN with the frame number,
+    // e.g. frame_%05d.png (.png, .ppm or .exr), through the PBO readback ring
+    std::string capturePath;
+    ImageFormat captureFormat = ImageFormat::Png;
+
+    // --capture-report : headless capture throughput at 512x512 and 4K
+    bool captureReport = false;
+
+    // --program-cache [DIR] : linked program binaries on disk, loaded instead
+    // of compiling when sources and driver match
+    std::string programCache;
+
+    // --program-cache-report : shader startup without the cache, cold and warm
+    bool programCacheReport = false;
+
+    // --async-shaders : draw with the generic Phong.frag while the selected
+    // --shader-variant compiles, then switch
+    bool asyncShaders = false;
+
+    // --compile-report : wall time of 100 variants compiled one by one
+    // against submitted together with deferred status checks
+    bool compileReport = false;
+
+    // --render-thread : GL context and drawing on a render thread, GLFW
+    // events and the simulation on the main thread
+    bool renderThread = false;
+
+    // --sim-ms MS : synthetic simulation work per step on the main thread
+    float simulationMs = 0.0f;
+
+    // --latency-report [N] : N frames on one thread, then N with the render
+    // thread; input-to-present latency and frame interval of both
+    bool latencyReport = false;
+    int latencyFrames = 300;
+
+    // --gpu-profile [FILE.csv] : GPU time and pipeline statistics of the
+    // clear, sphere and swap passes at exit, optionally every frame as CSV
+    bool gpuProfile = false;
+    std::string gpuCsv;
+
+    // --gpu-overlay : pass times as bars on screen and in the title bar
+    bool gpuOverlay = false;
+
+    // --cpu-trace FILE.json : CPU zones of startup and every frame as a
+    // Chrome trace (chrome://tracing, ui.perfetto.dev)
+    std::string cpuTrace;
+
+    // --profiler-report : cost of a CPU profiler zone
+    bool profilerReport = false;
+
+    // --queue-report [N] : sort time and state changes of N draw packets
+    bool queueReport = false;
+    int queuePackets = 100000;
+};
+
+// Returns false (after printing usage) on an unknown or malformed option.
+bool parse_options(int argc, char** argv, ViewerOptions& options);
+
+#endif // VIEWER_OPTIONS_H